@@ -0,0 +1,505 @@
+#ifndef ACTIVATIONKERNELS_HPP
+#define ACTIVATIONKERNELS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include "CPUFeatures.hpp"
+#include "VectorView.hpp"
+
+#if NN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * How closely activation functions follow libm. Accurate stays within about 1e-6 of the true value and Fast within about 1e-3, both in absolute error. Training and propagation read the same tier, so a network is consistent with itself at any of them.
+ */
+enum class ActivationAccuracy {
+	Exact,
+	Accurate,
+	Fast
+};
+
+/**
+ * The function applied to a layer's weighted sums. Identity leaves them as they are, for products that are not the end of a layer.
+ */
+enum class ActivationFunction {
+	Tanh,
+	Sigmoid,
+	Identity
+};
+
+/**
+ * Get the name of an accuracy tier, as stored in network files.
+ * @param accuracy The accuracy tier.
+ * @return The name of the tier.
+ */
+std::string getActivationAccuracyName( ActivationAccuracy accuracy ) {
+	switch( accuracy ) {
+		case ActivationAccuracy::Accurate:
+			return std::string( "accurate" );
+
+		case ActivationAccuracy::Fast:
+			return std::string( "fast" );
+
+		default:
+			return std::string( "exact" );
+	}
+}
+
+/**
+ * Parse the name of an accuracy tier from a network file.
+ * @param name The name of the tier.
+ * @return The named tier. Unknown names are treated as Exact.
+ */
+ActivationAccuracy parseActivationAccuracyName( const std::string& name ) {
+	if( name == "accurate" ) {
+		return ActivationAccuracy::Accurate;
+	}
+
+	if( name == "fast" ) {
+		return ActivationAccuracy::Fast;
+	}
+
+	return ActivationAccuracy::Exact;
+}
+
+// Odd over even rational fit of tanh on [-7.905, 7.905], beyond which it rounds to +-1 in single precision
+const float tanh_accurate_clamp = 7.90531110763549805f;
+const float tanh_accurate_numerator[] = { 4.89352455891786e-03f, 6.37261928875436e-04f, 1.48572235717979e-05f, 5.12229709037114e-08f, -8.60467152213735e-11f, 2.00018790482477e-13f, -2.76076847742355e-16f };
+const float tanh_accurate_denominator[] = { 4.89352518554385e-03f, 2.26843463243900e-03f, 1.18534705686654e-04f, 1.19825839466702e-06f };
+
+// The [7/6] Pade approximant of tanh, clamped where it crosses +-1
+const float tanh_fast_clamp = 4.97f;
+const float tanh_fast_numerator[] = { 135135.f, 17325.f, 378.f, 1.f };
+const float tanh_fast_denominator[] = { 135135.f, 62370.f, 3150.f, 28.f };
+
+float tanhAccurate( float input ) {
+	const float x = std::min( tanh_accurate_clamp, std::max( -tanh_accurate_clamp, input ) );
+	const float x2 = x * x;
+
+	float numerator = tanh_accurate_numerator[ 6 ];
+	for( int i = 5; i >= 0; --i ) {
+		numerator = numerator * x2 + tanh_accurate_numerator[ i ];
+	}
+
+	float denominator = tanh_accurate_denominator[ 3 ];
+	for( int i = 2; i >= 0; --i ) {
+		denominator = denominator * x2 + tanh_accurate_denominator[ i ];
+	}
+
+	return x * numerator / denominator;
+}
+
+float tanhFast( float input ) {
+	const float x = std::min( tanh_fast_clamp, std::max( -tanh_fast_clamp, input ) );
+	const float x2 = x * x;
+	const float numerator = ( ( tanh_fast_numerator[ 3 ] * x2 + tanh_fast_numerator[ 2 ] ) * x2 + tanh_fast_numerator[ 1 ] ) * x2 + tanh_fast_numerator[ 0 ];
+	const float denominator = ( ( tanh_fast_denominator[ 3 ] * x2 + tanh_fast_denominator[ 2 ] ) * x2 + tanh_fast_denominator[ 1 ] ) * x2 + tanh_fast_denominator[ 0 ];
+	return x * numerator / denominator;
+}
+
+/**
+ * Evaluate an activation function on one value. Used for strided vectors and as the fallback when no vector instruction set is available.
+ * @param function The function to evaluate.
+ * @param accuracy The accuracy tier to evaluate it at.
+ * @param input The value to evaluate it on.
+ * @return The value of the function.
+ */
+float activate( ActivationFunction function, ActivationAccuracy accuracy, float input ) {
+	if( function == ActivationFunction::Identity ) {
+		return input;
+	}
+
+	if( function == ActivationFunction::Tanh ) {
+		switch( accuracy ) {
+			case ActivationAccuracy::Accurate:
+				return tanhAccurate( input );
+
+			case ActivationAccuracy::Fast:
+				return tanhFast( input );
+
+			default:
+				return std::tanh( input );
+		}
+	}
+
+	// The approximate sigmoids are rescaled tanh, sigmoid( x ) = 0.5 + 0.5 * tanh( x / 2 ), which also halves their error
+	switch( accuracy ) {
+		case ActivationAccuracy::Accurate:
+			return 0.5f + 0.5f * tanhAccurate( 0.5f * input );
+
+		case ActivationAccuracy::Fast:
+			return 0.5f + 0.5f * tanhFast( 0.5f * input );
+
+		default:
+			return 1.f / ( 1.f + std::exp( -input ) );
+	}
+}
+
+/**
+ * Get the derivative of an activation function from the value it produced, which is how the backward pass sees it.
+ * @param function The function that was applied.
+ * @param output The output of the function.
+ * @return The derivative of the function at the input that gave that output.
+ */
+float activationDerivativeFromOutput( ActivationFunction function, float output ) {
+	switch( function ) {
+		case ActivationFunction::Tanh:
+			return 1.f - output * output;
+
+		case ActivationFunction::Sigmoid:
+			return output * ( 1.f - output );
+
+		default:
+			return 1.f;
+	}
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+void activationScalar( const float* input, float* output, unsigned int count ) {
+	for( unsigned int i = 0; i < count; ++i ) {
+		output[ i ] = activate( Function, Accuracy, input[ i ] );
+	}
+}
+
+#if NN_X86
+/**
+ * Evaluate tanh on four values. Clamping with the input as the second operand lets NaNs through unchanged. The fast tier divides with the 12 bit reciprocal estimate.
+ */
+template< ActivationAccuracy Accuracy >
+__attribute__(( target( "sse2" ) ))
+__m128 tanhSSE2( __m128 input ) {
+	const bool fast = Accuracy == ActivationAccuracy::Fast;
+	const float clamp = fast ? tanh_fast_clamp : tanh_accurate_clamp;
+	const __m128 x = _mm_min_ps( _mm_set1_ps( clamp ), _mm_max_ps( _mm_set1_ps( -clamp ), input ) );
+	const __m128 x2 = _mm_mul_ps( x, x );
+
+	if( fast ) {
+		__m128 numerator = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( tanh_fast_numerator[ 3 ] ), x2 ), _mm_set1_ps( tanh_fast_numerator[ 2 ] ) );
+		numerator = _mm_add_ps( _mm_mul_ps( numerator, x2 ), _mm_set1_ps( tanh_fast_numerator[ 1 ] ) );
+		numerator = _mm_add_ps( _mm_mul_ps( numerator, x2 ), _mm_set1_ps( tanh_fast_numerator[ 0 ] ) );
+
+		__m128 denominator = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( tanh_fast_denominator[ 3 ] ), x2 ), _mm_set1_ps( tanh_fast_denominator[ 2 ] ) );
+		denominator = _mm_add_ps( _mm_mul_ps( denominator, x2 ), _mm_set1_ps( tanh_fast_denominator[ 1 ] ) );
+		denominator = _mm_add_ps( _mm_mul_ps( denominator, x2 ), _mm_set1_ps( tanh_fast_denominator[ 0 ] ) );
+
+		return _mm_mul_ps( _mm_mul_ps( x, numerator ), _mm_rcp_ps( denominator ) );
+	}
+
+	__m128 numerator = _mm_set1_ps( tanh_accurate_numerator[ 6 ] );
+	for( int i = 5; i >= 0; --i ) {
+		numerator = _mm_add_ps( _mm_mul_ps( numerator, x2 ), _mm_set1_ps( tanh_accurate_numerator[ i ] ) );
+	}
+
+	__m128 denominator = _mm_set1_ps( tanh_accurate_denominator[ 3 ] );
+	for( int i = 2; i >= 0; --i ) {
+		denominator = _mm_add_ps( _mm_mul_ps( denominator, x2 ), _mm_set1_ps( tanh_accurate_denominator[ i ] ) );
+	}
+
+	return _mm_div_ps( _mm_mul_ps( x, numerator ), denominator );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "sse2" ) ))
+__m128 activateSSE2( __m128 input ) {
+	if( Function == ActivationFunction::Identity ) {
+		return input;
+	}
+
+	// Exact values only come from libm, a lane at a time
+	if( Accuracy == ActivationAccuracy::Exact ) {
+		float lanes[ 4 ];
+		_mm_storeu_ps( lanes, input );
+		for( unsigned int i = 0; i < 4; ++i ) {
+			lanes[ i ] = activate( Function, Accuracy, lanes[ i ] );
+		}
+		return _mm_loadu_ps( lanes );
+	}
+
+	if( Function == ActivationFunction::Tanh ) {
+		return tanhSSE2< Accuracy >( input );
+	}
+
+	const __m128 half = _mm_set1_ps( 0.5f );
+	return _mm_add_ps( half, _mm_mul_ps( half, tanhSSE2< Accuracy >( _mm_mul_ps( half, input ) ) ) );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "sse2" ) ))
+void activationSSE2( const float* input, float* output, unsigned int count ) {
+	unsigned int i = 0;
+
+	for( ; i + 4 <= count; i += 4 ) {
+		_mm_storeu_ps( output + i, activateSSE2< Function, Accuracy >( _mm_loadu_ps( input + i ) ) );
+	}
+
+	// The tail goes through the same vector path so every element is rounded alike
+	if( i < count ) {
+		float lanes[ 4 ] = { 0.f, 0.f, 0.f, 0.f };
+		std::copy( input + i, input + count, lanes );
+		_mm_storeu_ps( lanes, activateSSE2< Function, Accuracy >( _mm_loadu_ps( lanes ) ) );
+		std::copy( lanes, lanes + ( count - i ), output + i );
+	}
+}
+
+template< ActivationAccuracy Accuracy >
+__attribute__(( target( "avx2,fma" ) ))
+__m256 tanhAVX2( __m256 input ) {
+	const bool fast = Accuracy == ActivationAccuracy::Fast;
+	const float clamp = fast ? tanh_fast_clamp : tanh_accurate_clamp;
+	const __m256 x = _mm256_min_ps( _mm256_set1_ps( clamp ), _mm256_max_ps( _mm256_set1_ps( -clamp ), input ) );
+	const __m256 x2 = _mm256_mul_ps( x, x );
+
+	if( fast ) {
+		__m256 numerator = _mm256_fmadd_ps( _mm256_set1_ps( tanh_fast_numerator[ 3 ] ), x2, _mm256_set1_ps( tanh_fast_numerator[ 2 ] ) );
+		numerator = _mm256_fmadd_ps( numerator, x2, _mm256_set1_ps( tanh_fast_numerator[ 1 ] ) );
+		numerator = _mm256_fmadd_ps( numerator, x2, _mm256_set1_ps( tanh_fast_numerator[ 0 ] ) );
+
+		__m256 denominator = _mm256_fmadd_ps( _mm256_set1_ps( tanh_fast_denominator[ 3 ] ), x2, _mm256_set1_ps( tanh_fast_denominator[ 2 ] ) );
+		denominator = _mm256_fmadd_ps( denominator, x2, _mm256_set1_ps( tanh_fast_denominator[ 1 ] ) );
+		denominator = _mm256_fmadd_ps( denominator, x2, _mm256_set1_ps( tanh_fast_denominator[ 0 ] ) );
+
+		return _mm256_mul_ps( _mm256_mul_ps( x, numerator ), _mm256_rcp_ps( denominator ) );
+	}
+
+	__m256 numerator = _mm256_set1_ps( tanh_accurate_numerator[ 6 ] );
+	for( int i = 5; i >= 0; --i ) {
+		numerator = _mm256_fmadd_ps( numerator, x2, _mm256_set1_ps( tanh_accurate_numerator[ i ] ) );
+	}
+
+	__m256 denominator = _mm256_set1_ps( tanh_accurate_denominator[ 3 ] );
+	for( int i = 2; i >= 0; --i ) {
+		denominator = _mm256_fmadd_ps( denominator, x2, _mm256_set1_ps( tanh_accurate_denominator[ i ] ) );
+	}
+
+	return _mm256_div_ps( _mm256_mul_ps( x, numerator ), denominator );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "avx2,fma" ) ))
+__m256 activateAVX2( __m256 input ) {
+	if( Function == ActivationFunction::Identity ) {
+		return input;
+	}
+
+	if( Accuracy == ActivationAccuracy::Exact ) {
+		float lanes[ 8 ];
+		_mm256_storeu_ps( lanes, input );
+		for( unsigned int i = 0; i < 8; ++i ) {
+			lanes[ i ] = activate( Function, Accuracy, lanes[ i ] );
+		}
+		return _mm256_loadu_ps( lanes );
+	}
+
+	if( Function == ActivationFunction::Tanh ) {
+		return tanhAVX2< Accuracy >( input );
+	}
+
+	const __m256 half = _mm256_set1_ps( 0.5f );
+	return _mm256_fmadd_ps( half, tanhAVX2< Accuracy >( _mm256_mul_ps( half, input ) ), half );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "avx2,fma" ) ))
+void activationAVX2( const float* input, float* output, unsigned int count ) {
+	unsigned int i = 0;
+
+	// Two vectors at a time to hide the latency of the division
+	for( ; i + 16 <= count; i += 16 ) {
+		__m256 result0 = activateAVX2< Function, Accuracy >( _mm256_loadu_ps( input + i ) );
+		__m256 result1 = activateAVX2< Function, Accuracy >( _mm256_loadu_ps( input + i + 8 ) );
+		_mm256_storeu_ps( output + i, result0 );
+		_mm256_storeu_ps( output + i + 8, result1 );
+	}
+
+	for( ; i + 8 <= count; i += 8 ) {
+		_mm256_storeu_ps( output + i, activateAVX2< Function, Accuracy >( _mm256_loadu_ps( input + i ) ) );
+	}
+
+	if( i < count ) {
+		float lanes[ 8 ] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+		std::copy( input + i, input + count, lanes );
+		_mm256_storeu_ps( lanes, activateAVX2< Function, Accuracy >( _mm256_loadu_ps( lanes ) ) );
+		std::copy( lanes, lanes + ( count - i ), output + i );
+	}
+}
+
+template< ActivationAccuracy Accuracy >
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+__m512 tanhAVX512( __m512 input ) {
+	const bool fast = Accuracy == ActivationAccuracy::Fast;
+	const float clamp = fast ? tanh_fast_clamp : tanh_accurate_clamp;
+	const __m512 x = _mm512_min_ps( _mm512_set1_ps( clamp ), _mm512_max_ps( _mm512_set1_ps( -clamp ), input ) );
+	const __m512 x2 = _mm512_mul_ps( x, x );
+
+	if( fast ) {
+		__m512 numerator = _mm512_fmadd_ps( _mm512_set1_ps( tanh_fast_numerator[ 3 ] ), x2, _mm512_set1_ps( tanh_fast_numerator[ 2 ] ) );
+		numerator = _mm512_fmadd_ps( numerator, x2, _mm512_set1_ps( tanh_fast_numerator[ 1 ] ) );
+		numerator = _mm512_fmadd_ps( numerator, x2, _mm512_set1_ps( tanh_fast_numerator[ 0 ] ) );
+
+		__m512 denominator = _mm512_fmadd_ps( _mm512_set1_ps( tanh_fast_denominator[ 3 ] ), x2, _mm512_set1_ps( tanh_fast_denominator[ 2 ] ) );
+		denominator = _mm512_fmadd_ps( denominator, x2, _mm512_set1_ps( tanh_fast_denominator[ 1 ] ) );
+		denominator = _mm512_fmadd_ps( denominator, x2, _mm512_set1_ps( tanh_fast_denominator[ 0 ] ) );
+
+		return _mm512_mul_ps( _mm512_mul_ps( x, numerator ), _mm512_rcp14_ps( denominator ) );
+	}
+
+	__m512 numerator = _mm512_set1_ps( tanh_accurate_numerator[ 6 ] );
+	for( int i = 5; i >= 0; --i ) {
+		numerator = _mm512_fmadd_ps( numerator, x2, _mm512_set1_ps( tanh_accurate_numerator[ i ] ) );
+	}
+
+	__m512 denominator = _mm512_set1_ps( tanh_accurate_denominator[ 3 ] );
+	for( int i = 2; i >= 0; --i ) {
+		denominator = _mm512_fmadd_ps( denominator, x2, _mm512_set1_ps( tanh_accurate_denominator[ i ] ) );
+	}
+
+	return _mm512_div_ps( _mm512_mul_ps( x, numerator ), denominator );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+__m512 activateAVX512( __m512 input ) {
+	if( Function == ActivationFunction::Identity ) {
+		return input;
+	}
+
+	if( Accuracy == ActivationAccuracy::Exact ) {
+		alignas( 64 ) float lanes[ 16 ];
+		_mm512_store_ps( lanes, input );
+		for( unsigned int i = 0; i < 16; ++i ) {
+			lanes[ i ] = activate( Function, Accuracy, lanes[ i ] );
+		}
+		return _mm512_load_ps( lanes );
+	}
+
+	if( Function == ActivationFunction::Tanh ) {
+		return tanhAVX512< Accuracy >( input );
+	}
+
+	const __m512 half = _mm512_set1_ps( 0.5f );
+	return _mm512_fmadd_ps( half, tanhAVX512< Accuracy >( _mm512_mul_ps( half, input ) ), half );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void activationAVX512( const float* input, float* output, unsigned int count ) {
+	unsigned int i = 0;
+
+	for( ; i + 16 <= count; i += 16 ) {
+		_mm512_storeu_ps( output + i, activateAVX512< Function, Accuracy >( _mm512_loadu_ps( input + i ) ) );
+	}
+
+	if( i < count ) {
+		__mmask16 mask = static_cast< __mmask16 >( ( 1u << ( count - i ) ) - 1u );
+		_mm512_mask_storeu_ps( output + i, mask, activateAVX512< Function, Accuracy >( _mm512_maskz_loadu_ps( mask, input + i ) ) );
+	}
+}
+#endif
+
+typedef void ( *ActivationKernel )( const float*, float*, unsigned int );
+
+/**
+ * Pick the widest kernel the CPU supports for an approximate activation function.
+ * @return The selected kernel.
+ */
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+ActivationKernel selectApproximateActivationKernel() {
+#if NN_X86
+	const CPUFeatures& features = CPUFeatures::get();
+
+	if( features.hasAVX512() ) {
+		return activationAVX512< Function, Accuracy >;
+	}
+
+	if( features.hasAVX2() ) {
+		return activationAVX2< Function, Accuracy >;
+	}
+
+	if( features.hasSSE2() ) {
+		return activationSSE2< Function, Accuracy >;
+	}
+#endif
+	return activationScalar< Function, Accuracy >;
+}
+
+/**
+ * Pick the kernel for an activation function at an accuracy tier. Selected once on first use. Exact kernels always call libm, and the identity copies.
+ * @param function The function to evaluate.
+ * @param accuracy The accuracy tier to evaluate it at.
+ * @return The selected kernel.
+ */
+ActivationKernel selectActivationKernel( ActivationFunction function, ActivationAccuracy accuracy ) {
+	static const ActivationKernel tanh_kernels[] = {
+		activationScalar< ActivationFunction::Tanh, ActivationAccuracy::Exact >,
+		selectApproximateActivationKernel< ActivationFunction::Tanh, ActivationAccuracy::Accurate >(),
+		selectApproximateActivationKernel< ActivationFunction::Tanh, ActivationAccuracy::Fast >()
+	};
+
+	static const ActivationKernel sigmoid_kernels[] = {
+		activationScalar< ActivationFunction::Sigmoid, ActivationAccuracy::Exact >,
+		selectApproximateActivationKernel< ActivationFunction::Sigmoid, ActivationAccuracy::Accurate >(),
+		selectApproximateActivationKernel< ActivationFunction::Sigmoid, ActivationAccuracy::Fast >()
+	};
+
+	if( function == ActivationFunction::Identity ) {
+		return activationScalar< ActivationFunction::Identity, ActivationAccuracy::Exact >;
+	}
+
+	const unsigned int tier = static_cast< unsigned int >( accuracy );
+	return function == ActivationFunction::Tanh ? tanh_kernels[ tier ] : sigmoid_kernels[ tier ];
+}
+
+/**
+ * Get the name of the instruction set used by the approximate activation kernels.
+ * @return The instruction set name.
+ */
+const char* getActivationKernelName() {
+#if NN_X86
+	ActivationKernel kernel = selectActivationKernel( ActivationFunction::Tanh, ActivationAccuracy::Fast );
+
+	if( kernel == activationAVX512< ActivationFunction::Tanh, ActivationAccuracy::Fast > ) {
+		return "AVX-512";
+	}
+
+	if( kernel == activationAVX2< ActivationFunction::Tanh, ActivationAccuracy::Fast > ) {
+		return "AVX2";
+	}
+
+	if( kernel == activationSSE2< ActivationFunction::Tanh, ActivationAccuracy::Fast > ) {
+		return "SSE2";
+	}
+#endif
+	return "scalar";
+}
+
+/**
+ * Calculate output = function( input ) for every component.
+ * @param function The function to evaluate.
+ * @param accuracy The accuracy tier to evaluate it at.
+ * @param input The vector to evaluate the function on.
+ * @param output The vector to write the result into. Must match the dimension of the input, and may be the input itself.
+ */
+void applyActivation( ActivationFunction function, ActivationAccuracy accuracy, ConstVectorView input, VectorView output ) {
+#ifdef NN_BOUNDS_CHECK
+	if( input.getDimension() != output.getDimension() ) {
+		throw std::string( "Mismatched dimensions in activation" );
+	}
+#endif
+
+	if( function == ActivationFunction::Identity && input.data() == output.data() && input.getStride() == output.getStride() ) {
+		return;
+	}
+
+	if( input.isContiguous() && output.isContiguous() ) {
+		selectActivationKernel( function, accuracy )( input.data(), output.data(), output.getDimension() );
+		return;
+	}
+
+	for( unsigned int i = 0; i < output.getDimension(); ++i ) {
+		output( i ) = activate( function, accuracy, input( i ) );
+	}
+}
+
+#endif // ACTIVATIONKERNELS_HPP
@@ -0,0 +1,201 @@
+#ifndef ALIGNEDBUFFER_HPP
+#define ALIGNEDBUFFER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include "HugePages.hpp"
+
+/**
+ * A heap buffer whose first element is aligned to a cache line, so SIMD loads never split lines.
+ */
+template< typename T >
+class AlignedBuffer {
+	private:
+		static const std::size_t alignment = 64;
+
+		void* m_allocation;
+		T* m_values;
+		std::size_t m_size;
+
+		// Whether huge pages are wanted, and whether they were wanted when the current memory was allocated
+		bool m_huge_pages;
+		bool m_allocated_huge_pages;
+
+		// Non-zero when the memory is a huge page mapping rather than a heap block
+		std::size_t m_mapped_bytes;
+		PageKind m_page_kind;
+
+		void allocate( std::size_t size ) {
+			m_allocation = nullptr;
+			m_values = nullptr;
+			m_size = size;
+			m_allocated_huge_pages = m_huge_pages;
+			m_mapped_bytes = 0;
+			m_page_kind = PageKind::Normal;
+
+			if( size == 0 ) {
+				return;
+			}
+
+			// Mappings are page aligned, which covers the cache line alignment
+			if( m_huge_pages && size * sizeof( T ) >= huge_page_size ) {
+				m_allocation = allocateHugePages( size * sizeof( T ), m_mapped_bytes, m_page_kind );
+				if( m_allocation != nullptr ) {
+					m_values = static_cast< T* >( m_allocation );
+					return;
+				}
+			}
+
+			m_allocation = std::malloc( size * sizeof( T ) + alignment - 1 );
+			if( m_allocation == nullptr ) {
+				throw std::bad_alloc();
+			}
+
+			std::uintptr_t address = reinterpret_cast< std::uintptr_t >( m_allocation );
+			address = ( address + alignment - 1 ) & ~static_cast< std::uintptr_t >( alignment - 1 );
+			m_values = reinterpret_cast< T* >( address );
+		}
+
+		void release() {
+			if( m_mapped_bytes != 0 ) {
+				releaseHugePages( m_allocation, m_mapped_bytes );
+			} else {
+				std::free( m_allocation );
+			}
+		}
+
+	public:
+		AlignedBuffer() : m_allocation( nullptr ), m_values( nullptr ), m_size( 0 ), m_huge_pages( false ), m_allocated_huge_pages( false ), m_mapped_bytes( 0 ), m_page_kind( PageKind::Normal ) {
+		}
+
+		AlignedBuffer( const AlignedBuffer& other ) : m_huge_pages( other.m_huge_pages ) {
+			allocate( other.m_size );
+			if( m_size != 0 ) {
+				std::memcpy( m_values, other.m_values, m_size * sizeof( T ) );
+			}
+		}
+
+		AlignedBuffer( AlignedBuffer&& other ) noexcept : m_allocation( other.m_allocation ), m_values( other.m_values ), m_size( other.m_size ), m_huge_pages( other.m_huge_pages ), m_allocated_huge_pages( other.m_allocated_huge_pages ), m_mapped_bytes( other.m_mapped_bytes ), m_page_kind( other.m_page_kind ) {
+			other.m_allocation = nullptr;
+			other.m_values = nullptr;
+			other.m_size = 0;
+			other.m_mapped_bytes = 0;
+			other.m_page_kind = PageKind::Normal;
+		}
+
+		~AlignedBuffer() {
+			release();
+		}
+
+		AlignedBuffer& operator=( AlignedBuffer other ) {
+			std::swap( m_allocation, other.m_allocation );
+			std::swap( m_values, other.m_values );
+			std::swap( m_size, other.m_size );
+			std::swap( m_huge_pages, other.m_huge_pages );
+			std::swap( m_allocated_huge_pages, other.m_allocated_huge_pages );
+			std::swap( m_mapped_bytes, other.m_mapped_bytes );
+			std::swap( m_page_kind, other.m_page_kind );
+			return *this;
+		}
+
+		/**
+		 * Set whether the buffer asks for 2 MB pages when it is at least that large. Takes effect on the next resize, and falls back to the heap when no huge pages can be had.
+		 * @param enabled Whether to use huge pages.
+		 */
+		void setHugePages( bool enabled ) {
+			m_huge_pages = enabled;
+		}
+
+		/**
+		 * Get how the buffer's memory is paged.
+		 * @return The kind of pages backing the buffer.
+		 */
+		PageKind getPageKind() const {
+			return m_page_kind;
+		}
+
+		/**
+		 * Move the contents into external memory and use that from now on, until a resize to a different size gives the buffer memory of its own again. Copies of a bound buffer get memory of their own.
+		 * @param values The memory to use, holding at least size() elements and aligned to 64 bytes. Must outlive its use by the buffer. Null moves the contents back into memory of the buffer's own.
+		 */
+		void bind( T* values ) {
+			if( values == m_values ) {
+				return;
+			}
+
+			if( values == nullptr ) {
+				if( isBound() ) {
+					T* bound = m_values;
+					allocate( m_size );
+					std::memcpy( m_values, bound, m_size * sizeof( T ) );
+				}
+
+				return;
+			}
+
+			if( m_size != 0 ) {
+				std::memcpy( values, m_values, m_size * sizeof( T ) );
+			}
+
+			release();
+			m_allocation = nullptr;
+			m_values = values;
+			m_mapped_bytes = 0;
+			m_page_kind = PageKind::Normal;
+		}
+
+		/**
+		 * Whether the buffer is using external memory given to bind().
+		 * @return True if the buffer does not own its memory.
+		 */
+		bool isBound() const {
+			return m_allocation == nullptr && m_values != nullptr;
+		}
+
+		/**
+		 * Resize the buffer. Its contents are undefined afterwards.
+		 * @param size The new number of elements in the buffer.
+		 */
+		void resize( std::size_t size ) {
+			if( size == m_size && ( m_huge_pages == m_allocated_huge_pages || isBound() ) ) {
+				return;
+			}
+
+			release();
+			allocate( size );
+		}
+
+		/**
+		 * Set every byte of the buffer to zero.
+		 */
+		void clear() {
+			if( m_size != 0 ) {
+				std::memset( m_values, 0, m_size * sizeof( T ) );
+			}
+		}
+
+		std::size_t size() const {
+			return m_size;
+		}
+
+		T* data() {
+			return m_values;
+		}
+
+		const T* data() const {
+			return m_values;
+		}
+
+		T& operator[]( std::size_t index ) {
+			return m_values[ index ];
+		}
+
+		const T& operator[]( std::size_t index ) const {
+			return m_values[ index ];
+		}
+};
+
+#endif // ALIGNEDBUFFER_HPP
@@ -0,0 +1,182 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <vector>
+#include "AlignedBuffer.hpp"
+#include "MatrixView.hpp"
+#include "VectorView.hpp"
+
+struct ArenaStatistics {
+	std::size_t bytes_served;
+	std::size_t allocations_served;
+	std::size_t peak_bytes;
+	std::size_t system_allocations;
+};
+
+/**
+ * A bump allocator for scratch memory. Allocations are carved out of large blocks and are never freed individually; instead the whole arena is reset at the end of a training or inference step. Once the arena has grown to fit a step, later steps make no system allocations at all.
+ */
+class Arena {
+	private:
+		// Keep every allocation on a 64 byte boundary
+		static const std::size_t alignment = 16;
+
+		std::vector< AlignedBuffer< float > > m_blocks;
+		std::size_t m_block;
+		std::size_t m_offset;
+		std::size_t m_minimum_block_size;
+
+		ArenaStatistics m_current;
+		ArenaStatistics m_last_step;
+
+		static ArenaStatistics emptyStatistics() {
+			ArenaStatistics statistics = { 0, 0, 0, 0 };
+			return statistics;
+		}
+
+		std::size_t usedBefore( std::size_t block ) const {
+			std::size_t used = 0;
+			for( std::size_t i = 0; i < block; ++i ) {
+				used += m_blocks[ i ].size();
+			}
+			return used;
+		}
+
+	public:
+		/**
+		 * A position in the arena to rewind to.
+		 */
+		struct Marker {
+			std::size_t block;
+			std::size_t offset;
+		};
+
+		Arena( std::size_t minimum_block_size = 1 << 16 ) : m_block( 0 ), m_offset( 0 ), m_minimum_block_size( minimum_block_size ), m_current( emptyStatistics() ), m_last_step( emptyStatistics() ) {
+		}
+
+		/**
+		 * Allocate uninitialized scratch memory valid until the arena is rewound past it or reset.
+		 * @param count The number of floats to allocate.
+		 * @return A pointer to the memory, aligned to 64 bytes.
+		 */
+		float* allocate( std::size_t count ) {
+			std::size_t padded = ( count + alignment - 1 ) / alignment * alignment;
+
+			while( m_block < m_blocks.size() && m_offset + padded > m_blocks[ m_block ].size() ) {
+				++m_block;
+				m_offset = 0;
+			}
+
+			if( m_block == m_blocks.size() ) {
+				m_blocks.emplace_back();
+				m_blocks.back().resize( padded > m_minimum_block_size ? padded : m_minimum_block_size );
+				m_offset = 0;
+				++m_current.system_allocations;
+			}
+
+			float* result = m_blocks[ m_block ].data() + m_offset;
+			m_offset += padded;
+
+			std::size_t used_bytes = ( usedBefore( m_block ) + m_offset ) * sizeof( float );
+			if( used_bytes > m_current.peak_bytes ) {
+				m_current.peak_bytes = used_bytes;
+			}
+
+			m_current.bytes_served += count * sizeof( float );
+			++m_current.allocations_served;
+
+			return result;
+		}
+
+		/**
+		 * Allocate an uninitialized scratch vector.
+		 * @param dimension The dimension of the vector.
+		 * @return A contiguous view of the vector.
+		 */
+		VectorView allocateVector( unsigned int dimension ) {
+			return VectorView( allocate( dimension ), dimension );
+		}
+
+		/**
+		 * Allocate an uninitialized scratch matrix with every row aligned to 64 bytes.
+		 * @param height The height of the matrix.
+		 * @param width The width of the matrix.
+		 * @return A view of the matrix.
+		 */
+		MatrixView allocateMatrix( unsigned int height, unsigned int width ) {
+			unsigned int stride = ( width + alignment - 1 ) / alignment * alignment;
+			return MatrixView( allocate( static_cast< std::size_t >( stride ) * height ), height, width, stride );
+		}
+
+		Marker getMarker() const {
+			Marker marker = { m_block, m_offset };
+			return marker;
+		}
+
+		/**
+		 * Release everything allocated since a marker was taken.
+		 * @param marker The marker to rewind to.
+		 */
+		void rewind( Marker marker ) {
+			m_block = marker.block;
+			m_offset = marker.offset;
+		}
+
+		/**
+		 * End the current step, releasing all allocations and recording the step's statistics. If the step needed more than one block, they are merged so the next step fits in one.
+		 */
+		void reset() {
+			if( m_blocks.size() > 1 ) {
+				std::size_t total = usedBefore( m_blocks.size() );
+				m_blocks.clear();
+				m_blocks.emplace_back();
+				m_blocks.back().resize( total );
+				++m_current.system_allocations;
+			}
+
+			m_block = 0;
+			m_offset = 0;
+
+			m_last_step = m_current;
+			m_current = emptyStatistics();
+		}
+
+		/**
+		 * Get the statistics of the most recently completed step.
+		 * @return The bytes and allocations served during the step, the peak bytes in use, and the number of blocks requested from the system.
+		 */
+		const ArenaStatistics& getStepStatistics() const {
+			return m_last_step;
+		}
+
+		/**
+		 * Get the total size of the blocks owned by the arena.
+		 * @return The capacity in bytes.
+		 */
+		std::size_t getCapacity() const {
+			return usedBefore( m_blocks.size() ) * sizeof( float );
+		}
+};
+
+/**
+ * Rewinds an arena to where it was when the scope was entered, releasing everything allocated in the scope.
+ */
+class ArenaScope {
+	private:
+		Arena& m_arena;
+		Arena::Marker m_marker;
+
+	public:
+		ArenaScope( Arena& arena ) : m_arena( arena ), m_marker( arena.getMarker() ) {
+		}
+
+		~ArenaScope() {
+			m_arena.rewind( m_marker );
+		}
+
+		ArenaScope( const ArenaScope& ) = delete;
+		ArenaScope& operator=( const ArenaScope& ) = delete;
+};
+
+#endif // ARENA_HPP
@@ -1,16 +1,26 @@
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <vector>
 #include <SFML/Audio/InputSoundFile.hpp>
 #include <SFML/Audio/OutputSoundFile.hpp>
 
 #include "json/json.h"
+#include "Benchmark.hpp"
 #include "FFT.hpp"
 #include "FeedForwardLayer.hpp"
 #include "LSTMLayer.hpp"
+#include "MatrixKernels.hpp"
 #include "NeuralNetwork.hpp"
+#include "Optimizer.hpp"
+#include "QuantizedKernels.hpp"
 
 NeuralNetwork network;
+
+// The update rule for training, or null to step by the mutation rate inside train()
+std::unique_ptr< Optimizer > optimizer;
 unsigned int channel_count = 2;
 unsigned int sample_rate = 48000;
 unsigned int step_size = 2048;
@@ -92,52 +102,43 @@ void instructGenerate() {
 	Vector input;
 	input.setDimension( 1 );
 
-	// Multiple Layers
-	// Channel Count< Chunk Count< Frequencies< Magnitude > > >
-	std::vector< std::vector< std::vector< std::complex< float > > > > output_chunks( channel_count );
+	Vector sample;
+	sample.setDimension( network.getOutputCount() );
+
+	// Chunk-major, so each rendered sample is copied into its slice in one go
+	Spectrogram output_chunks( channel_count, length_chunks, chunk_size, SpectrogramLayout::ChunkMajor );
 
 	for( unsigned int i = 0; i < length_chunks; ++i ) {
 		std::cout << i << '/' << length_chunks << " chunks rendered\n";
 
 		input( 0 ) = 2.f * static_cast< float >( i ) / static_cast< float >( length_chunks ) - 1.f;
-		Vector sample = network.propagate( input );
-
-		// Channel Count< Frequencies< Magnitude > >
-		std::vector< std::vector< std::complex< float > > > chunk_data( channel_count, std::vector< std::complex< float > >( chunk_size ) );
+		network.propagate( input, sample );
 
-		for( unsigned int j = 0; j < step_size; ++j ) {
-			for( unsigned int c = 0; c < channel_count; ++c ) {
-				unsigned int sample_pos = 2 * ( channel_count * j + c );
-				chunk_data[ c ][ j ] = std::complex< float >( sample( sample_pos ), sample( sample_pos + 1 ) );
-			}
-		}
+		output_chunks.setInterleavedChunk( i, step_size, sample.data() );
 
 		for( unsigned int j = 1; j < step_size; ++j ) {
 			for( unsigned int c = 0; c < channel_count; ++c ) {
-				chunk_data[ c ][ chunk_size - j ] = std::conj( chunk_data[ c ][ j ] );
+				output_chunks.set( c, i, chunk_size - j, std::conj( output_chunks.get( c, i, j ) ) );
 			}
 		}
-
-		for( unsigned int c = 0; c < channel_count; ++c ) {
-			output_chunks[ c ].push_back( chunk_data[ c ] );
-		}
 	}
 
 	std::cout << "Converting from frequency to time\n";
 
-	std::vector< std::vector< std::complex< float > > > output_time_series( channel_count );
+	std::vector< ComplexBuffer > output_time_series( channel_count );
 
 	for( unsigned int c = 0; c < channel_count; ++c ) {
-		output_time_series[ c ] = istft( output_chunks[ c ] );
+		output_time_series[ c ] = istft( output_chunks, c );
 	}
 
 	std::cout << "Renormalizing\n";
 
 	float max_amp = 0.f;
 	for( unsigned int c = 0; c < channel_count; ++c ) {
+		const float* real = output_time_series[ c ].real();
 		for( unsigned int i = 0; i < output_time_series[ c ].size(); ++i ) {
-			if( std::abs( output_time_series[ c ][ i ].real() ) > max_amp ) {
-				max_amp = std::abs( output_time_series[ c ][ i ].real() );
+			if( std::abs( real[ i ] ) > max_amp ) {
+				max_amp = std::abs( real[ i ] );
 			}
 		}
 	}
@@ -148,7 +149,7 @@ void instructGenerate() {
 
 	for( unsigned int i = 0; i < length_chunks * step_size; ++i ) {
 		for( unsigned int c = 0; c < channel_count; ++c ) {
-			output_samples.push_back( ( output_time_series[ c ][ i ].real() / max_amp ) * 32768 );
+			output_samples.push_back( ( output_time_series[ c ].real()[ i ] / max_amp ) * 32768 );
 		}
 	}
 
@@ -157,12 +158,240 @@ void instructGenerate() {
 	output_file.write( output_samples.data(), output_samples.size() );
 }
 
+void instructAccuracy() {
+	unsigned int length_chunks = 0;
+	std::cout << "Enter number of chunks to compare: ";
+	std::cin >> length_chunks;
+
+	if( length_chunks == 0 ) {
+		return;
+	}
+
+	WeightPrecision precision = network.getWeightPrecision();
+
+	Vector input;
+	input.setDimension( 1 );
+
+	// Generate the reference spectra at full precision, with the same inputs instructGenerate uses
+	std::vector< Vector > reference( length_chunks );
+	network.setWeightPrecision( WeightPrecision::Float32 );
+	network.resetState();
+
+	for( unsigned int i = 0; i < length_chunks; ++i ) {
+		input( 0 ) = 2.f * static_cast< float >( i ) / static_cast< float >( length_chunks ) - 1.f;
+		reference[ i ] = network.propagate( input );
+	}
+
+	network.setWeightPrecision( WeightPrecision::Int8 );
+	network.resetState();
+
+	float max_output_error = 0.f;
+	float max_magnitude_error = 0.f;
+	double signal_energy = 0.0;
+	double error_energy = 0.0;
+
+	Vector quantized;
+	quantized.setDimension( network.getOutputCount() );
+
+	for( unsigned int i = 0; i < length_chunks; ++i ) {
+		input( 0 ) = 2.f * static_cast< float >( i ) / static_cast< float >( length_chunks ) - 1.f;
+		network.propagate( input, quantized );
+
+		for( unsigned int j = 0; j < quantized.getDimension(); ++j ) {
+			max_output_error = std::max( max_output_error, std::abs( quantized( j ) - reference[ i ]( j ) ) );
+		}
+
+		// Outputs are interleaved real and imaginary parts of each channel's frequency bins
+		for( unsigned int j = 0; j + 1 < quantized.getDimension(); j += 2 ) {
+			std::complex< float > expected( reference[ i ]( j ), reference[ i ]( j + 1 ) );
+			std::complex< float > actual( quantized( j ), quantized( j + 1 ) );
+			float magnitude_error = std::abs( actual ) - std::abs( expected );
+
+			max_magnitude_error = std::max( max_magnitude_error, std::abs( magnitude_error ) );
+			signal_energy += std::norm( expected );
+			error_energy += std::norm( actual - expected );
+		}
+	}
+
+	network.setWeightPrecision( precision );
+	network.resetState();
+
+	std::cout << "Quantized inference using " << getInt8KernelName() << " kernels\n";
+	std::cout << "Max output error: " << max_output_error << '\n';
+	std::cout << "Max bin magnitude error: " << max_magnitude_error << '\n';
+
+	if( error_energy > 0.0 ) {
+		std::cout << "Spectral signal to error ratio: " << 10.0 * std::log10( signal_energy / error_energy ) << " dB\n";
+	} else {
+		std::cout << "Spectral signal to error ratio: exact\n";
+	}
+}
+
+void instructBenchmark() {
+	std::cout << "Available Benchmarks:\n";
+	std::cout << "01 - Matrix multiplication GFLOP/s\n";
+	std::cout << "02 - Weight precision bandwidth\n";
+	std::cout << "03 - Thread scaling\n";
+	std::cout << "04 - NUMA placement\n";
+	std::cout << "05 - Huge page dTLB misses\n";
+	std::cout << "06 - Activation function accuracy tiers\n";
+	std::cout << "07 - Minibatch training throughput\n";
+	std::cout << "08 - Optimizer step throughput\n";
+
+	unsigned int type = 0;
+	std::cout << "Enter benchmark to run: ";
+	std::cin >> type;
+
+	switch( type ) {
+		case 1:
+			benchmarkGEMM();
+			break;
+
+		case 2:
+			benchmarkWeightPrecision();
+			break;
+
+		case 3:
+			benchmarkThreadScaling();
+			break;
+
+		case 4:
+			benchmarkNumaPlacement();
+			break;
+
+		case 5:
+			benchmarkHugePages();
+			break;
+
+		case 6:
+			benchmarkActivations();
+			break;
+
+		case 7:
+			benchmarkBatchThroughput();
+			break;
+
+		case 8:
+			benchmarkOptimizers();
+			break;
+
+		default:
+			std::cout << "Invalid benchmark\n";
+			break;
+	}
+}
+
+void instructThreads() {
+	int threads = 0;
+	std::cout << "Enter the number of threads, or 0 for the default: ";
+	std::cin >> threads;
+
+	setKernelThreadCount( threads );
+	std::cout << "Large matrix kernels will use " << getKernelThreadCount() << " threads\n";
+}
+
+void instructActivationAccuracy() {
+	std::cout << "Available Activation Accuracies:\n";
+	std::cout << "01 - Exact, through libm\n";
+	std::cout << "02 - Accurate, within about 1e-6\n";
+	std::cout << "03 - Fast, within about 1e-3\n";
+
+	unsigned int type = 0;
+	std::cout << "Enter accuracy: ";
+	std::cin >> type;
+
+	if( type < 1 || type > 3 ) {
+		std::cout << "Invalid accuracy\n";
+		return;
+	}
+
+	network.setActivationAccuracy( static_cast< ActivationAccuracy >( type - 1 ) );
+	std::cout << "Activations set to " << getActivationAccuracyName( network.getActivationAccuracy() ) << '\n';
+}
+
+/**
+ * Save the network's parameter layout, which optimizer state is keyed to.
+ * @return The layer offsets and parameter count, as an array.
+ */
+Json::Value saveParameterLayout() {
+	std::vector< std::size_t > layout = network.getParameterLayout();
+	Json::Value layout_array( Json::arrayValue );
+
+	for( unsigned int i = 0; i < layout.size(); ++i ) {
+		layout_array.append( Json::Value( static_cast< Json::UInt64 >( layout[ i ] ) ) );
+	}
+
+	return layout_array;
+}
+
+/**
+ * Check a saved parameter layout against the network's. Compares the numbers alone, as parsing may give them a different JSON type than they were saved with.
+ * @param layout_array The layout saved by saveParameterLayout().
+ * @return True if the network's parameters are laid out the same way.
+ */
+bool matchesParameterLayout( const Json::Value& layout_array ) {
+	std::vector< std::size_t > layout = network.getParameterLayout();
+
+	if( !layout_array.isArray() || layout_array.size() != layout.size() ) {
+		return false;
+	}
+
+	for( unsigned int i = 0; i < layout.size(); ++i ) {
+		if( !layout_array[ i ].isIntegral() || layout_array[ i ].asUInt64() != layout[ i ] ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Rebuild the network's layers from their saved form, keeping the optimizer state only if the parameters are laid out as before.
+ */
+void rebuildNetwork() {
+	const std::vector< std::size_t > layout = network.getParameterLayout();
+
+	Json::Value layers = network.saveToJSON();
+	network.loadFromJSON( layers );
+
+	if( optimizer && network.getParameterLayout() != layout ) {
+		optimizer->reset();
+	}
+}
+
+void instructHugePages() {
+	setHugePageMode( !isHugePageMode() );
+
+	// Rebuilding the layers reallocates their weights under the new mode
+	rebuildNetwork();
+
+	std::cout << "Huge page backing " << ( isHugePageMode() ? "enabled" : "disabled" ) << ", network state reset\n";
+}
+
+void instructNuma() {
+	setNumaMode( !isNumaMode() );
+
+	// Rebuilding the layers reallocates their weights, so they are first touched under the new mode
+	rebuildNetwork();
+
+	std::cout << "NUMA aware mode " << ( isNumaMode() ? "enabled" : "disabled" ) << " across " << NumaTopology::get().getNodeCount() << " nodes, network state reset\n";
+}
+
 void instructHelp() {
 	std::cout << "List of commands:\n";
+	std::cout << "a - Report the accuracy of 8 bit quantized inference\n";
+	std::cout << "b - Benchmark the matrix kernels\n";
+	std::cout << "c - Set the number of threads the matrix kernels use\n";
+	std::cout << "f - Set the accuracy of the activation functions\n";
 	std::cout << "g - Generate an output file\n";
 	std::cout << "h - Print this help menu\n";
 	std::cout << "l - Load the neural network from a file\n";
+	std::cout << "m - Toggle huge page backing for weight matrices\n";
+	std::cout << "n - Toggle NUMA aware weight placement and thread pinning\n";
+	std::cout << "o - Choose the optimizer used for training\n";
+	std::cout << "p - Set the precision of the network weights\n";
 	std::cout << "q - Quit the application\n";
+	std::cout << "r - Prune small weights from the neural network\n";
 	std::cout << "s - Save the neural network to a file\n";
 	std::cout << "t - Train on an audio file\n";
 }
@@ -210,6 +439,124 @@ void instructLoad() {
 	step_size = root[ "stft-size" ].asUInt();
 
 	network.loadFromJSON( root[ "layers" ] );
+
+	// Resume with the saved optimizer state, or start the current rule afresh for the new weights
+	if( root.isMember( "optimizer" ) ) {
+		optimizer.reset( createOptimizerFromJSON( root[ "optimizer" ] ) );
+		network.setFlatGradients( optimizer != nullptr );
+
+		// The state is keyed to parameter offsets, so it is only valid for the layout it was saved with
+		if( optimizer && !matchesParameterLayout( root[ "parameter-layout" ] ) ) {
+			std::cout << "Saved optimizer state does not match the network's parameter layout, starting it afresh\n";
+			optimizer->reset();
+		}
+	} else if( optimizer ) {
+		optimizer->reset();
+	}
+}
+
+void instructOptimizer() {
+	std::cout << "Available Optimizers:\n";
+	std::cout << "01 - Stochastic gradient descent by the mutation rate\n";
+	std::cout << "02 - Momentum\n";
+	std::cout << "03 - Nesterov momentum\n";
+	std::cout << "04 - RMSProp\n";
+	std::cout << "05 - Adam\n";
+
+	unsigned int type = 0;
+	std::cout << "Enter optimizer: ";
+	std::cin >> type;
+
+	if( type == 1 ) {
+		optimizer.reset();
+		network.setFlatGradients( false );
+		std::cout << "Training will step by the mutation rate\n";
+		return;
+	}
+
+	if( type < 2 || type > 5 ) {
+		std::cout << "Invalid optimizer\n";
+		return;
+	}
+
+	float rate = 0.f;
+	std::cout << "Enter learning rate: ";
+	std::cin >> rate;
+
+	switch( type ) {
+		case 2:
+			optimizer.reset( new MomentumOptimizer( rate ) );
+			break;
+
+		case 3:
+			optimizer.reset( new NesterovOptimizer( rate ) );
+			break;
+
+		case 4:
+			optimizer.reset( new RMSPropOptimizer( rate ) );
+			break;
+
+		default:
+			optimizer.reset( new AdamOptimizer( rate ) );
+			break;
+	}
+
+	// Flat gradients let the optimizer step every parameter in one pass
+	network.setFlatGradients( true );
+	std::cout << "Optimizer set, using " << getOptimizerKernelName() << " kernels\n";
+}
+
+void instructPrecision() {
+	std::cout << "Available Weight Precisions:\n";
+	std::cout << "01 - 32 bit float\n";
+	std::cout << "02 - 16 bit bfloat\n";
+	std::cout << "03 - 16 bit half float\n";
+	std::cout << "04 - 8 bit integer\n";
+
+	unsigned int type = 0;
+	std::cout << "Enter precision: ";
+	std::cin >> type;
+
+	switch( type ) {
+		case 1:
+			network.setWeightPrecision( WeightPrecision::Float32 );
+			break;
+
+		case 2:
+			network.setWeightPrecision( WeightPrecision::BFloat16 );
+			break;
+
+		case 3:
+			network.setWeightPrecision( WeightPrecision::Float16 );
+			break;
+
+		case 4:
+			network.setWeightPrecision( WeightPrecision::Int8 );
+			break;
+
+		default:
+			std::cout << "Invalid precision\n";
+			return;
+	}
+
+	std::cout << "Weights set to " << getPrecisionName( static_cast< WeightPrecision >( type - 1 ) ) << '\n';
+}
+
+void instructPrune() {
+	float threshold = 0.f;
+	std::cout << "Enter the magnitude below which weights are dropped: ";
+	std::cin >> threshold;
+
+	std::vector< float > densities = network.prune( threshold );
+
+	// Pruning moves the weights, so the optimizer state no longer lines up with them
+	if( optimizer ) {
+		optimizer->reset();
+	}
+
+	for( unsigned int i = 0; i < densities.size(); ++i ) {
+		std::cout << "Layer " << i << " keeps " << densities[ i ] * 100.f << "% of its weights\n";
+	}
 }
 
 void instructSave() {
@@ -220,6 +567,11 @@ void instructSave() {
 	root[ "stft-size" ] = Json::Value( step_size );
 	root[ "layers" ] = network.saveToJSON();
 
+	if( optimizer ) {
+		root[ "optimizer" ] = optimizer->saveToJSON();
+		root[ "parameter-layout" ] = saveParameterLayout();
+	}
+
 	Json::StreamWriterBuilder writer_builder;
 	writer_builder[ "commentStyle" ] = "None";
 	writer_builder[ "indentation" ] = "";
@@ -292,57 +644,63 @@ void instructTrain() {
 	}
 
 	std::cout << "Separating channels\n";
-	std::vector< std::vector< std::complex< float > > > input_waveform( channel_count );
+	std::vector< ComplexBuffer > input_waveform( channel_count );
+
+	for( unsigned int c = 0; c < channel_count; ++c ) {
+		unsigned int channel_length = ( training_samples.size() + channel_count - 1 - c ) / channel_count;
+		input_waveform[ c ].resize( channel_length );
 
-	for( unsigned int i = 0; i <= training_samples.size(); ++i ) {
-		unsigned int channel = i % channel_count;
-		input_waveform[ channel ].push_back( std::complex< float >( training_samples[ i ], 0.f ) );
+		float* real = input_waveform[ c ].real();
+		for( unsigned int i = 0; i < channel_length; ++i ) {
+			real[ i ] = training_samples[ i * channel_count + c ];
+		}
 	}
 
 	std::cout << "Performing fast fourier transform\n";
 
-	std::vector< std::vector< std::vector< std::complex< float > > > > frequency_chunks( channel_count );
-
-	for( unsigned int c = 0; c < channel_count; ++c ) {
-		frequency_chunks[ c ] = stft( input_waveform[ c ], step_size );
-	}
+	// Chunk-major, so each chunk's leading bins are already a training sample in the network's output order
+	Spectrogram frequency_chunks = stft( input_waveform, step_size, SpectrogramLayout::ChunkMajor );
 
 	std::cout << "Renormalizing\n";
 
 	float max_amp = 0.f;
 
-	for( unsigned int c = 0; c < channel_count; ++c ) {
-		for( unsigned int i = 0; i < frequency_chunks[ c ].size(); ++i ) {
-			for( unsigned int j = 0; j < frequency_chunks[ c ][ i ].size(); ++j ) {
-				if( std::abs( frequency_chunks[ c ][ i ][ j ].real() ) > max_amp ) {
-					max_amp = std::abs( frequency_chunks[ c ][ i ][ j ].real() );
-				}
-
-				if( std::abs( frequency_chunks[ c ][ i ][ j ].imag() ) > max_amp ) {
-					max_amp = std::abs( frequency_chunks[ c ][ i ][ j ] );
-				}
-			}
+	const float* values = frequency_chunks.data();
+	for( std::size_t i = 0; i < frequency_chunks.getValueCount(); i += 2 ) {
+		if( std::abs( values[ i ] ) > max_amp ) {
+			max_amp = std::abs( values[ i ] );
 		}
-	}
 
-	for( unsigned int c = 0; c < channel_count; ++c ) {
-		for( unsigned int i = 0; i < frequency_chunks[ c ].size(); ++i ) {
-			for( unsigned int j = 0; j < frequency_chunks[ c ][ i ].size(); ++j ) {
-				frequency_chunks[ c ][ i ][ j ] /= std::complex< float >( max_amp, 0.f );
-			}
+		if( std::abs( values[ i + 1 ] ) > max_amp ) {
+			max_amp = std::abs( std::complex< float >( values[ i ], values[ i + 1 ] ) );
 		}
 	}
 
+	frequency_chunks.scale( 1.f / max_amp );
+
 	unsigned int epochs = 1;
 	std::cout << "Enter number of epochs to train for: ";
 	std::cin >> epochs;
 
 	float mutability = 0.05f;
-	std::cout << "Enter mutation rate: ";
-	std::cin >> mutability;
+	if( !optimizer ) {
+		std::cout << "Enter mutation rate: ";
+		std::cin >> mutability;
+	}
 
-	Vector input;
-	input.setDimension( 1 );
+	unsigned int batch_size = 1;
+	std::cout << "Enter batch size (enter 1 to update after every chunk): ";
+	std::cin >> batch_size;
+
+	if( batch_size < 1 ) {
+		batch_size = 1;
+		std::cout << "Increased batch size to 1\n";
+	}
+
+	const unsigned int chunk_count = frequency_chunks.getChunkCount();
+
+	Matrix inputs;
+	inputs.setSize( batch_size, 1 );
 
 	std::cout << "This may take a while...\n";
 
@@ -350,28 +708,28 @@ void instructTrain() {
 		std::cout << "Training epoch " << e << std::endl;
 		network.resetState();
 
-		for( unsigned int i = 0; i < frequency_chunks[ 0 ].size(); ++i ) {
-			if( i % 10 == 0 ) {
-				std::cout << i << '/' << frequency_chunks[ 0 ].size() << " chunks complete\n";
-			}
-
-			input( 0 ) = 2.f * static_cast< float >( i ) / static_cast< float >( frequency_chunks[ 0 ].size() ) - 1.f;
+		unsigned int reported = 0;
 
-			Vector expected_sample;
-			expected_sample.setDimension( step_size * channel_count * 2 );
+		for( unsigned int i = 0; i < chunk_count; i += batch_size ) {
+			const unsigned int count = std::min( batch_size, chunk_count - i );
 
-			for( unsigned int j = 0; j < step_size; ++j ) {
-				for( unsigned int c = 0; c < channel_count; ++c ) {
-					unsigned int sample_pos = 2 * ( j * channel_count + c );
-					expected_sample( sample_pos ) = frequency_chunks[ c ][ i ][ j ].real();
-					expected_sample( sample_pos + 1 ) = frequency_chunks[ c ][ i ][ j ].imag();
-				}
+			for( unsigned int b = 0; b < count; ++b ) {
+				inputs( b, 0 ) = 2.f * static_cast< float >( i + b ) / static_cast< float >( chunk_count ) - 1.f;
 			}
 
-			float loss = network.train( input, expected_sample, mutability );
+			// The expected samples are read in place, each row striding over the spectrogram's unused bins
+			ConstMatrixView batch_inputs = ConstMatrixView( inputs ).block( 0, 0, count, 1 );
+			ConstMatrixView batch_outputs = frequency_chunks.getInterleavedChunks( i, count, step_size );
+
+			float loss = optimizer ? network.trainBatch( batch_inputs, batch_outputs, *optimizer ) : network.trainBatch( batch_inputs, batch_outputs, mutability );
 
-			if( i % 10 == 0 ) {
-				std::cout << "Loss on current sample = " << loss << std::endl;
+			if( i >= reported ) {
+				reported = i + 10;
+
+				const ArenaStatistics& statistics = network.getStepStatistics();
+				std::cout << i << '/' << chunk_count << " chunks complete\n";
+				std::cout << "Loss on current batch = " << loss / count << " per sample" << std::endl;
+				std::cout << "Scratch memory: " << statistics.bytes_served << " bytes in " << statistics.allocations_served << " allocations, " << statistics.system_allocations << " system allocations\n";
 			}
 		}
 	}
@@ -379,6 +737,7 @@ void instructTrain() {
 
 int main() {
 	std::cout << "Welcome to the audio-based Neural Network test - second attempt\n";
+	std::cout << "Using " << getMatrixKernelName() << " matrix kernels\n";
 
 	std::cout << "Enter sample rate: ";
 	std::cin >> sample_rate;
@@ -409,6 +768,22 @@ int main() {
 		std::cin >> instruction;
 
 		switch( instruction ) {
+			case 'a':
+				instructAccuracy();
+				break;
+
+			case 'b':
+				instructBenchmark();
+				break;
+
+			case 'c':
+				instructThreads();
+				break;
+
+			case 'f':
+				instructActivationAccuracy();
+				break;
+
 			case 'g':
 				instructGenerate();
 				break;
@@ -421,11 +796,31 @@ int main() {
 				instructLoad();
 				break;
 
+			case 'm':
+				instructHugePages();
+				break;
+
+			case 'n':
+				instructNuma();
+				break;
+
+			case 'o':
+				instructOptimizer();
+				break;
+
+			case 'p':
+				instructPrecision();
+				break;
+
 			case 'q':
 				std::cout << "Have a good day!\n";
 				running = false;
 				break;
 
+			case 'r':
+				instructPrune();
+				break;
+
 			case 's':
 				instructSave();
 				break;
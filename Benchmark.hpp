@@ -0,0 +1,778 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ActivationKernels.hpp"
+#include "GEMMKernels.hpp"
+#include "HalfKernels.hpp"
+#include "Matrix.hpp"
+#include "MatrixKernels.hpp"
+#include "NeuralNetwork.hpp"
+#include "NumaTopology.hpp"
+#include "Optimizer.hpp"
+#include "OptimizerKernels.hpp"
+#include "Vector.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Time a piece of work, repeating it until enough time has passed for a stable measurement.
+ * @param work The work to time.
+ * @param minimum_seconds The least total time to spend repeating the work.
+ * @return The average time taken by one repetition, in seconds.
+ */
+template< typename Work >
+double timeRepeated( Work work, double minimum_seconds = 0.5 ) {
+	typedef std::chrono::steady_clock Clock;
+
+	unsigned int repetitions = 0;
+	Clock::time_point start = Clock::now();
+	double elapsed = 0.0;
+
+	do {
+		work();
+		++repetitions;
+		elapsed = std::chrono::duration< double >( Clock::now() - start ).count();
+	} while( elapsed < minimum_seconds );
+
+	return elapsed / repetitions;
+}
+
+/**
+ * Counts data TLB read misses in user space on the calling thread, through perf_event_open. Unavailable off Linux or when the kernel denies access to the counter.
+ */
+class DTLBMissCounter {
+	private:
+		int m_descriptor;
+
+		DTLBMissCounter( const DTLBMissCounter& ) = delete;
+		DTLBMissCounter& operator=( const DTLBMissCounter& ) = delete;
+
+	public:
+		DTLBMissCounter() : m_descriptor( -1 ) {
+#ifdef __linux__
+			perf_event_attr attributes;
+			std::memset( &attributes, 0, sizeof( attributes ) );
+			attributes.size = sizeof( attributes );
+			attributes.type = PERF_TYPE_HW_CACHE;
+			attributes.config = PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+			attributes.disabled = 1;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+
+			m_descriptor = static_cast< int >( syscall( SYS_perf_event_open, &attributes, 0, -1, -1, 0 ) );
+#endif
+		}
+
+		~DTLBMissCounter() {
+#ifdef __linux__
+			if( m_descriptor >= 0 ) {
+				close( m_descriptor );
+			}
+#endif
+		}
+
+		bool isAvailable() const {
+			return m_descriptor >= 0;
+		}
+
+		void start() {
+#ifdef __linux__
+			if( m_descriptor >= 0 ) {
+				ioctl( m_descriptor, PERF_EVENT_IOC_RESET, 0 );
+				ioctl( m_descriptor, PERF_EVENT_IOC_ENABLE, 0 );
+			}
+#endif
+		}
+
+		/**
+		 * Stop counting.
+		 * @return The misses since start, or 0 if the counter is unavailable.
+		 */
+		unsigned long long stop() {
+			unsigned long long misses = 0;
+#ifdef __linux__
+			if( m_descriptor >= 0 ) {
+				ioctl( m_descriptor, PERF_EVENT_IOC_DISABLE, 0 );
+				if( read( m_descriptor, &misses, sizeof( misses ) ) != static_cast< ssize_t >( sizeof( misses ) ) ) {
+					misses = 0;
+				}
+			}
+#endif
+			return misses;
+		}
+};
+
+void fillRandom( Matrix& matrix, std::mt19937& generator ) {
+	std::uniform_real_distribution< float > distribution( -1.f, 1.f );
+
+	for( unsigned int y = 0; y < matrix.getHeight(); ++y ) {
+		for( unsigned int x = 0; x < matrix.getWidth(); ++x ) {
+			matrix( y, x ) = distribution( generator );
+		}
+	}
+}
+
+/**
+ * Compare the blocked matrix-matrix product against the naive triple loop, reporting GFLOP/s for both.
+ */
+void benchmarkGEMM() {
+	struct Shape {
+		unsigned int m;
+		unsigned int k;
+		unsigned int n;
+		const char* description;
+	};
+
+	// Square sizes, then the output layer applied to batches: ( batch x hidden ) * ( hidden x 8192 )
+	const Shape shapes[] = {
+		{ 64, 64, 64, "square" },
+		{ 256, 256, 256, "square" },
+		{ 512, 512, 512, "square" },
+		{ 1024, 1024, 1024, "square" },
+		{ 8, 256, 8192, "batch 8, output layer" },
+		{ 32, 256, 8192, "batch 32, output layer" },
+		{ 128, 256, 8192, "batch 128, output layer" }
+	};
+
+	std::mt19937 generator( 1 );
+	const std::streamsize default_precision = std::cout.precision();
+
+	std::cout << "Matrix multiplication using " << selectGEMMKernel().name << " micro-kernel\n";
+	std::cout << std::setw( 6 ) << "M" << std::setw( 6 ) << "K" << std::setw( 6 ) << "N" << std::setw( 14 ) << "naive GFLOP/s" << std::setw( 16 ) << "blocked GFLOP/s" << std::setw( 10 ) << "speedup" << std::setw( 12 ) << "max error" << "  shape\n";
+
+	for( const Shape& shape : shapes ) {
+		Matrix a;
+		Matrix b;
+		Matrix c_naive;
+		Matrix c_blocked;
+		a.setSize( shape.m, shape.k );
+		b.setSize( shape.n, shape.k );
+		c_naive.setSize( shape.m, shape.n );
+		c_blocked.setSize( shape.m, shape.n );
+		fillRandom( a, generator );
+		fillRandom( b, generator );
+
+		// B is stored like a layer's weights, one row per output, and used transposed
+		double naive_time = timeRepeated( [ & ]() { gemmNaive( a, false, b, true, c_naive ); }, 0.2 );
+		double blocked_time = timeRepeated( [ & ]() { gemm( a, false, b, true, c_blocked ); } );
+
+		float max_error = 0.f;
+		for( unsigned int y = 0; y < shape.m; ++y ) {
+			for( unsigned int x = 0; x < shape.n; ++x ) {
+				max_error = std::max( max_error, std::abs( c_naive( y, x ) - c_blocked( y, x ) ) );
+			}
+		}
+
+		double flops = 2.0 * shape.m * shape.k * shape.n;
+		std::cout << std::setw( 6 ) << shape.m << std::setw( 6 ) << shape.k << std::setw( 6 ) << shape.n;
+		std::cout << std::fixed << std::setprecision( 2 );
+		std::cout << std::setw( 14 ) << flops / naive_time * 1e-9 << std::setw( 16 ) << flops / blocked_time * 1e-9 << std::setw( 9 ) << naive_time / blocked_time << 'x';
+		std::cout << std::scientific << std::setprecision( 1 ) << std::setw( 12 ) << max_error << std::defaultfloat << "  " << shape.description << '\n';
+	}
+
+	std::cout.precision( default_precision );
+}
+
+/**
+ * Time a matrix-vector product over an output-layer sized matrix in each weight precision, reporting the weight bandwidth achieved.
+ */
+void benchmarkWeightPrecision() {
+	const unsigned int height = 8192;
+	const unsigned int width = 1024;
+
+	std::mt19937 generator( 1 );
+	const std::streamsize default_precision = std::cout.precision();
+
+	Matrix weights;
+	weights.setSize( height, width );
+	fillRandom( weights, generator );
+
+	Vector input;
+	input.setDimension( width );
+	for( unsigned int x = 0; x < width; ++x ) {
+		input( x ) = 1.f / ( x + 1 );
+	}
+
+	Vector reference;
+	reference.setDimension( height );
+	gemv( weights, input, ConstVectorView(), reference );
+
+	std::cout << "Matrix-vector product of " << height << 'x' << width << " weights\n";
+	std::cout << std::setw( 10 ) << "precision" << std::setw( 12 ) << "time (ms)" << std::setw( 12 ) << "GB/s" << std::setw( 12 ) << "max error" << '\n';
+
+	const WeightPrecision precisions[] = { WeightPrecision::Float32, WeightPrecision::BFloat16, WeightPrecision::Float16, WeightPrecision::Int8 };
+	for( WeightPrecision precision : precisions ) {
+		weights.setPrecision( precision );
+
+		Vector output;
+		output.setDimension( height );
+		double time = timeRepeated( [ & ]() { gemv( weights, input, ConstVectorView(), output ); } );
+
+		float max_error = 0.f;
+		for( unsigned int y = 0; y < height; ++y ) {
+			max_error = std::max( max_error, std::abs( output( y ) - reference( y ) ) );
+		}
+
+		double bytes = static_cast< double >( weights.getStride() ) * height * sizeof( std::uint16_t );
+		if( precision == WeightPrecision::Float32 ) {
+			bytes = static_cast< double >( weights.getStride() ) * height * sizeof( float );
+		} else if( precision == WeightPrecision::Int8 ) {
+			bytes = static_cast< double >( weights.getQuantized().getStride() ) * height;
+		}
+
+		std::cout << std::setw( 10 ) << getPrecisionName( precision );
+		std::cout << std::fixed << std::setprecision( 3 ) << std::setw( 12 ) << time * 1e3 << std::setw( 12 ) << bytes / time * 1e-9;
+		std::cout << std::scientific << std::setprecision( 1 ) << std::setw( 12 ) << max_error << std::defaultfloat << '\n';
+	}
+
+	std::cout.precision( default_precision );
+}
+
+/**
+ * Chart how forward and backward passes over a wide output layer scale from one thread up to every available thread.
+ */
+void benchmarkThreadScaling() {
+	const unsigned int height = 8192;
+	const unsigned int width = 1024;
+
+#ifdef _OPENMP
+	const int max_threads = omp_get_max_threads();
+#else
+	const int max_threads = 1;
+#endif
+
+	std::mt19937 generator( 1 );
+	const std::streamsize default_precision = std::cout.precision();
+	const int default_threads = getKernelThreadSetting();
+
+	Matrix weights;
+	weights.setSize( height, width );
+	fillRandom( weights, generator );
+
+	Vector input;
+	input.setDimension( width );
+	for( unsigned int x = 0; x < width; ++x ) {
+		input( x ) = 1.f / ( x + 1 );
+	}
+
+	Vector delta;
+	delta.setDimension( height );
+	for( unsigned int y = 0; y < height; ++y ) {
+		delta( y ) = 1.f / ( y + 1 );
+	}
+
+	Vector output;
+	output.setDimension( height );
+
+	Vector new_delta;
+	new_delta.setDimension( width );
+
+	const double bytes = static_cast< double >( weights.getStride() ) * height * sizeof( float );
+
+	std::cout << "Thread scaling of a " << height << 'x' << width << " layer\n";
+	std::cout << std::setw( 8 ) << "threads" << std::setw( 14 ) << "forward (ms)" << std::setw( 10 ) << "GB/s" << std::setw( 10 ) << "speedup";
+	std::cout << std::setw( 15 ) << "backward (ms)" << std::setw( 10 ) << "speedup" << "  forward speedup\n";
+
+	double serial_forward = 0.0;
+	double serial_backward = 0.0;
+
+	for( int threads = 1; threads <= max_threads; ++threads ) {
+		setKernelThreadCount( threads );
+
+		const double forward = timeRepeated( [ & ]() { gemv( weights, input, ConstVectorView(), output ); } );
+
+		// The step is tiny so repeating it leaves the weights effectively unchanged
+		const double backward = timeRepeated( [ & ]() { backwardUpdate( weights, delta, input, 1e-12f, new_delta ); } );
+
+		if( threads == 1 ) {
+			serial_forward = forward;
+			serial_backward = backward;
+		}
+
+		const double forward_speedup = serial_forward / forward;
+
+		std::cout << std::fixed << std::setprecision( 3 ) << std::setw( 8 ) << threads << std::setw( 14 ) << forward * 1e3 << std::setw( 10 ) << bytes / forward * 1e-9;
+		std::cout << std::setprecision( 2 ) << std::setw( 10 ) << forward_speedup;
+		std::cout << std::setprecision( 3 ) << std::setw( 15 ) << backward * 1e3 << std::setprecision( 2 ) << std::setw( 10 ) << serial_backward / backward << "  ";
+		std::cout << std::string( static_cast< std::size_t >( std::lround( forward_speedup * 4.0 ) ), '#' ) << std::defaultfloat << '\n';
+	}
+
+	setKernelThreadCount( default_threads );
+	std::cout.precision( default_precision );
+}
+
+/**
+ * Compare a wide output layer first touched by one thread against one first touched in NUMA mode. For each node, reports the share of its threads' rows resident on it and the forward pass bandwidth its threads achieve, with every thread pinned in both cases.
+ */
+void benchmarkNumaPlacement() {
+	typedef std::chrono::steady_clock Clock;
+
+	const unsigned int height = 8192;
+	const unsigned int width = 1024;
+	const unsigned int repetitions = 50;
+
+	const NumaTopology& topology = NumaTopology::get();
+	const int threads = getKernelThreadCount();
+	const bool default_mode = isNumaMode();
+	const std::streamsize default_precision = std::cout.precision();
+
+	std::mt19937 generator( 1 );
+	GEMVKernel kernel = selectGEMVKernel();
+
+	Vector input;
+	input.setDimension( width );
+	for( unsigned int x = 0; x < width; ++x ) {
+		input( x ) = 1.f / ( x + 1 );
+	}
+
+	Vector output;
+	output.setDimension( height );
+
+	std::cout << topology.getNodeCount() << " NUMA nodes, " << threads << " kernel threads, " << height << 'x' << width << " layer\n";
+	std::cout << std::setw( 14 ) << "placement" << std::setw( 6 ) << "node" << std::setw( 10 ) << "threads" << std::setw( 12 ) << "local (%)" << std::setw( 10 ) << "GB/s" << '\n';
+
+	for( int numa_placement = 0; numa_placement < 2; ++numa_placement ) {
+		setNumaMode( numa_placement != 0 );
+
+		Matrix weights;
+		weights.setSize( height, width );
+		fillRandom( weights, generator );
+
+		setNumaMode( true );
+
+		std::vector< double > seconds( threads, 0.0 );
+		std::vector< std::size_t > local_pages( threads, 0 );
+		std::vector< std::size_t > pages( threads, 0 );
+
+		#pragma omp parallel num_threads( threads )
+		{
+#ifdef _OPENMP
+			const int thread = omp_get_thread_num();
+#else
+			const int thread = 0;
+#endif
+			const unsigned int first = static_cast< unsigned int >( static_cast< std::size_t >( height ) * thread / threads );
+			const unsigned int last = static_cast< unsigned int >( static_cast< std::size_t >( height ) * ( thread + 1 ) / threads );
+			const float* rows = weights.data() + static_cast< std::size_t >( first ) * weights.getStride();
+
+			bindKernelThread( thread, threads );
+
+			std::vector< int > nodes = getPageNodes( rows, static_cast< std::size_t >( last - first ) * weights.getStride() * sizeof( float ) );
+			for( unsigned int i = 0; i < nodes.size(); ++i ) {
+				local_pages[ thread ] += nodes[ i ] == static_cast< int >( topology.getThreadNode( thread, threads ) ) ? 1 : 0;
+			}
+			pages[ thread ] = nodes.size();
+
+			#pragma omp barrier
+			Clock::time_point start = Clock::now();
+			for( unsigned int i = 0; i < repetitions; ++i ) {
+				kernel( rows, weights.getStride(), last - first, width, input.data(), nullptr, output.data() + first );
+			}
+			seconds[ thread ] = std::chrono::duration< double >( Clock::now() - start ).count() / repetitions;
+		}
+
+		for( unsigned int node = 0; node < topology.getNodeCount(); ++node ) {
+			double bytes = 0.0;
+			double time = 0.0;
+			std::size_t node_local_pages = 0;
+			std::size_t node_pages = 0;
+			int node_threads = 0;
+
+			// A node's rows are done when its slowest thread is
+			for( int thread = 0; thread < threads; ++thread ) {
+				if( topology.getThreadNode( thread, threads ) != node ) {
+					continue;
+				}
+
+				const unsigned int first = static_cast< unsigned int >( static_cast< std::size_t >( height ) * thread / threads );
+				const unsigned int last = static_cast< unsigned int >( static_cast< std::size_t >( height ) * ( thread + 1 ) / threads );
+				bytes += static_cast< double >( last - first ) * weights.getStride() * sizeof( float );
+				time = std::max( time, seconds[ thread ] );
+				node_local_pages += local_pages[ thread ];
+				node_pages += pages[ thread ];
+				++node_threads;
+			}
+
+			if( node_threads == 0 ) {
+				continue;
+			}
+
+			std::cout << std::setw( 14 ) << ( numa_placement ? "numa" : "single thread" ) << std::setw( 6 ) << node << std::setw( 10 ) << node_threads;
+			if( node_pages > 0 ) {
+				std::cout << std::fixed << std::setprecision( 1 ) << std::setw( 12 ) << 100.0 * node_local_pages / node_pages;
+			} else {
+				std::cout << std::setw( 12 ) << "n/a";
+			}
+			std::cout << std::fixed << std::setprecision( 3 ) << std::setw( 10 ) << bytes / time * 1e-9 << std::defaultfloat << '\n';
+		}
+	}
+
+	setNumaMode( default_mode );
+	std::cout.precision( default_precision );
+}
+
+/**
+ * Compare the forward and backward passes of a wide output layer with and without huge page backing, counting data TLB misses per pass. Runs on one thread so the counter sees every access.
+ */
+void benchmarkHugePages() {
+	const unsigned int height = 8192;
+	const unsigned int width = 1024;
+	const unsigned int repetitions = 20;
+
+	std::mt19937 generator( 1 );
+	const std::streamsize default_precision = std::cout.precision();
+	const bool default_mode = isHugePageMode();
+	const int default_threads = getKernelThreadSetting();
+
+	DTLBMissCounter counter;
+	if( !counter.isAvailable() ) {
+		std::cout << "dTLB miss counter unavailable, check perf_event_paranoid; reporting times only\n";
+	}
+
+	Vector input;
+	input.setDimension( width );
+	for( unsigned int x = 0; x < width; ++x ) {
+		input( x ) = 1.f / ( x + 1 );
+	}
+
+	Vector delta;
+	delta.setDimension( height );
+	for( unsigned int y = 0; y < height; ++y ) {
+		delta( y ) = 1.f / ( y + 1 );
+	}
+
+	Vector output;
+	output.setDimension( height );
+
+	Vector new_delta;
+	new_delta.setDimension( width );
+
+	setKernelThreadCount( 1 );
+
+	std::cout << "Single thread passes over a " << height << 'x' << width << " layer\n";
+	std::cout << std::setw( 18 ) << "pages" << std::setw( 12 ) << "huge (MB)" << std::setw( 14 ) << "forward (ms)" << std::setw( 16 ) << "forward misses";
+	std::cout << std::setw( 15 ) << "backward (ms)" << std::setw( 17 ) << "backward misses" << '\n';
+
+	for( int huge = 0; huge < 2; ++huge ) {
+		setHugePageMode( huge != 0 );
+
+		Matrix weights;
+		weights.setSize( height, width );
+		fillRandom( weights, generator );
+
+		const double forward = timeRepeated( [ & ]() { gemv( weights, input, ConstVectorView(), output ); } );
+
+		counter.start();
+		for( unsigned int i = 0; i < repetitions; ++i ) {
+			gemv( weights, input, ConstVectorView(), output );
+		}
+		const unsigned long long forward_misses = counter.stop();
+
+		// The step is tiny so repeating it leaves the weights effectively unchanged
+		const double backward = timeRepeated( [ & ]() { backwardUpdate( weights, delta, input, 1e-12f, new_delta ); } );
+
+		counter.start();
+		for( unsigned int i = 0; i < repetitions; ++i ) {
+			backwardUpdate( weights, delta, input, 1e-12f, new_delta );
+		}
+		const unsigned long long backward_misses = counter.stop();
+
+		// Explicit huge pages are huge by construction, advised ones only as far as the kernel obliged
+		std::size_t huge_bytes = 0;
+		if( weights.getPageKind() == PageKind::ExplicitHuge ) {
+			huge_bytes = static_cast< std::size_t >( weights.getStride() ) * height * sizeof( float );
+		} else if( weights.getPageKind() == PageKind::TransparentHuge ) {
+			huge_bytes = getTransparentHugeBytes( weights.data() );
+		}
+
+		std::cout << std::setw( 18 ) << getPageKindName( weights.getPageKind() ) << std::fixed << std::setprecision( 1 ) << std::setw( 12 ) << huge_bytes / 1048576.0;
+		std::cout << std::setprecision( 3 ) << std::setw( 14 ) << forward * 1e3;
+		if( counter.isAvailable() ) {
+			std::cout << std::setw( 16 ) << forward_misses / repetitions;
+		} else {
+			std::cout << std::setw( 16 ) << "n/a";
+		}
+		std::cout << std::setw( 15 ) << backward * 1e3;
+		if( counter.isAvailable() ) {
+			std::cout << std::setw( 17 ) << backward_misses / repetitions;
+		} else {
+			std::cout << std::setw( 17 ) << "n/a";
+		}
+		std::cout << std::defaultfloat << '\n';
+	}
+
+	setHugePageMode( default_mode );
+	setKernelThreadCount( default_threads );
+	std::cout.precision( default_precision );
+}
+
+/**
+ * Time tanh and sigmoid at every accuracy tier over an output layer's worth of values, and report each tier's error against libm in double precision over a dense sweep of [-12, 12]. Then compare applying tanh after a matrix-vector product against fusing it into the product's kernel.
+ */
+void benchmarkActivations() {
+	const unsigned int count = 8192;
+	const unsigned int sweep_count = 1 << 21;
+	const float sweep_range = 12.f;
+
+	const std::streamsize default_precision = std::cout.precision();
+
+	std::mt19937 generator( 1 );
+	std::uniform_real_distribution< float > distribution( -4.f, 4.f );
+
+	Vector input;
+	input.setDimension( count );
+	for( unsigned int i = 0; i < count; ++i ) {
+		input( i ) = distribution( generator );
+	}
+
+	Vector sweep;
+	sweep.setDimension( sweep_count );
+	for( unsigned int i = 0; i < sweep_count; ++i ) {
+		sweep( i ) = sweep_range * ( 2.f * static_cast< float >( i ) / static_cast< float >( sweep_count - 1 ) - 1.f );
+	}
+
+	Vector output;
+	output.setDimension( sweep_count );
+
+	std::cout << "Activations of " << count << " values using " << getActivationKernelName() << " kernels\n";
+	std::cout << std::setw( 9 ) << "function" << std::setw( 10 ) << "accuracy" << std::setw( 10 ) << "ns/value" << std::setw( 10 ) << "speedup" << std::setw( 12 ) << "max error" << std::setw( 12 ) << "rms error" << '\n';
+
+	const ActivationFunction functions[] = { ActivationFunction::Tanh, ActivationFunction::Sigmoid };
+	const ActivationAccuracy accuracies[] = { ActivationAccuracy::Exact, ActivationAccuracy::Accurate, ActivationAccuracy::Fast };
+
+	for( ActivationFunction function : functions ) {
+		double exact_time = 0.0;
+
+		for( ActivationAccuracy accuracy : accuracies ) {
+			ActivationKernel kernel = selectActivationKernel( function, accuracy );
+			const double time = timeRepeated( [ & ]() { kernel( input.data(), output.data(), count ); } );
+
+			if( accuracy == ActivationAccuracy::Exact ) {
+				exact_time = time;
+			}
+
+			kernel( sweep.data(), output.data(), sweep_count );
+
+			double max_error = 0.0;
+			double square_error = 0.0;
+			for( unsigned int i = 0; i < sweep_count; ++i ) {
+				const double x = sweep( i );
+				const double expected = function == ActivationFunction::Tanh ? std::tanh( x ) : 1.0 / ( 1.0 + std::exp( -x ) );
+				const double error = std::abs( output( i ) - expected );
+				max_error = std::max( max_error, error );
+				square_error += error * error;
+			}
+
+			std::cout << std::setw( 9 ) << ( function == ActivationFunction::Tanh ? "tanh" : "sigmoid" ) << std::setw( 10 ) << getActivationAccuracyName( accuracy );
+			std::cout << std::fixed << std::setprecision( 3 ) << std::setw( 10 ) << time / count * 1e9 << std::setprecision( 2 ) << std::setw( 9 ) << exact_time / time << 'x';
+			std::cout << std::scientific << std::setprecision( 1 ) << std::setw( 12 ) << max_error << std::setw( 12 ) << std::sqrt( square_error / sweep_count ) << std::defaultfloat << '\n';
+		}
+	}
+
+	// A layer narrow enough that the second pass over its outputs is a visible share of the work
+	const unsigned int height = 8192;
+	const unsigned int width = 64;
+
+	Matrix weights;
+	weights.setSize( height, width );
+	fillRandom( weights, generator );
+
+	Vector bias;
+	bias.setDimension( height );
+	for( unsigned int y = 0; y < height; ++y ) {
+		bias( y ) = distribution( generator );
+	}
+
+	std::cout << "Bias and tanh after a " << height << 'x' << width << " matrix-vector product\n";
+	std::cout << std::setw( 10 ) << "accuracy" << std::setw( 15 ) << "separate (us)" << std::setw( 12 ) << "fused (us)" << std::setw( 10 ) << "speedup" << '\n';
+
+	for( ActivationAccuracy accuracy : accuracies ) {
+		VectorView layer_input = VectorView( input ).slice( 0, width );
+		VectorView layer_output = VectorView( output ).slice( 0, height );
+
+		const double separate = timeRepeated( [ & ]() {
+			gemv( weights, layer_input, bias, layer_output );
+			applyActivation( ActivationFunction::Tanh, accuracy, layer_output, layer_output );
+		} );
+		const double fused = timeRepeated( [ & ]() { gemv( weights, layer_input, bias, layer_output, ActivationFunction::Tanh, accuracy ); } );
+
+		std::cout << std::setw( 10 ) << getActivationAccuracyName( accuracy );
+		std::cout << std::fixed << std::setprecision( 2 ) << std::setw( 15 ) << separate * 1e6 << std::setw( 12 ) << fused * 1e6 << std::setw( 9 ) << separate / fused << 'x' << std::defaultfloat << '\n';
+	}
+
+	std::cout.precision( default_precision );
+}
+
+/**
+ * Compare the throughput of a feed-forward network at several batch sizes, in samples per second. Batch size 1 is the sample at a time path. Training is timed both with the plain step and through an Adam optimizer, which computes the batch's gradients before stepping.
+ */
+void benchmarkBatchThroughput() {
+	const unsigned int layer_sizes[] = { 256, 1024, 1024, 256 };
+	const unsigned int batch_sizes[] = { 1, 8, 32, 128 };
+	const unsigned int sample_count = 128;
+
+	std::mt19937 generator( 1 );
+	const std::streamsize default_precision = std::cout.precision();
+
+	NeuralNetwork batch_network;
+	for( unsigned int i = 1; i < sizeof( layer_sizes ) / sizeof( layer_sizes[ 0 ] ); ++i ) {
+		FeedForwardLayer* layer = new FeedForwardLayer;
+		layer->setInputCount( layer_sizes[ i - 1 ] );
+		layer->setOutputCount( layer_sizes[ i ] );
+		batch_network.addLayer( layer );
+	}
+
+	Matrix inputs;
+	inputs.setSize( sample_count, batch_network.getInputCount() );
+	fillRandom( inputs, generator );
+
+	Matrix expected;
+	expected.setSize( sample_count, batch_network.getOutputCount() );
+	fillRandom( expected, generator );
+
+	Matrix outputs;
+	outputs.setSize( sample_count, batch_network.getOutputCount() );
+
+	ConstMatrixView all_inputs = inputs;
+	ConstMatrixView all_expected = expected;
+	MatrixView all_outputs = outputs;
+
+	std::cout << "Throughput of a " << layer_sizes[ 0 ];
+	for( unsigned int i = 1; i < sizeof( layer_sizes ) / sizeof( layer_sizes[ 0 ] ); ++i ) {
+		std::cout << '-' << layer_sizes[ i ];
+	}
+	std::cout << " feed-forward network using " << selectGEMMKernel().name << " GEMM kernels\n";
+	std::cout << std::setw( 6 ) << "batch" << std::setw( 18 ) << "propagate (1/s)" << std::setw( 10 ) << "speedup" << std::setw( 14 ) << "train (1/s)" << std::setw( 10 ) << "speedup" << std::setw( 13 ) << "Adam (1/s)" << std::setw( 10 ) << "speedup" << '\n';
+
+	// Adam's steps are about its rate in size whatever the gradients, so a tiny rate also leaves the weights effectively unchanged
+	AdamOptimizer optimizer( 1e-12f );
+
+	double single_propagate = 0.0;
+	double single_train = 0.0;
+	double single_optimizer = 0.0;
+
+	for( unsigned int batch_size : batch_sizes ) {
+		const double propagate_time = timeRepeated( [ & ]() {
+			for( unsigned int b = 0; b < sample_count; b += batch_size ) {
+				batch_network.propagateBatch( all_inputs.block( b, 0, batch_size, all_inputs.getWidth() ), all_outputs.block( b, 0, batch_size, all_outputs.getWidth() ) );
+			}
+		} );
+
+		// The steps are tiny so repeating them leaves the weights effectively unchanged
+		const double train_time = timeRepeated( [ & ]() {
+			for( unsigned int b = 0; b < sample_count; b += batch_size ) {
+				batch_network.trainBatch( all_inputs.block( b, 0, batch_size, all_inputs.getWidth() ), all_expected.block( b, 0, batch_size, all_expected.getWidth() ), 1e-12f );
+			}
+		} );
+
+		const double optimizer_time = timeRepeated( [ & ]() {
+			for( unsigned int b = 0; b < sample_count; b += batch_size ) {
+				batch_network.trainBatch( all_inputs.block( b, 0, batch_size, all_inputs.getWidth() ), all_expected.block( b, 0, batch_size, all_expected.getWidth() ), optimizer );
+			}
+		} );
+
+		const double propagate_rate = sample_count / propagate_time;
+		const double train_rate = sample_count / train_time;
+		const double optimizer_rate = sample_count / optimizer_time;
+
+		if( batch_size == 1 ) {
+			single_propagate = propagate_rate;
+			single_train = train_rate;
+			single_optimizer = optimizer_rate;
+		}
+
+		std::cout << std::fixed << std::setprecision( 0 ) << std::setw( 6 ) << batch_size << std::setw( 18 ) << propagate_rate << std::setprecision( 2 ) << std::setw( 9 ) << propagate_rate / single_propagate << 'x';
+		std::cout << std::setprecision( 0 ) << std::setw( 14 ) << train_rate << std::setprecision( 2 ) << std::setw( 9 ) << train_rate / single_train << 'x';
+		std::cout << std::setprecision( 0 ) << std::setw( 13 ) << optimizer_rate << std::setprecision( 2 ) << std::setw( 9 ) << optimizer_rate / single_optimizer << 'x' << std::defaultfloat << '\n';
+	}
+
+	std::cout.precision( default_precision );
+}
+
+/**
+ * Compare each optimizer's step over a large network's worth of parameters against its scalar reference, in millions of parameters per second. The optimizers run through update(), so they are vectorized and split across the kernel threads.
+ */
+void benchmarkOptimizers() {
+	const std::size_t count = 1 << 22;
+
+	std::mt19937 generator( 1 );
+	std::uniform_real_distribution< float > distribution( -1.f, 1.f );
+	const std::streamsize default_precision = std::cout.precision();
+
+	AlignedBuffer< float > parameters;
+	AlignedBuffer< float > gradients;
+	AlignedBuffer< float > first_state;
+	AlignedBuffer< float > second_state;
+	parameters.resize( count );
+	gradients.resize( count );
+	first_state.resize( count );
+	second_state.resize( count );
+
+	for( std::size_t i = 0; i < count; ++i ) {
+		parameters[ i ] = distribution( generator );
+		gradients[ i ] = distribution( generator );
+	}
+
+	std::cout << "Optimizer steps over " << count << " parameters using " << getOptimizerKernelName() << " kernels and " << getKernelThreadCount( count ) << " threads\n";
+	std::cout << std::setw( 10 ) << "optimizer" << std::setw( 16 ) << "scalar (M/s)" << std::setw( 16 ) << "update (M/s)" << std::setw( 10 ) << "speedup" << '\n';
+
+	// The rates are tiny so repeating the steps leaves the parameters effectively unchanged
+	const float rate = 1e-12f;
+	float* values = parameters.data();
+	const float* gradient_values = gradients.data();
+	float* first = first_state.data();
+	float* second = second_state.data();
+
+	SGDOptimizer sgd( rate );
+	MomentumOptimizer momentum( rate );
+	NesterovOptimizer nesterov( rate );
+	RMSPropOptimizer rms_prop( rate );
+	AdamOptimizer adam( rate );
+
+	struct Rule {
+		const char* name;
+		Optimizer* optimizer;
+		std::function< void() > reference;
+	};
+
+	const Rule rules[] = {
+		{ "sgd", &sgd, [ & ]() { sgdScalar( values, gradient_values, count, rate, 1.f ); } },
+		{ "momentum", &momentum, [ & ]() { momentumScalar< false >( values, gradient_values, first, count, rate, 0.9f, 1.f ); } },
+		{ "nesterov", &nesterov, [ & ]() { momentumScalar< true >( values, gradient_values, first, count, rate, 0.9f, 1.f ); } },
+		{ "rmsprop", &rms_prop, [ & ]() { rmsPropScalar( values, gradient_values, first, count, rate, 0.9f, 1e-8f, 1.f ); } },
+		{ "adam", &adam, [ & ]() { adamScalar( values, gradient_values, first, second, count, rate, 0.9f, 0.999f, 1e-8f, 1.f ); } }
+	};
+
+	for( const Rule& rule : rules ) {
+		// Each reference starts from fresh state, as the previous rule's would not be valid for it
+		first_state.clear();
+		second_state.clear();
+
+		const double reference_time = timeRepeated( rule.reference );
+		const double update_time = timeRepeated( [ & ]() {
+			rule.optimizer->beginStep( count );
+			rule.optimizer->update( 0, values, gradient_values, count );
+		} );
+
+		std::cout << std::setw( 10 ) << rule.name << std::fixed << std::setprecision( 0 ) << std::setw( 16 ) << count / reference_time * 1e-6 << std::setw( 16 ) << count / update_time * 1e-6;
+		std::cout << std::setprecision( 2 ) << std::setw( 9 ) << reference_time / update_time << 'x' << std::defaultfloat << '\n';
+	}
+
+	std::cout.precision( default_precision );
+}
+
+#endif // BENCHMARK_HPP
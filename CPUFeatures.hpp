@@ -0,0 +1,66 @@
+#ifndef CPUFEATURES_HPP
+#define CPUFEATURES_HPP
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define NN_X86 1
+#else
+#define NN_X86 0
+#endif
+
+class CPUFeatures {
+	private:
+		bool m_sse2;
+		bool m_avx2;
+		bool m_avx512;
+		bool m_f16c;
+		bool m_avx_vnni;
+		bool m_avx512_vnni;
+
+		CPUFeatures() : m_sse2( false ), m_avx2( false ), m_avx512( false ), m_f16c( false ), m_avx_vnni( false ), m_avx512_vnni( false ) {
+#if NN_X86
+			__builtin_cpu_init();
+			m_sse2 = __builtin_cpu_supports( "sse2" );
+			m_avx2 = __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+			m_avx512 = m_avx2 && __builtin_cpu_supports( "avx512f" );
+			m_f16c = __builtin_cpu_supports( "f16c" );
+			m_avx_vnni = m_avx2 && __builtin_cpu_supports( "avxvnni" );
+			m_avx512_vnni = m_avx512 && __builtin_cpu_supports( "avx512vnni" );
+#endif
+		}
+
+	public:
+		/**
+		 * Get the features of the CPU the program is running on. Detected once on first use.
+		 * @return The detected CPU features.
+		 */
+		static const CPUFeatures& get() {
+			static const CPUFeatures features;
+			return features;
+		}
+
+		bool hasSSE2() const {
+			return m_sse2;
+		}
+
+		bool hasAVX2() const {
+			return m_avx2;
+		}
+
+		bool hasAVX512() const {
+			return m_avx512;
+		}
+
+		bool hasF16C() const {
+			return m_f16c;
+		}
+
+		bool hasAVXVNNI() const {
+			return m_avx_vnni;
+		}
+
+		bool hasAVX512VNNI() const {
+			return m_avx512_vnni;
+		}
+};
+
+#endif // CPUFEATURES_HPP
@@ -0,0 +1,136 @@
+#ifndef COMPLEXBUFFER_HPP
+#define COMPLEXBUFFER_HPP
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+#include "AlignedBuffer.hpp"
+
+/**
+ * A sequence of complex numbers stored as separate real and imaginary arrays, so transforms can load several real or imaginary parts with one vector load instead of shuffling interleaved pairs apart.
+ */
+class ComplexBuffer {
+	private:
+		AlignedBuffer< float > m_real;
+		AlignedBuffer< float > m_imag;
+		unsigned int m_size;
+
+	public:
+		ComplexBuffer() : m_size( 0 ) {
+		}
+
+		/**
+		 * Create a buffer of zeros.
+		 * @param size The number of complex values.
+		 */
+		explicit ComplexBuffer( unsigned int size ) : m_size( 0 ) {
+			resize( size );
+		}
+
+		/**
+		 * Resize the buffer, setting every value to zero.
+		 * @param size The new number of complex values.
+		 */
+		void resize( unsigned int size ) {
+			m_size = size;
+			m_real.resize( size );
+			m_imag.resize( size );
+			m_real.clear();
+			m_imag.clear();
+		}
+
+		unsigned int size() const {
+			return m_size;
+		}
+
+		float* real() {
+			return m_real.data();
+		}
+
+		const float* real() const {
+			return m_real.data();
+		}
+
+		float* imag() {
+			return m_imag.data();
+		}
+
+		const float* imag() const {
+			return m_imag.data();
+		}
+
+		std::complex< float > get( unsigned int index ) const {
+			return std::complex< float >( m_real[ index ], m_imag[ index ] );
+		}
+
+		void set( unsigned int index, std::complex< float > value ) {
+			m_real[ index ] = value.real();
+			m_imag[ index ] = value.imag();
+		}
+
+		/**
+		 * Convert from the interleaved layout of std::complex.
+		 * @param values The values to convert.
+		 * @return The values split into real and imaginary arrays.
+		 */
+		static ComplexBuffer fromComplex( const std::vector< std::complex< float > >& values ) {
+			ComplexBuffer buffer( static_cast< unsigned int >( values.size() ) );
+
+			for( unsigned int i = 0; i < buffer.size(); ++i ) {
+				buffer.m_real[ i ] = values[ i ].real();
+				buffer.m_imag[ i ] = values[ i ].imag();
+			}
+
+			return buffer;
+		}
+
+		/**
+		 * Convert to the interleaved layout of std::complex.
+		 * @return The values as std::complex.
+		 */
+		std::vector< std::complex< float > > toComplex() const {
+			std::vector< std::complex< float > > values( m_size );
+
+			for( unsigned int i = 0; i < m_size; ++i ) {
+				values[ i ] = std::complex< float >( m_real[ i ], m_imag[ i ] );
+			}
+
+			return values;
+		}
+
+		/**
+		 * Write a range of values as real and imaginary pairs, such as into a network's output order.
+		 * @param first The index of the first value to write.
+		 * @param count The number of values to write.
+		 * @param output Where the first pair goes. Each pair's real part is followed directly by its imaginary part.
+		 * @param stride The distance in floats between the starts of consecutive pairs, 2 for densely packed pairs.
+		 */
+		void copyToInterleaved( unsigned int first, unsigned int count, float* output, std::size_t stride ) const {
+			const float* real_values = m_real.data() + first;
+			const float* imag_values = m_imag.data() + first;
+
+			for( unsigned int i = 0; i < count; ++i ) {
+				output[ i * stride ] = real_values[ i ];
+				output[ i * stride + 1 ] = imag_values[ i ];
+			}
+		}
+
+		/**
+		 * Read a range of values from real and imaginary pairs, such as a network's output.
+		 * @param first The index of the first value to read into.
+		 * @param count The number of values to read.
+		 * @param input Where the first pair is. Each pair's real part is followed directly by its imaginary part.
+		 * @param stride The distance in floats between the starts of consecutive pairs, 2 for densely packed pairs.
+		 */
+		void copyFromInterleaved( unsigned int first, unsigned int count, const float* input, std::size_t stride ) {
+			float* real_values = m_real.data() + first;
+			float* imag_values = m_imag.data() + first;
+
+			for( unsigned int i = 0; i < count; ++i ) {
+				real_values[ i ] = input[ i * stride ];
+				imag_values[ i ] = input[ i * stride + 1 ];
+			}
+		}
+};
+
+#endif // COMPLEXBUFFER_HPP
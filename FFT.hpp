@@ -1,49 +1,219 @@
 #ifndef FFT_HPP
 #define FFT_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <complex>
 #include <vector>
+#include "ComplexBuffer.hpp"
+#include "CPUFeatures.hpp"
+#include "Spectrogram.hpp"
+
+#if NN_X86
+#include <immintrin.h>
+#endif
 
 const float pi = std::acos( -1.f );
 
+/**
+ * Reference radix-2 butterflies: for each k, with v = twiddle[ k ] * bottom[ k ], top[ k ] becomes top[ k ] + v and bottom[ k ] becomes top[ k ] - v.
+ * @param top_real The real parts of the top half of the butterflies.
+ * @param top_imag The imaginary parts of the top half of the butterflies.
+ * @param bottom_real The real parts of the bottom half of the butterflies.
+ * @param bottom_imag The imaginary parts of the bottom half of the butterflies.
+ * @param twiddle_real The real parts of the twiddle factors.
+ * @param twiddle_imag The imaginary parts of the twiddle factors.
+ * @param count The number of butterflies.
+ */
+void fftButterfliesScalar( float* top_real, float* top_imag, float* bottom_real, float* bottom_imag, const float* twiddle_real, const float* twiddle_imag, unsigned int count ) {
+	for( unsigned int k = 0; k < count; ++k ) {
+		const float product_real = bottom_real[ k ] * twiddle_real[ k ] - bottom_imag[ k ] * twiddle_imag[ k ];
+		const float product_imag = bottom_real[ k ] * twiddle_imag[ k ] + bottom_imag[ k ] * twiddle_real[ k ];
+		const float real = top_real[ k ];
+		const float imag = top_imag[ k ];
+
+		top_real[ k ] = real + product_real;
+		top_imag[ k ] = imag + product_imag;
+		bottom_real[ k ] = real - product_real;
+		bottom_imag[ k ] = imag - product_imag;
+	}
+}
+
+#if NN_X86
+// Split real and imaginary arrays turn each complex multiply into plain lane-wise FMAs, with no shuffles
+__attribute__(( target( "avx2,fma" ) ))
+void fftButterfliesAVX2( float* top_real, float* top_imag, float* bottom_real, float* bottom_imag, const float* twiddle_real, const float* twiddle_imag, unsigned int count ) {
+	unsigned int k = 0;
+
+	for( ; k + 8 <= count; k += 8 ) {
+		const __m256 twiddle_r = _mm256_loadu_ps( twiddle_real + k );
+		const __m256 twiddle_i = _mm256_loadu_ps( twiddle_imag + k );
+		const __m256 bottom_r = _mm256_loadu_ps( bottom_real + k );
+		const __m256 bottom_i = _mm256_loadu_ps( bottom_imag + k );
+		const __m256 top_r = _mm256_loadu_ps( top_real + k );
+		const __m256 top_i = _mm256_loadu_ps( top_imag + k );
+
+		const __m256 product_r = _mm256_fmsub_ps( bottom_r, twiddle_r, _mm256_mul_ps( bottom_i, twiddle_i ) );
+		const __m256 product_i = _mm256_fmadd_ps( bottom_r, twiddle_i, _mm256_mul_ps( bottom_i, twiddle_r ) );
+
+		_mm256_storeu_ps( top_real + k, _mm256_add_ps( top_r, product_r ) );
+		_mm256_storeu_ps( top_imag + k, _mm256_add_ps( top_i, product_i ) );
+		_mm256_storeu_ps( bottom_real + k, _mm256_sub_ps( top_r, product_r ) );
+		_mm256_storeu_ps( bottom_imag + k, _mm256_sub_ps( top_i, product_i ) );
+	}
+
+	fftButterfliesScalar( top_real + k, top_imag + k, bottom_real + k, bottom_imag + k, twiddle_real + k, twiddle_imag + k, count - k );
+}
+#endif
+
+typedef void ( *FFTButterflyKernel )( float*, float*, float*, float*, const float*, const float*, unsigned int );
+
+FFTButterflyKernel selectFFTButterflyKernel() {
+	static const FFTButterflyKernel kernel = []() -> FFTButterflyKernel {
+#if NN_X86
+		if( CPUFeatures::get().hasAVX2() ) {
+			return fftButterfliesAVX2;
+		}
+#endif
+		return fftButterfliesScalar;
+	}();
+
+	return kernel;
+}
+
+/**
+ * The precomputed tables for an iterative transform of one power of two length.
+ */
+struct FFTPlan {
+	unsigned int size;
+
+	// Index i of the input is read from bit_reversed[ i ]
+	std::vector< unsigned int > bit_reversed;
+
+	// The stage of length 2h uses twiddles h up to 2h - 1, which are exp( -2 pi i k / 2h ) for k from 0 to h - 1
+	ComplexBuffer twiddles;
+};
+
+/**
+ * Get the tables for transforming a power of two length. The plan of the most recent length is kept per thread, since the short-time transforms repeat one length.
+ * @param size The length of the transform.
+ * @return The plan for the length.
+ */
+const FFTPlan& getFFTPlan( unsigned int size ) {
+	static thread_local FFTPlan plan = { 0, std::vector< unsigned int >(), ComplexBuffer() };
+
+	if( plan.size == size ) {
+		return plan;
+	}
+
+	plan.size = size;
+	plan.bit_reversed.resize( size );
+	plan.twiddles.resize( size );
+
+	unsigned int bits = 0;
+	while( ( 1u << bits ) < size ) {
+		++bits;
+	}
+
+	for( unsigned int i = 0; i < size; ++i ) {
+		unsigned int reversed = 0;
+		for( unsigned int bit = 0; bit < bits; ++bit ) {
+			reversed |= ( ( i >> bit ) & 1u ) << ( bits - 1 - bit );
+		}
+		plan.bit_reversed[ i ] = reversed;
+	}
+
+	// Computed in double so later stages do not inherit rounding from a recurrence
+	for( unsigned int half = 1; half < size; half *= 2 ) {
+		for( unsigned int k = 0; k < half; ++k ) {
+			const double angle = -std::acos( -1.0 ) * k / half;
+			plan.twiddles.real()[ half + k ] = static_cast< float >( std::cos( angle ) );
+			plan.twiddles.imag()[ half + k ] = static_cast< float >( std::sin( angle ) );
+		}
+	}
+
+	return plan;
+}
+
+/**
+ * Transform a power of two length in place with iterative radix-2 stages.
+ * @param real The real parts of the values.
+ * @param imag The imaginary parts of the values.
+ * @param size The number of values, a power of two.
+ */
+void fftPowerOfTwo( float* real, float* imag, unsigned int size ) {
+	const FFTPlan& plan = getFFTPlan( size );
+
+	for( unsigned int i = 0; i < size; ++i ) {
+		const unsigned int j = plan.bit_reversed[ i ];
+		if( i < j ) {
+			std::swap( real[ i ], real[ j ] );
+			std::swap( imag[ i ], imag[ j ] );
+		}
+	}
+
+	FFTButterflyKernel kernel = selectFFTButterflyKernel();
+
+	for( unsigned int half = 1; half < size; half *= 2 ) {
+		const float* twiddle_real = plan.twiddles.real() + half;
+		const float* twiddle_imag = plan.twiddles.imag() + half;
+
+		for( unsigned int start = 0; start < size; start += 2 * half ) {
+			kernel( real + start, imag + start, real + start + half, imag + start + half, twiddle_real, twiddle_imag, half );
+		}
+	}
+}
+
 /**
  * Calculate the Fast Fourier Transform. Works fastest on inputs of length 2^N.
  * @param input The time-series input to the FFT.
  * @return The frequency-series output from the FFT.
  */
-std::vector< std::complex< float > > fft( std::vector< std::complex< float > > input ) {
-	std::vector< std::complex< float > > output( input.size(), std::complex< float >( 0.f, 0.f ) );
+ComplexBuffer fft( const ComplexBuffer& input ) {
+	const unsigned int size = input.size();
 
-	if( input.size() <= 1 ) {
-		output = input;
-	} else if( input.size() % 2 == 0 ) {
-		unsigned int partial_size = input.size() / 2;
-		std::vector< std::complex< float > > left( partial_size );
-		std::vector< std::complex< float > > right( partial_size );
+	if( size <= 1 || ( size & ( size - 1 ) ) == 0 ) {
+		ComplexBuffer output = input;
+		if( size > 1 ) {
+			fftPowerOfTwo( output.real(), output.imag(), size );
+		}
+		return output;
+	}
+
+	ComplexBuffer output( size );
+	const float partial_frequency = -2.f * pi / static_cast< float >( size );
+
+	if( size % 2 == 0 ) {
+		const unsigned int partial_size = size / 2;
+		ComplexBuffer left( partial_size );
+		ComplexBuffer right( partial_size );
 
 		for( unsigned int i = 0; i < partial_size; ++i ) {
-			left[ i ] = input[ 2 * i ];
-			right[ i ] = input[ 2 * i + 1 ];
+			left.real()[ i ] = input.real()[ 2 * i ];
+			left.imag()[ i ] = input.imag()[ 2 * i ];
+			right.real()[ i ] = input.real()[ 2 * i + 1 ];
+			right.imag()[ i ] = input.imag()[ 2 * i + 1 ];
 		}
 
 		left = fft( left );
 		right = fft( right );
 
-		float partial_frequency = -2.f * pi / static_cast< float >( input.size() );
-
 		for( unsigned int i = 0; i < partial_size; ++i ) {
 			std::complex< float > twiddle = std::exp( std::complex< float >( 0.f, partial_frequency * i ) );
-			output[ i ] = left[ i ] + twiddle * right[ i ];
-			output[ i + partial_size ] = left[ i ] - twiddle * right[ i ];
+			std::complex< float > product = twiddle * right.get( i );
+			output.set( i, left.get( i ) + product );
+			output.set( i + partial_size, left.get( i ) - product );
 		}
 	} else {
-		float partial_frequency = -2.f * pi / static_cast< float >( input.size() );
+		for( unsigned int i = 0; i < size; ++i ) {
+			std::complex< float > sum( 0.f, 0.f );
 
-		for( unsigned int i = 0; i < input.size(); ++i ) {
-			for( unsigned int j = 0; j < input.size(); ++j ) {
+			for( unsigned int j = 0; j < size; ++j ) {
 				std::complex< float > twiddle = std::exp( std::complex< float >( 0.f, partial_frequency * i * j ) );
-				output[ i ] += twiddle * input[ j ];
+				sum += twiddle * input.get( j );
 			}
+
+			output.set( i, sum );
 		}
 	}
 
@@ -55,72 +225,102 @@ std::vector< std::complex< float > > fft( std::vector< std::complex< float > > i
  * @param input The frequency-series input to the IFFT.
  * @return The time-series output from the IFFT.
  */
-std::vector< std::complex< float > > ifft( std::vector< std::complex< float > > input ) {
-	for( unsigned int i = 0; i < input.size(); ++i ) {
-		input[ i ] = std::conj( input[ i ] );
+ComplexBuffer ifft( ComplexBuffer input ) {
+	const unsigned int size = input.size();
+
+	// Conjugating before and after turns the forward transform into the inverse
+	for( unsigned int i = 0; i < size; ++i ) {
+		input.imag()[ i ] = -input.imag()[ i ];
 	}
 
 	input = fft( input );
 
-	for( unsigned int i = 0; i < input.size(); ++i ) {
-		input[ i ] = std::conj( input[ i ] ) / std::complex< float >( input.size(), 0.f );
+	const float scale = 1.f / static_cast< float >( size );
+	for( unsigned int i = 0; i < size; ++i ) {
+		input.real()[ i ] *= scale;
+		input.imag()[ i ] *= -scale;
 	}
 
 	return input;
 }
 
 /**
- * Calculate the short-time Fourier Transform of a time sequence.
- * @param data The time sequence to be transformed. Algorithm works best if its length is a multiple of the step size.
- * @param step_size The number of samples to use in each slice. Recommended to be a power of two greater than (sample rate / 40).
- * @return The set of frequency space time sliced data. Each covers a time step equal to the step size.
+ * Calculate the Fast Fourier Transform of interleaved complex values.
+ * @param input The time-series input to the FFT.
+ * @return The frequency-series output from the FFT.
+ */
+std::vector< std::complex< float > > fft( const std::vector< std::complex< float > >& input ) {
+	return fft( ComplexBuffer::fromComplex( input ) ).toComplex();
+}
+
+/**
+ * Calculate the inverse Fast Fourier Transform of interleaved complex values.
+ * @param input The frequency-series input to the IFFT.
+ * @return The time-series output from the IFFT.
  */
-std::vector< std::vector< std::complex< float > > > stft( std::vector< std::complex< float > > data, unsigned int step_size = 2048 ) {
-	std::vector< std::vector< std::complex< float > > > output_chunks;
+std::vector< std::complex< float > > ifft( const std::vector< std::complex< float > >& input ) {
+	return ifft( ComplexBuffer::fromComplex( input ) ).toComplex();
+}
 
-	unsigned int data_size = data.size();
-	if( data_size % step_size != 0 ) {
-		data_size += step_size - ( data_size % step_size );
+/**
+ * Calculate the short-time Fourier Transform of a multichannel time sequence.
+ * @param channels The time sequence of each channel. Algorithm works best if their length is a multiple of the step size.
+ * @param step_size The number of samples to use in each slice. Recommended to be a power of two greater than (sample rate / 40).
+ * @param layout The order the spectrogram keeps its values in.
+ * @return The frequency space time sliced data, with 2 * step_size bins per slice. Each slice covers a time step equal to the step size.
+ */
+Spectrogram stft( const std::vector< ComplexBuffer >& channels, unsigned int step_size = 2048, SpectrogramLayout layout = SpectrogramLayout::ChunkMajor ) {
+	unsigned int length = 0;
+	for( unsigned int c = 0; c < channels.size(); ++c ) {
+		length = std::max( length, channels[ c ].size() );
 	}
-	data.resize( data_size );
 
-	for( unsigned int read_pos = 0; read_pos + step_size <= data.size(); read_pos += step_size ) {
-		std::vector< std::complex< float > > data_input( 2 * step_size, std::complex< float >( 0.f, 0.f ) );
-		for( unsigned int i = 0; i < step_size; ++i ) {
-			data_input[ i ] = data[ read_pos + i ];
-		}
+	const unsigned int chunk_count = ( length + step_size - 1 ) / step_size;
+	Spectrogram output( static_cast< unsigned int >( channels.size() ), chunk_count, 2 * step_size, layout );
+
+	ComplexBuffer data_input( 2 * step_size );
 
-		std::vector< std::complex< float > > data_output = fft( data_input );
-		output_chunks.push_back( data_output );
+	for( unsigned int c = 0; c < channels.size(); ++c ) {
+		const ComplexBuffer& data = channels[ c ];
+
+		for( unsigned int chunk = 0; chunk < chunk_count; ++chunk ) {
+			// The slice is zero padded to twice its length, and the last partial slice out to the step size
+			const unsigned int read_pos = chunk * step_size;
+			const unsigned int count = read_pos >= data.size() ? 0 : std::min( step_size, data.size() - read_pos );
+
+			std::fill( data_input.real(), data_input.real() + data_input.size(), 0.f );
+			std::fill( data_input.imag(), data_input.imag() + data_input.size(), 0.f );
+			std::copy( data.real() + read_pos, data.real() + read_pos + count, data_input.real() );
+			std::copy( data.imag() + read_pos, data.imag() + read_pos + count, data_input.imag() );
+
+			output.setBins( c, chunk, fft( data_input ) );
+		}
 	}
 
-	return output_chunks;
+	return output;
 }
 
 /**
  * Inverts the short-time Fourier Transform to turn a frequency sequence into time sequence.
- * @param chunks The chunks of frequency data to be turned into time sequence data. Individual chunks must have a length multiple of two.
- * @return The time sequence corresponding to the frequency data.
+ * @param spectrogram The frequency data to be turned into time sequence data. Must have an even number of bins.
+ * @param channel The channel to invert.
+ * @return The time sequence of the channel corresponding to the frequency data.
  */
-std::vector< std::complex< float > > istft( std::vector< std::vector< std::complex< float > > > chunks ) {
-	unsigned int length = 0;
-	for( unsigned int i = 0; i < chunks.size(); ++i ) {
-		length += chunks[ i ].size();
-	}
-	length /= 2;
-
-	std::vector< std::complex< float > > output_series( length, std::complex< float >( 0.f, 0.f ) );
+ComplexBuffer istft( const Spectrogram& spectrogram, unsigned int channel ) {
+	const unsigned int step_size = spectrogram.getBinCount() / 2;
+	const unsigned int length = spectrogram.getChunkCount() * step_size;
 
-	unsigned int write_pos = 0;
+	ComplexBuffer output_series( length );
+	ComplexBuffer chunk_frequency( spectrogram.getBinCount() );
 
-	for( unsigned int chunk_num = 0; chunk_num < chunks.size(); ++chunk_num ) {
-		std::vector< std::complex< float > > chunk_time = ifft( chunks[ chunk_num ] );
-
-		for( unsigned int i = 0; i < chunk_time.size() && write_pos + i < length; ++i ) {
-			output_series[ write_pos + i ] = chunk_time[ i ];
-		}
+	for( unsigned int chunk = 0; chunk < spectrogram.getChunkCount(); ++chunk ) {
+		spectrogram.getBins( channel, chunk, chunk_frequency );
+		ComplexBuffer chunk_time = ifft( chunk_frequency );
 
-		write_pos += chunks[ chunk_num ].size() / 2;
+		const unsigned int write_pos = chunk * step_size;
+		const unsigned int count = std::min( chunk_time.size(), length - write_pos );
+		std::copy( chunk_time.real(), chunk_time.real() + count, output_series.real() + write_pos );
+		std::copy( chunk_time.imag(), chunk_time.imag() + count, output_series.imag() + write_pos );
 	}
 
 	return output_series;
@@ -1,10 +1,16 @@
 #ifndef FEEDFORWARDLAYER_HPP
 #define FEEDFORWARDLAYER_HPP
 
+#include <algorithm>
 #include <cmath>
 #include <random>
+#include "GEMMKernels.hpp"
+#include "HalfKernels.hpp"
 #include "Matrix.hpp"
+#include "MatrixKernels.hpp"
 #include "NetworkLayer.hpp"
+#include "SparseKernels.hpp"
+#include "SparseMatrix.hpp"
 #include "Vector.hpp"
 
 class FeedForwardLayer : public NetworkLayer {
@@ -12,9 +18,36 @@ class FeedForwardLayer : public NetworkLayer {
 		Matrix m_weights;
 		Vector m_bias;
 
-		float activation( float input ) {
-			//return 1.f / ( 1.f + std::exp( -input ) );
-			return std::tanh( input );
+		// Once pruned the weights live only in m_sparse_weights and m_weights is emptied
+		SparseMatrix m_sparse_weights;
+		bool m_sparse;
+
+		// Filled by computeGradients in the layout of the weights in use, and sized on first use
+		Matrix m_weight_gradients;
+		AlignedBuffer< float > m_sparse_weight_gradients;
+		Vector m_bias_gradients;
+
+		/**
+		 * Size the gradient buffers to the weights in use, zeroing them if they did not fit.
+		 */
+		void allocateGradients() {
+			if( m_bias_gradients.getDimension() != getOutputCount() ) {
+				m_bias_gradients.setDimension( getOutputCount() );
+				for( unsigned int y = 0; y < getOutputCount(); ++y ) {
+					m_bias_gradients( y ) = 0.f;
+				}
+			}
+
+			if( m_sparse ) {
+				const std::size_t value_count = static_cast< std::size_t >( m_sparse_weights.getBlockCount() ) * SparseMatrix::block_width;
+				if( m_sparse_weight_gradients.size() != value_count ) {
+					m_sparse_weight_gradients.resize( value_count );
+					m_sparse_weight_gradients.clear();
+				}
+			} else if( m_weight_gradients.getHeight() != getOutputCount() || m_weight_gradients.getWidth() != getInputCount() ) {
+				m_weight_gradients.setSize( getOutputCount(), getInputCount() );
+				std::fill( m_weight_gradients.data(), m_weight_gradients.data() + static_cast< std::size_t >( m_weight_gradients.getStride() ) * getOutputCount(), 0.f );
+			}
 		}
 
 		float activationOutputDerivative( float output ) {
@@ -22,12 +55,10 @@ class FeedForwardLayer : public NetworkLayer {
 			return ( 1.f - output * output );
 		}
 
-		float activationDerivative( float input ) {
-			return activationOutputDerivative( activation( input ) );
-		}
-
 	protected:
 		virtual void setSizeInternal( const unsigned int inputs, const unsigned int outputs ) {
+			m_sparse = false;
+			m_sparse_weights = SparseMatrix();
 			m_weights.setSize( outputs, inputs );
 			m_bias.setDimension( outputs );
 
@@ -44,71 +75,359 @@ class FeedForwardLayer : public NetworkLayer {
 			for( unsigned int y = 0; y < outputs; ++y ) {
 				m_bias( y ) = distribution( generator );
 			}
+
+			m_weights.updateReducedCopy();
+		}
+
+		virtual void setSizeForLoadInternal( const unsigned int inputs, const unsigned int outputs, Json::Value& data_value ) {
+			if( !data_value.get( "sparse", false ).asBool() ) {
+				setSizeInternal( inputs, outputs );
+				return;
+			}
+
+			// loadSparseFromJSON() allocates just the stored blocks, so the dense matrix is never built
+			m_sparse_weights = SparseMatrix();
+			m_weights.setSize( 0, 0 );
+			m_bias.setDimension( outputs );
 		}
 
 		virtual void loadFromJSONInternal( Json::Value& data_value ) {
 			Json::Value weights = data_value[ "weights" ];
 			Json::Value bias = data_value[ "bias" ];
 
+			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
+				m_bias( y ) = bias[ y ].asFloat();
+			}
+
+			if( data_value.get( "sparse", false ).asBool() ) {
+				loadSparseFromJSON( data_value );
+				return;
+			}
+
 			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
 				for( unsigned int x = 0; x < getInputCount(); ++x ) {
 					m_weights( y, x ) = weights[ y * getInputCount() + x ].asFloat();
 				}
+			}
+		}
 
-				m_bias( y ) = bias[ y ].asFloat();
+		/**
+		 * Load weights saved in block sparse form into a layer sized by setSizeForLoadInternal(), allocating only the stored blocks.
+		 * @param data_value The layer's data object.
+		 */
+		void loadSparseFromJSON( Json::Value& data_value ) {
+			Json::Value weights = data_value[ "weights" ];
+			Json::Value row_offsets_value = data_value[ "row-offsets" ];
+			Json::Value block_columns_value = data_value[ "block-columns" ];
+
+			if( data_value.get( "block-width", SparseMatrix::block_width ).asUInt() != SparseMatrix::block_width ) {
+				throw std::string( "Unsupported sparse block width" );
+			}
+
+			std::vector< unsigned int > row_offsets( row_offsets_value.size() );
+			for( unsigned int i = 0; i < row_offsets.size(); ++i ) {
+				row_offsets[ i ] = row_offsets_value[ i ].asUInt();
+			}
+
+			std::vector< unsigned int > block_columns( block_columns_value.size() );
+			for( unsigned int i = 0; i < block_columns.size(); ++i ) {
+				block_columns[ i ] = block_columns_value[ i ].asUInt();
+			}
+
+			m_sparse_weights.setStructure( getOutputCount(), getInputCount(), row_offsets, block_columns );
+
+			float* values = m_sparse_weights.data();
+			const unsigned int value_count = m_sparse_weights.getBlockCount() * SparseMatrix::block_width;
+			if( weights.size() != value_count ) {
+				throw std::string( "Invalid sparse weight count" );
+			}
+
+			for( unsigned int i = 0; i < value_count; ++i ) {
+				values[ i ] = weights[ i ].asFloat();
 			}
+
+			m_sparse = true;
 		}
 
 		virtual Json::Value saveToJSONInternal() {
 			Json::Value data_object( Json::objectValue );
 
-			Json::Value weights( Json::arrayValue );
-			weights.resize( getInputCount() * getOutputCount() );
-
 			Json::Value bias( Json::arrayValue );
 			bias.resize( getOutputCount() );
 
+			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
+				bias[ y ] = m_bias( y );
+			}
+
+			data_object[ "bias" ] = bias;
+
+			if( m_sparse ) {
+				saveSparseToJSON( data_object );
+				return data_object;
+			}
+
+			Json::Value weights( Json::arrayValue );
+			weights.resize( getInputCount() * getOutputCount() );
+
 			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
 				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					weights[ y * getInputCount() + x ] = m_weights( y, x );
+					weights[ y * getInputCount() + x ] = m_weights.getStoredValue( y, x );
 				}
-
-				bias[ y ] = m_bias( y );
 			}
 
 			data_object[ "weights" ] = weights;
-			data_object[ "bias" ] = bias;
 
 			return data_object;
 		}
 
+		/**
+		 * Save the weights in block sparse form: the block offsets of each row, the first column of each block and the values of each block.
+		 * @param data_object The layer's data object to add the weights to.
+		 */
+		void saveSparseToJSON( Json::Value& data_object ) {
+			const std::vector< unsigned int >& row_offsets = m_sparse_weights.getRowOffsets();
+			const std::vector< unsigned int >& block_columns = m_sparse_weights.getBlockColumns();
+
+			Json::Value row_offsets_value( Json::arrayValue );
+			row_offsets_value.resize( static_cast< unsigned int >( row_offsets.size() ) );
+			for( unsigned int i = 0; i < row_offsets.size(); ++i ) {
+				row_offsets_value[ i ] = row_offsets[ i ];
+			}
+
+			Json::Value block_columns_value( Json::arrayValue );
+			block_columns_value.resize( static_cast< unsigned int >( block_columns.size() ) );
+			for( unsigned int i = 0; i < block_columns.size(); ++i ) {
+				block_columns_value[ i ] = block_columns[ i ];
+			}
+
+			const float* values = m_sparse_weights.data();
+			const unsigned int value_count = m_sparse_weights.getBlockCount() * SparseMatrix::block_width;
+
+			Json::Value weights( Json::arrayValue );
+			weights.resize( value_count );
+			for( unsigned int i = 0; i < value_count; ++i ) {
+				weights[ i ] = values[ i ];
+			}
+
+			data_object[ "sparse" ] = true;
+			data_object[ "block-width" ] = SparseMatrix::block_width;
+			data_object[ "row-offsets" ] = row_offsets_value;
+			data_object[ "block-columns" ] = block_columns_value;
+			data_object[ "weights" ] = weights;
+		}
+
 		virtual std::string getJSONTypeName() const {
 			return std::string( "feed-forward" );
 		}
 
-	public:
-		virtual Vector propagate( Vector input ) {
-			if( input.getDimension() != getInputCount() ) {
-				throw std::string( "Invalid input size to layer propagation" );
+		virtual void computeGradientsInternal( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta ) {
+			allocateGradients();
+
+			Vector input_storage;
+			input = makeContiguous( input, input_storage );
+
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
+
+			VectorView scaled_delta = arena.allocateVector( getOutputCount() );
+			scaled_delta.assign( delta * apply( output, [ this ]( float value ) { return activationOutputDerivative( value ); } ) );
+
+			if( m_sparse ) {
+				if( new_delta.data() ) {
+					gemvTransposed( m_sparse_weights, scaled_delta, new_delta );
+				}
+
+				accumulateGradient( m_sparse_weights, scaled_delta, input, m_sparse_weight_gradients.data() );
+			} else {
+				if( new_delta.data() ) {
+					gemvTransposed( m_weights, scaled_delta, new_delta );
+				}
+
+				// A step of rate -1 adds delta * transpose( input ) to the gradients
+				rankOneUpdate( m_weight_gradients, scaled_delta, input, -1.f );
 			}
 
-			Vector output;
-			output.setDimension( getOutputCount() );
+			float* bias_gradients = m_bias_gradients.data();
+			const float* delta_values = scaled_delta.data();
 
 			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				float accum = m_bias( y );
+				bias_gradients[ y ] += delta_values[ y ];
+			}
+		}
 
-				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					accum += m_weights( y, x ) * input( x );
+		/**
+		 * Add the gradients of a batch with matrix-matrix products, reading the weights once for the errors of the whole batch. Small batches and pruned layers add them one sample at a time.
+		 */
+		virtual void computeGradientsBatchInternal( ConstMatrixView inputs, ConstMatrixView outputs, ConstMatrixView deltas, MatrixView new_deltas ) {
+			const unsigned int batch_size = inputs.getHeight();
+
+			if( m_sparse || batch_size < minimum_gemm_train_batch ) {
+				NetworkLayer::computeGradientsBatchInternal( inputs, outputs, deltas, new_deltas );
+				return;
+			}
+
+			allocateGradients();
+
+			const unsigned int inputs_count = getInputCount();
+			const unsigned int outputs_count = getOutputCount();
+			const std::size_t work = static_cast< std::size_t >( outputs_count ) * inputs_count;
+
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
+
+			MatrixView scaled_deltas = arena.allocateMatrix( batch_size, outputs_count );
+			float* bias_gradients = m_bias_gradients.data();
+
+			for( unsigned int b = 0; b < batch_size; ++b ) {
+				const float* output = outputs.row( b );
+				const float* delta = deltas.row( b );
+				float* scaled = scaled_deltas.row( b );
+
+				for( unsigned int y = 0; y < outputs_count; ++y ) {
+					scaled[ y ] = delta[ y ] * activationOutputDerivative( output[ y ] );
+					bias_gradients[ y ] += scaled[ y ];
 				}
+			}
+
+			ConstMatrixView weights = m_weights;
+			MatrixView weight_gradients = m_weight_gradients;
+
+			if( new_deltas.data() ) {
+				parallelForRows( inputs_count, work, [ & ]( unsigned int first, unsigned int count ) {
+					gemm( scaled_deltas, false, weights.block( 0, first, outputs_count, count ), false, new_deltas.block( 0, first, batch_size, count ) );
+				} );
+			}
+
+			// Adds the sum over the batch of delta * transpose( input ) to the gradients
+			parallelForRows( outputs_count, work, [ & ]( unsigned int first, unsigned int count ) {
+				gemm( scaled_deltas.block( 0, first, batch_size, count ), true, inputs, false, weight_gradients.block( first, 0, count, inputs_count ), true );
+			} );
+		}
+
+		virtual void applyGradientsInternal( Optimizer& optimizer, float scale ) {
+			allocateGradients();
+
+			const std::size_t offset = getParameterOffset();
+
+			if( m_sparse ) {
+				optimizer.update( offset, m_sparse_weights.data(), m_sparse_weight_gradients.data(), m_sparse_weight_gradients.size(), scale );
+				m_sparse_weight_gradients.clear();
+			} else {
+				const std::size_t weight_count = static_cast< std::size_t >( m_weights.getStride() ) * getOutputCount();
+				optimizer.update( offset, m_weights.data(), m_weight_gradients.data(), weight_count, scale );
+				std::fill( m_weight_gradients.data(), m_weight_gradients.data() + weight_count, 0.f );
+				m_weights.updateReducedCopy();
+			}
+
+			optimizer.update( offset + getWeightParameterCount(), m_bias.data(), m_bias_gradients.data(), getOutputCount(), scale );
+			std::fill( m_bias_gradients.data(), m_bias_gradients.data() + getOutputCount(), 0.f );
+		}
+
+		/**
+		 * Get the space the weights in use take up in the layer's parameters.
+		 * @return The weight count, aligned to 64 bytes.
+		 */
+		std::size_t getWeightParameterCount() const {
+			if( m_sparse ) {
+				return alignParameterCount( static_cast< std::size_t >( m_sparse_weights.getBlockCount() ) * SparseMatrix::block_width );
+			}
+
+			return static_cast< std::size_t >( m_weights.getStride() ) * getOutputCount();
+		}
+
+	public:
+		// Smaller batches run a sample at a time, as packing the weights for a matrix-matrix product costs more than the reuse it buys them. Training reuses the packed weights twice, so it pays off sooner
+		static const unsigned int minimum_gemm_propagate_batch = 16;
+		static const unsigned int minimum_gemm_train_batch = 8;
+
+		FeedForwardLayer() : m_sparse( false ) {
+		}
+
+		/**
+		 * Get the precision the layer's weights are read in during propagation.
+		 * @return The weight precision. Pruned layers always read single precision.
+		 */
+		virtual WeightPrecision getWeightPrecision() const {
+			return m_sparse ? WeightPrecision::Float32 : m_weights.getPrecision();
+		}
+
+		virtual void setWeightPrecision( WeightPrecision precision ) {
+			m_weights.setPrecision( precision );
+		}
+
+		virtual float prune( float threshold ) {
+			if( m_sparse ) {
+				// Prune again from the current weights, so blocks that have since shrunk are dropped too
+				m_weights.setSize( getOutputCount(), getInputCount() );
+				m_sparse_weights.toDense( m_weights.data(), m_weights.getStride() );
+			}
+
+			m_sparse_weights.fromDense( m_weights.data(), m_weights.getStride(), getOutputCount(), getInputCount(), threshold );
+			m_sparse = true;
+			m_weights.setSize( 0, 0 );
+
+			// Gradients waiting to be applied were laid out for the old weights
+			m_weight_gradients.setSize( 0, 0 );
+			m_sparse_weight_gradients = AlignedBuffer< float >();
+
+			return m_sparse_weights.getDensity();
+		}
+
+		bool isSparse() const {
+			return m_sparse;
+		}
+
+		virtual std::size_t getParameterCount() const {
+			return getWeightParameterCount() + alignParameterCount( getOutputCount() );
+		}
+
+		virtual void bindParameters( float* parameters, float* gradients ) {
+			const std::size_t weight_count = getWeightParameterCount();
+
+			if( gradients ) {
+				allocateGradients();
+			}
+
+			if( m_sparse ) {
+				m_sparse_weights.bindValues( parameters );
+				m_sparse_weight_gradients.bind( gradients );
+			} else {
+				m_weights.bindValues( parameters );
+				m_weight_gradients.bindValues( gradients );
+			}
+
+			m_bias.bindValues( parameters ? parameters + weight_count : nullptr );
+			m_bias_gradients.bindValues( gradients ? gradients + weight_count : nullptr );
+		}
+
+		virtual void updateReducedCopies() {
+			if( !m_sparse ) {
+				m_weights.updateReducedCopy();
+			}
+		}
+
+		using NetworkLayer::propagate;
+		using NetworkLayer::train;
+		using NetworkLayer::propagateBatch;
+		using NetworkLayer::trainBatch;
+
+		virtual void propagate( ConstVectorView input, VectorView output ) {
+			if( input.getDimension() != getInputCount() ) {
+				throw std::string( "Invalid input size to layer propagation" );
+			}
 
-				output( y ) = activation( accum );
+			if( output.getDimension() != getOutputCount() ) {
+				throw std::string( "Invalid output size to layer propagation" );
 			}
 
-			return output;
+			if( m_sparse ) {
+				gemv( m_sparse_weights, input, m_bias, output, ActivationFunction::Tanh, getActivationAccuracy() );
+			} else {
+				gemv( m_weights, input, m_bias, output, ActivationFunction::Tanh, getActivationAccuracy() );
+			}
 		}
 
-		virtual Vector train( Vector input, Vector output, Vector delta, float mutability = 0.05f ) {
+		virtual void train( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta, float mutability = 0.05f ) {
 			if( input.getDimension() != getInputCount() ) {
 				throw std::string( "Invalid input size to layer training" );
 			}
@@ -121,32 +440,144 @@ class FeedForwardLayer : public NetworkLayer {
 				throw std::string( "Invalid output size to layer training" );
 			}
 
+			if( new_delta.data() && new_delta.getDimension() != getInputCount() ) {
+				throw std::string( "Invalid new delta size to layer training" );
+			}
+
+			Vector input_storage;
+			input = makeContiguous( input, input_storage );
+
+			if( !m_sparse ) {
+				for( unsigned int x = 0; x < new_delta.getDimension(); ++x ) {
+					new_delta( x ) = 0.f;
+				}
+
+				// The activation derivative, weight and bias steps all happen in the kernel's pass over the rows
+				backwardUpdate( m_weights, delta, output, ActivationFunction::Tanh, input, mutability, m_bias, new_delta );
+				m_weights.updateReducedCopy();
+				return;
+			}
+
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
+
+			VectorView scaled_delta = arena.allocateVector( getOutputCount() );
+			scaled_delta.assign( delta * apply( output, [ this ]( float value ) { return activationOutputDerivative( value ); } ) );
+
+			if( new_delta.data() ) {
+				gemvTransposed( m_sparse_weights, scaled_delta, new_delta );
+			}
+
+			rankOneUpdate( m_sparse_weights, scaled_delta, input, mutability );
+
+			float* bias = m_bias.data();
+			const float* delta_values = scaled_delta.data();
+
 			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				delta( y ) *= activationOutputDerivative( output( y ) );
+				bias[ y ] -= mutability * delta_values[ y ];
 			}
+		}
 
-			Vector new_delta;
-			new_delta.setDimension( getInputCount() );
+		/**
+		 * Propagate a batch of samples as one matrix-matrix product, so each weight is read once per batch rather than once per sample. The product reads the single precision weights whatever the weight precision. Small batches and pruned layers take the matrix-vector path.
+		 */
+		virtual void propagateBatch( ConstMatrixView inputs, MatrixView outputs ) {
+			const unsigned int batch_size = inputs.getHeight();
 
-			for( unsigned int x = 0; x < getInputCount(); ++x ) {
-				float accum = 0.f;
+			if( m_sparse || batch_size < minimum_gemm_propagate_batch ) {
+				NetworkLayer::propagateBatch( inputs, outputs );
+				return;
+			}
 
-				for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-					accum += delta( y ) * m_weights( y, x );
+			if( inputs.getWidth() != getInputCount() || outputs.getWidth() != getOutputCount() || outputs.getHeight() != batch_size ) {
+				throw std::string( "Invalid batch size to layer propagation" );
+			}
+
+			const unsigned int inputs_count = getInputCount();
+			ConstMatrixView weights = m_weights;
+
+			// Each thread produces the outputs of its own block of weight rows for the whole batch
+			parallelForRows( getOutputCount(), static_cast< std::size_t >( getOutputCount() ) * inputs_count, [ & ]( unsigned int first, unsigned int count ) {
+				MatrixView block = outputs.block( 0, first, batch_size, count );
+				gemm( inputs, false, weights.block( first, 0, count, inputs_count ), true, block );
+
+				const float* bias = m_bias.data() + first;
+				for( unsigned int b = 0; b < batch_size; ++b ) {
+					float* row = block.row( b );
+					for( unsigned int y = 0; y < count; ++y ) {
+						row[ y ] += bias[ y ];
+					}
+
+					VectorView row_view( row, count );
+					applyActivation( ActivationFunction::Tanh, getActivationAccuracy(), row_view, row_view );
 				}
+			} );
+		}
+
+		/**
+		 * Train on a batch of samples with matrix-matrix products, updating the weights once from the error averaged over the batch. Small batches and pruned layers accumulate their gradients one sample at a time.
+		 */
+		virtual void trainBatch( ConstMatrixView inputs, ConstMatrixView outputs, ConstMatrixView deltas, MatrixView new_deltas, float mutability = 0.05f ) {
+			const unsigned int batch_size = inputs.getHeight();
 
-				new_delta( x ) = accum;
+			if( m_sparse || batch_size < minimum_gemm_train_batch ) {
+				NetworkLayer::trainBatch( inputs, outputs, deltas, new_deltas, mutability );
+				return;
 			}
 
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					m_weights( y, x ) -= mutability * delta( y ) * input( x );
+			if( inputs.getWidth() != getInputCount() || outputs.getWidth() != getOutputCount() || deltas.getWidth() != getOutputCount() || outputs.getHeight() != batch_size || deltas.getHeight() != batch_size ) {
+				throw std::string( "Invalid batch size to layer training" );
+			}
+
+			if( new_deltas.data() && ( new_deltas.getWidth() != getInputCount() || new_deltas.getHeight() != batch_size ) ) {
+				throw std::string( "Invalid new delta batch size to layer training" );
+			}
+
+			const unsigned int inputs_count = getInputCount();
+			const unsigned int outputs_count = getOutputCount();
+			const std::size_t work = static_cast< std::size_t >( outputs_count ) * inputs_count;
+
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
+
+			MatrixView scaled_deltas = arena.allocateMatrix( batch_size, outputs_count );
+			for( unsigned int b = 0; b < batch_size; ++b ) {
+				const float* output = outputs.row( b );
+				const float* delta = deltas.row( b );
+				float* scaled = scaled_deltas.row( b );
+
+				for( unsigned int y = 0; y < outputs_count; ++y ) {
+					scaled[ y ] = delta[ y ] * activationOutputDerivative( output[ y ] );
 				}
+			}
+
+			MatrixView weights = m_weights;
 
-				m_bias( y ) -= mutability * delta( y );
+			// The errors for the previous layer need the weights from before the update
+			if( new_deltas.data() ) {
+				parallelForRows( inputs_count, work, [ & ]( unsigned int first, unsigned int count ) {
+					gemm( scaled_deltas, false, weights.block( 0, first, outputs_count, count ), false, new_deltas.block( 0, first, batch_size, count ) );
+				} );
 			}
 
-			return new_delta;
+			// Fold the averaged step size into the deltas, so the update is a single accumulating product
+			const float rate = -mutability / batch_size;
+			float* bias = m_bias.data();
+
+			for( unsigned int b = 0; b < batch_size; ++b ) {
+				float* scaled = scaled_deltas.row( b );
+
+				for( unsigned int y = 0; y < outputs_count; ++y ) {
+					scaled[ y ] *= rate;
+					bias[ y ] += scaled[ y ];
+				}
+			}
+
+			parallelForRows( outputs_count, work, [ & ]( unsigned int first, unsigned int count ) {
+				gemm( scaled_deltas.block( 0, first, batch_size, count ), true, inputs, false, weights.block( first, 0, count, inputs_count ), true );
+			} );
+
+			m_weights.updateReducedCopy();
 		}
 };
 
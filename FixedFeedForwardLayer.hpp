@@ -0,0 +1,314 @@
+#ifndef FIXEDFEEDFORWARDLAYER_HPP
+#define FIXEDFEEDFORWARDLAYER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "FixedMatrix.hpp"
+#include "FixedVector.hpp"
+#include "NetworkLayer.hpp"
+#include "Vector.hpp"
+
+/**
+ * A feed-forward layer with its dimensions fixed at compile time. Behaves and saves exactly like a single precision, unpruned FeedForwardLayer, but every loop has a constant trip count so small layers are fully unrolled and vectorized. The network replaces it with a FeedForwardLayer when reduced precision or pruning is asked for.
+ */
+template< unsigned int Inputs, unsigned int Outputs >
+class FixedFeedForwardLayer : public NetworkLayer {
+	private:
+		// Rows are padded to 64 bytes like a Matrix's, so the parameters are laid out exactly as a FeedForwardLayer's of the same size and optimizer state carries over between them
+		static const unsigned int Stride = ( Inputs + 15 ) / 16 * 16;
+
+		FixedMatrix< Outputs, Stride > m_weights;
+		FixedVector< Outputs > m_bias;
+
+		FixedMatrix< Outputs, Stride > m_weight_gradients;
+		FixedVector< Outputs > m_bias_gradients;
+
+		// Where the parameters and gradients are read and written: the members above, until the layer is bound to external buffers
+		float* m_weight_values;
+		float* m_bias_values;
+		float* m_weight_gradient_values;
+		float* m_bias_gradient_values;
+
+		FixedFeedForwardLayer( const FixedFeedForwardLayer& ) = delete;
+		FixedFeedForwardLayer& operator=( const FixedFeedForwardLayer& ) = delete;
+
+		float* weightRow( unsigned int y ) {
+			return m_weight_values + y * Stride;
+		}
+
+		void clearGradients() {
+			std::fill( m_weight_gradient_values, m_weight_gradient_values + Outputs * Stride, 0.f );
+			std::fill( m_bias_gradient_values, m_bias_gradient_values + Outputs, 0.f );
+		}
+
+		/**
+		 * Calculate the error at the layer's input, walking the rows in order so the inner loop over the inputs vectorizes.
+		 */
+		void calculateNewDelta( const FixedVector< Outputs >& scaled_delta, VectorView new_delta ) {
+			FixedVector< Inputs > fixed_new_delta;
+			for( unsigned int x = 0; x < Inputs; ++x ) {
+				fixed_new_delta( x ) = 0.f;
+			}
+
+			for( unsigned int y = 0; y < Outputs; ++y ) {
+				const float* row = weightRow( y );
+				const float delta_value = scaled_delta( y );
+
+				for( unsigned int x = 0; x < Inputs; ++x ) {
+					fixed_new_delta( x ) += delta_value * row[ x ];
+				}
+			}
+
+			for( unsigned int x = 0; x < Inputs; ++x ) {
+				new_delta( x ) = fixed_new_delta( x );
+			}
+		}
+
+		float activationOutputDerivative( float output ) {
+			return ( 1.f - output * output );
+		}
+
+	protected:
+		virtual void setSizeInternal( const unsigned int inputs, const unsigned int outputs ) {
+			// Zero means the count has not been set yet
+			if( ( inputs != 0 && inputs != Inputs ) || ( outputs != 0 && outputs != Outputs ) ) {
+				throw std::string( "Fixed size layer cannot be resized" );
+			}
+
+			// Init randomly to make rows unique
+			std::random_device device;
+			std::mt19937 generator( device() );
+			std::uniform_real_distribution<> distribution( -0.01f, 0.01f );
+			for( unsigned int y = 0; y < Outputs; ++y ) {
+				for( unsigned int x = 0; x < Inputs; ++x ) {
+					weightRow( y )[ x ] = distribution( generator );
+				}
+
+				m_bias_values[ y ] = distribution( generator );
+			}
+		}
+
+		virtual void loadFromJSONInternal( Json::Value& data_value ) {
+			Json::Value weights = data_value[ "weights" ];
+			Json::Value bias = data_value[ "bias" ];
+
+			for( unsigned int y = 0; y < Outputs; ++y ) {
+				for( unsigned int x = 0; x < Inputs; ++x ) {
+					weightRow( y )[ x ] = weights[ y * Inputs + x ].asFloat();
+				}
+
+				m_bias_values[ y ] = bias[ y ].asFloat();
+			}
+		}
+
+		virtual Json::Value saveToJSONInternal() {
+			Json::Value data_object( Json::objectValue );
+
+			Json::Value weights( Json::arrayValue );
+			weights.resize( Inputs * Outputs );
+
+			Json::Value bias( Json::arrayValue );
+			bias.resize( Outputs );
+
+			for( unsigned int y = 0; y < Outputs; ++y ) {
+				for( unsigned int x = 0; x < Inputs; ++x ) {
+					weights[ y * Inputs + x ] = weightRow( y )[ x ];
+				}
+
+				bias[ y ] = m_bias_values[ y ];
+			}
+
+			data_object[ "weights" ] = weights;
+			data_object[ "bias" ] = bias;
+
+			return data_object;
+		}
+
+		virtual std::string getJSONTypeName() const {
+			return std::string( "feed-forward" );
+		}
+
+		virtual void computeGradientsInternal( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta ) {
+			Vector input_storage;
+			input = makeContiguous( input, input_storage );
+			const float* input_values = input.data();
+
+			FixedVector< Outputs > scaled_delta;
+			scaled_delta = delta * apply( output, [ this ]( float value ) { return activationOutputDerivative( value ); } );
+
+			if( new_delta.data() ) {
+				calculateNewDelta( scaled_delta, new_delta );
+			}
+
+			for( unsigned int y = 0; y < Outputs; ++y ) {
+				float* row = m_weight_gradient_values + y * Stride;
+				const float delta_value = scaled_delta( y );
+
+				for( unsigned int x = 0; x < Inputs; ++x ) {
+					row[ x ] += delta_value * input_values[ x ];
+				}
+
+				m_bias_gradient_values[ y ] += delta_value;
+			}
+		}
+
+		virtual void applyGradientsInternal( Optimizer& optimizer, float scale ) {
+			optimizer.update( getParameterOffset(), m_weight_values, m_weight_gradient_values, Outputs * Stride, scale );
+			optimizer.update( getParameterOffset() + Outputs * Stride, m_bias_values, m_bias_gradient_values, Outputs, scale );
+			clearGradients();
+		}
+
+	public:
+		FixedFeedForwardLayer() {
+			m_weight_values = m_weights.data();
+			m_bias_values = m_bias.data();
+			m_weight_gradient_values = m_weight_gradients.data();
+			m_bias_gradient_values = m_bias_gradients.data();
+
+			// The row padding is never written after this
+			std::fill( m_weight_values, m_weight_values + Outputs * Stride, 0.f );
+			setInputCount( Inputs );
+			setOutputCount( Outputs );
+			clearGradients();
+		}
+
+		using NetworkLayer::propagate;
+		using NetworkLayer::train;
+
+		virtual bool isFixedSize() const {
+			return true;
+		}
+
+		virtual std::size_t getParameterCount() const {
+			return Outputs * Stride + alignParameterCount( Outputs );
+		}
+
+		virtual void bindParameters( float* parameters, float* gradients ) {
+			const std::size_t bias_offset = Outputs * Stride;
+
+			float* weight_values = parameters ? parameters : m_weights.data();
+			float* bias_values = parameters ? parameters + bias_offset : m_bias.data();
+			std::copy( m_weight_values, m_weight_values + Outputs * Stride, weight_values );
+			std::copy( m_bias_values, m_bias_values + Outputs, bias_values );
+			m_weight_values = weight_values;
+			m_bias_values = bias_values;
+
+			float* weight_gradient_values = gradients ? gradients : m_weight_gradients.data();
+			float* bias_gradient_values = gradients ? gradients + bias_offset : m_bias_gradients.data();
+			std::copy( m_weight_gradient_values, m_weight_gradient_values + Outputs * Stride, weight_gradient_values );
+			std::copy( m_bias_gradient_values, m_bias_gradient_values + Outputs, bias_gradient_values );
+			m_weight_gradient_values = weight_gradient_values;
+			m_bias_gradient_values = bias_gradient_values;
+		}
+
+		virtual void propagate( ConstVectorView input, VectorView output ) {
+			if( input.getDimension() != Inputs ) {
+				throw std::string( "Invalid input size to layer propagation" );
+			}
+
+			if( output.getDimension() != Outputs ) {
+				throw std::string( "Invalid output size to layer propagation" );
+			}
+
+			Vector input_storage;
+			input = makeContiguous( input, input_storage );
+			const float* input_values = input.data();
+
+			for( unsigned int y = 0; y < Outputs; ++y ) {
+				const float* row = weightRow( y );
+				float accum = m_bias_values[ y ];
+
+				for( unsigned int x = 0; x < Inputs; ++x ) {
+					accum += row[ x ] * input_values[ x ];
+				}
+
+				output( y ) = activate( ActivationFunction::Tanh, getActivationAccuracy(), accum );
+			}
+		}
+
+		virtual void train( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta, float mutability = 0.05f ) {
+			if( input.getDimension() != Inputs ) {
+				throw std::string( "Invalid input size to layer training" );
+			}
+
+			if( delta.getDimension() != Outputs ) {
+				throw std::string( "Invalid delta size to layer training" );
+			}
+
+			if( output.getDimension() != Outputs ) {
+				throw std::string( "Invalid output size to layer training" );
+			}
+
+			if( new_delta.data() && new_delta.getDimension() != Inputs ) {
+				throw std::string( "Invalid new delta size to layer training" );
+			}
+
+			Vector input_storage;
+			input = makeContiguous( input, input_storage );
+			const float* input_values = input.data();
+
+			FixedVector< Outputs > scaled_delta;
+			scaled_delta = delta * apply( output, [ this ]( float value ) { return activationOutputDerivative( value ); } );
+
+			if( new_delta.data() ) {
+				calculateNewDelta( scaled_delta, new_delta );
+			}
+
+			for( unsigned int y = 0; y < Outputs; ++y ) {
+				float* row = weightRow( y );
+				const float step = mutability * scaled_delta( y );
+
+				for( unsigned int x = 0; x < Inputs; ++x ) {
+					row[ x ] -= step * input_values[ x ];
+				}
+
+				m_bias_values[ y ] -= step;
+			}
+		}
+};
+
+/**
+ * A layer size for which a FixedFeedForwardLayer is compiled in.
+ */
+template< unsigned int Inputs, unsigned int Outputs >
+struct FixedLayerSize {
+};
+
+/**
+ * Creates fixed size feed-forward layers for a list of FixedLayerSize entries.
+ */
+template< typename... Sizes >
+struct FixedFeedForwardLayerFactory;
+
+template<>
+struct FixedFeedForwardLayerFactory<> {
+	static NetworkLayer* create( unsigned int, unsigned int ) {
+		return nullptr;
+	}
+};
+
+template< unsigned int Inputs, unsigned int Outputs, typename... Rest >
+struct FixedFeedForwardLayerFactory< FixedLayerSize< Inputs, Outputs >, Rest... > {
+	/**
+	 * Create a fixed size layer if one was compiled in for the given size.
+	 * @param inputs The number of inputs to the layer.
+	 * @param outputs The number of outputs from the layer.
+	 * @return The new layer, or null if the size is not in the list.
+	 */
+	static NetworkLayer* create( unsigned int inputs, unsigned int outputs ) {
+		if( inputs == Inputs && outputs == Outputs ) {
+			return new FixedFeedForwardLayer< Inputs, Outputs >;
+		}
+
+		return FixedFeedForwardLayerFactory< Rest... >::create( inputs, outputs );
+	}
+};
+
+// The time index input layer into common hidden widths, and square hidden layers of those widths
+typedef FixedFeedForwardLayerFactory<
+	FixedLayerSize< 1, 16 >, FixedLayerSize< 1, 32 >, FixedLayerSize< 1, 64 >, FixedLayerSize< 1, 128 >,
+	FixedLayerSize< 16, 16 >, FixedLayerSize< 32, 32 >, FixedLayerSize< 64, 64 >, FixedLayerSize< 128, 128 >
+> PrecompiledFeedForwardLayers;
+
+#endif // FIXEDFEEDFORWARDLAYER_HPP
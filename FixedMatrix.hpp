@@ -0,0 +1,71 @@
+#ifndef FIXEDMATRIX_HPP
+#define FIXEDMATRIX_HPP
+
+#include <string>
+#include "MatrixView.hpp"
+
+/**
+ * A matrix whose dimensions are known at compile time, stored inline. Loops bounded by its dimensions can be fully unrolled and vectorized by the compiler.
+ */
+template< unsigned int Height, unsigned int Width >
+class FixedMatrix {
+	private:
+		float m_values[ Height * Width ];
+
+	public:
+		static constexpr unsigned int getWidth() {
+			return Width;
+		}
+
+		static constexpr unsigned int getHeight() {
+			return Height;
+		}
+
+		static constexpr unsigned int getStride() {
+			return Width;
+		}
+
+		float& operator()( unsigned int y, unsigned int x ) {
+#ifdef NN_BOUNDS_CHECK
+			if( y >= Height || x >= Width ) {
+				throw std::string( "Matrix access out of bounds" );
+			}
+#endif
+			return m_values[ y * Width + x ];
+		}
+
+		float operator()( unsigned int y, unsigned int x ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( y >= Height || x >= Width ) {
+				throw std::string( "Matrix access out of bounds" );
+			}
+#endif
+			return m_values[ y * Width + x ];
+		}
+
+		float* row( unsigned int y ) {
+			return m_values + y * Width;
+		}
+
+		const float* row( unsigned int y ) const {
+			return m_values + y * Width;
+		}
+
+		float* data() {
+			return m_values;
+		}
+
+		const float* data() const {
+			return m_values;
+		}
+
+		operator MatrixView() {
+			return MatrixView( m_values, Height, Width, Width );
+		}
+
+		operator ConstMatrixView() const {
+			return ConstMatrixView( m_values, Height, Width, Width );
+		}
+};
+
+#endif // FIXEDMATRIX_HPP
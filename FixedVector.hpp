@@ -0,0 +1,87 @@
+#ifndef FIXEDVECTOR_HPP
+#define FIXEDVECTOR_HPP
+
+#include <string>
+#include "VectorExpression.hpp"
+#include "VectorView.hpp"
+
+template< unsigned int Dimension >
+class FixedVector;
+
+template< unsigned int Dimension >
+struct VectorExpressionStorage< FixedVector< Dimension > > {
+	typedef const FixedVector< Dimension >& type;
+};
+
+/**
+ * A vector whose dimension is known at compile time, stored inline. Small enough instances can live on the stack instead of in an arena.
+ */
+template< unsigned int Dimension >
+class FixedVector : public VectorExpression< FixedVector< Dimension > > {
+	private:
+		float m_values[ Dimension ];
+
+	public:
+		static constexpr unsigned int getDimension() {
+			return Dimension;
+		}
+
+		/**
+		 * Evaluate an expression into the vector in a single pass. The vector may appear in the expression.
+		 * @param expression The expression to evaluate. Its dimension must match.
+		 * @return This vector.
+		 */
+		template< typename Expression >
+		FixedVector& operator=( const VectorExpression< Expression >& expression ) {
+#ifdef NN_BOUNDS_CHECK
+			if( expression.getDimension() != Dimension ) {
+				throw std::string( "Mismatched vector dimensions in assignment" );
+			}
+#endif
+			for( unsigned int i = 0; i < Dimension; ++i ) {
+				m_values[ i ] = expression.evaluate( i );
+			}
+
+			return *this;
+		}
+
+		float& operator()( unsigned int index ) {
+#ifdef NN_BOUNDS_CHECK
+			if( index >= Dimension ) {
+				throw std::string( "Vector access out of bounds" );
+			}
+#endif
+			return m_values[ index ];
+		}
+
+		float operator()( unsigned int index ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( index >= Dimension ) {
+				throw std::string( "Vector access out of bounds" );
+			}
+#endif
+			return m_values[ index ];
+		}
+
+		float evaluate( unsigned int index ) const {
+			return m_values[ index ];
+		}
+
+		float* data() {
+			return m_values;
+		}
+
+		const float* data() const {
+			return m_values;
+		}
+
+		operator VectorView() {
+			return VectorView( m_values, Dimension );
+		}
+
+		operator ConstVectorView() const {
+			return ConstVectorView( m_values, Dimension );
+		}
+};
+
+#endif // FIXEDVECTOR_HPP
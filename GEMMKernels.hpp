@@ -0,0 +1,315 @@
+#ifndef GEMMKERNELS_HPP
+#define GEMMKERNELS_HPP
+
+#include <cstddef>
+#include <string>
+#include "AlignedBuffer.hpp"
+#include "CPUFeatures.hpp"
+#include "MatrixView.hpp"
+
+#if NN_X86
+#include <immintrin.h>
+#endif
+
+// Cache blocking: a KC x NC panel of B stays in L3, an MC x KC panel of A stays in L2
+const unsigned int gemm_block_m = 96;
+const unsigned int gemm_block_k = 256;
+const unsigned int gemm_block_n = 2048;
+
+/**
+ * Computes an mr x nr tile of C from packed panels of A and B. The tile is written to a scratch tile of stride nr rather than to C, so edges never need special cases.
+ * @param depth The number of packed columns of A and rows of B.
+ * @param packed_a The packed A panel, mr values for each step of depth.
+ * @param packed_b The packed B panel, nr values for each step of depth.
+ * @param tile The mr x nr output tile.
+ */
+typedef void ( *GEMMMicroKernel )( unsigned int depth, const float* packed_a, const float* packed_b, float* tile );
+
+struct GEMMKernel {
+	unsigned int mr;
+	unsigned int nr;
+	GEMMMicroKernel micro_kernel;
+	const char* name;
+};
+
+void gemmMicroKernelScalar( unsigned int depth, const float* packed_a, const float* packed_b, float* tile ) {
+	float accum[ 4 ][ 4 ] = {};
+
+	for( unsigned int p = 0; p < depth; ++p ) {
+		for( unsigned int i = 0; i < 4; ++i ) {
+			for( unsigned int j = 0; j < 4; ++j ) {
+				accum[ i ][ j ] += packed_a[ p * 4 + i ] * packed_b[ p * 4 + j ];
+			}
+		}
+	}
+
+	for( unsigned int i = 0; i < 4; ++i ) {
+		for( unsigned int j = 0; j < 4; ++j ) {
+			tile[ i * 4 + j ] = accum[ i ][ j ];
+		}
+	}
+}
+
+#if NN_X86
+__attribute__(( target( "avx2,fma" ) ))
+void gemmMicroKernelAVX2( unsigned int depth, const float* packed_a, const float* packed_b, float* tile ) {
+	// 6 x 16 tile held in 12 registers, leaving room for two B loads and one broadcast
+	__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+	__m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+	__m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+	__m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+	__m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+	__m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+	for( unsigned int p = 0; p < depth; ++p ) {
+		__m256 b0 = _mm256_load_ps( packed_b );
+		__m256 b1 = _mm256_load_ps( packed_b + 8 );
+		__m256 a;
+
+		a = _mm256_broadcast_ss( packed_a );
+		c00 = _mm256_fmadd_ps( a, b0, c00 );
+		c01 = _mm256_fmadd_ps( a, b1, c01 );
+		a = _mm256_broadcast_ss( packed_a + 1 );
+		c10 = _mm256_fmadd_ps( a, b0, c10 );
+		c11 = _mm256_fmadd_ps( a, b1, c11 );
+		a = _mm256_broadcast_ss( packed_a + 2 );
+		c20 = _mm256_fmadd_ps( a, b0, c20 );
+		c21 = _mm256_fmadd_ps( a, b1, c21 );
+		a = _mm256_broadcast_ss( packed_a + 3 );
+		c30 = _mm256_fmadd_ps( a, b0, c30 );
+		c31 = _mm256_fmadd_ps( a, b1, c31 );
+		a = _mm256_broadcast_ss( packed_a + 4 );
+		c40 = _mm256_fmadd_ps( a, b0, c40 );
+		c41 = _mm256_fmadd_ps( a, b1, c41 );
+		a = _mm256_broadcast_ss( packed_a + 5 );
+		c50 = _mm256_fmadd_ps( a, b0, c50 );
+		c51 = _mm256_fmadd_ps( a, b1, c51 );
+
+		packed_a += 6;
+		packed_b += 16;
+	}
+
+	_mm256_store_ps( tile, c00 );
+	_mm256_store_ps( tile + 8, c01 );
+	_mm256_store_ps( tile + 16, c10 );
+	_mm256_store_ps( tile + 24, c11 );
+	_mm256_store_ps( tile + 32, c20 );
+	_mm256_store_ps( tile + 40, c21 );
+	_mm256_store_ps( tile + 48, c30 );
+	_mm256_store_ps( tile + 56, c31 );
+	_mm256_store_ps( tile + 64, c40 );
+	_mm256_store_ps( tile + 72, c41 );
+	_mm256_store_ps( tile + 80, c50 );
+	_mm256_store_ps( tile + 88, c51 );
+}
+
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void gemmMicroKernelAVX512( unsigned int depth, const float* packed_a, const float* packed_b, float* tile ) {
+	// 12 x 16 tile, one register per row
+	__m512 c[ 12 ];
+#pragma GCC unroll 12
+	for( unsigned int i = 0; i < 12; ++i ) {
+		c[ i ] = _mm512_setzero_ps();
+	}
+
+	for( unsigned int p = 0; p < depth; ++p ) {
+		__m512 b = _mm512_load_ps( packed_b );
+
+#pragma GCC unroll 12
+		for( unsigned int i = 0; i < 12; ++i ) {
+			c[ i ] = _mm512_fmadd_ps( _mm512_set1_ps( packed_a[ i ] ), b, c[ i ] );
+		}
+
+		packed_a += 12;
+		packed_b += 16;
+	}
+
+#pragma GCC unroll 12
+	for( unsigned int i = 0; i < 12; ++i ) {
+		_mm512_store_ps( tile + i * 16, c[ i ] );
+	}
+}
+#endif
+
+/**
+ * Pick the widest matrix-matrix micro-kernel the CPU supports. Selected once on first use.
+ * @return The selected kernel and its tile shape.
+ */
+const GEMMKernel& selectGEMMKernel() {
+	static const GEMMKernel kernel = []() -> GEMMKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512() ) {
+			return GEMMKernel{ 12, 16, gemmMicroKernelAVX512, "AVX-512" };
+		}
+
+		if( features.hasAVX2() ) {
+			return GEMMKernel{ 6, 16, gemmMicroKernelAVX2, "AVX2" };
+		}
+#endif
+		return GEMMKernel{ 4, 4, gemmMicroKernelScalar, "scalar" };
+	}();
+
+	return kernel;
+}
+
+/**
+ * Pack a block of op(A) into row panels of height mr, laid out so the micro-kernel reads it sequentially. Rows past the end of the block are zero-filled.
+ */
+void gemmPackA( ConstMatrixView a, bool transpose, unsigned int row, unsigned int column, unsigned int rows, unsigned int depth, unsigned int mr, float* packed ) {
+	for( unsigned int panel = 0; panel < rows; panel += mr ) {
+		unsigned int panel_rows = rows - panel < mr ? rows - panel : mr;
+
+		for( unsigned int p = 0; p < depth; ++p ) {
+			for( unsigned int i = 0; i < panel_rows; ++i ) {
+				unsigned int y = row + panel + i;
+				unsigned int x = column + p;
+				packed[ i ] = transpose ? a.row( x )[ y ] : a.row( y )[ x ];
+			}
+
+			for( unsigned int i = panel_rows; i < mr; ++i ) {
+				packed[ i ] = 0.f;
+			}
+
+			packed += mr;
+		}
+	}
+}
+
+/**
+ * Pack a block of op(B) into column panels of width nr. Columns past the end of the block are zero-filled.
+ */
+void gemmPackB( ConstMatrixView b, bool transpose, unsigned int row, unsigned int column, unsigned int depth, unsigned int columns, unsigned int nr, float* packed ) {
+	for( unsigned int panel = 0; panel < columns; panel += nr ) {
+		unsigned int panel_columns = columns - panel < nr ? columns - panel : nr;
+
+		for( unsigned int p = 0; p < depth; ++p ) {
+			if( transpose ) {
+				for( unsigned int j = 0; j < panel_columns; ++j ) {
+					packed[ j ] = b.row( column + panel + j )[ row + p ];
+				}
+			} else {
+				const float* source = b.row( row + p ) + column + panel;
+				for( unsigned int j = 0; j < panel_columns; ++j ) {
+					packed[ j ] = source[ j ];
+				}
+			}
+
+			for( unsigned int j = panel_columns; j < nr; ++j ) {
+				packed[ j ] = 0.f;
+			}
+
+			packed += nr;
+		}
+	}
+}
+
+/**
+ * Calculate c = op(a) * op(b), or c += op(a) * op(b), with a cache-blocked, register-tiled algorithm.
+ * @param a The left matrix. op(a) is M x K.
+ * @param transpose_a Whether op(a) is the transpose of a.
+ * @param b The right matrix. op(b) is K x N.
+ * @param transpose_b Whether op(b) is the transpose of b.
+ * @param c The M x N result.
+ * @param accumulate Whether to add to the existing contents of c instead of overwriting them.
+ */
+void gemm( ConstMatrixView a, bool transpose_a, ConstMatrixView b, bool transpose_b, MatrixView c, bool accumulate = false ) {
+	const unsigned int m = transpose_a ? a.getWidth() : a.getHeight();
+	const unsigned int k = transpose_a ? a.getHeight() : a.getWidth();
+	const unsigned int n = transpose_b ? b.getHeight() : b.getWidth();
+
+	if( ( transpose_b ? b.getWidth() : b.getHeight() ) != k || c.getHeight() != m || c.getWidth() != n ) {
+		throw std::string( "Mismatched dimensions in matrix-matrix product" );
+	}
+
+	if( k == 0 ) {
+		if( !accumulate ) {
+			for( unsigned int y = 0; y < m; ++y ) {
+				for( unsigned int x = 0; x < n; ++x ) {
+					c( y, x ) = 0.f;
+				}
+			}
+		}
+
+		return;
+	}
+
+	const GEMMKernel& kernel = selectGEMMKernel();
+	const unsigned int mr = kernel.mr;
+	const unsigned int nr = kernel.nr;
+
+	static thread_local AlignedBuffer< float > packed_a;
+	static thread_local AlignedBuffer< float > packed_b;
+	static thread_local AlignedBuffer< float > tile;
+	packed_a.resize( static_cast< std::size_t >( gemm_block_m + mr ) * gemm_block_k );
+	packed_b.resize( static_cast< std::size_t >( gemm_block_n + nr ) * gemm_block_k );
+	tile.resize( mr * nr );
+
+	for( unsigned int jc = 0; jc < n; jc += gemm_block_n ) {
+		unsigned int nc = n - jc < gemm_block_n ? n - jc : gemm_block_n;
+
+		for( unsigned int pc = 0; pc < k; pc += gemm_block_k ) {
+			unsigned int kc = k - pc < gemm_block_k ? k - pc : gemm_block_k;
+			bool add = accumulate || pc > 0;
+
+			gemmPackB( b, transpose_b, pc, jc, kc, nc, nr, packed_b.data() );
+
+			for( unsigned int ic = 0; ic < m; ic += gemm_block_m ) {
+				unsigned int mc = m - ic < gemm_block_m ? m - ic : gemm_block_m;
+
+				gemmPackA( a, transpose_a, ic, pc, mc, kc, mr, packed_a.data() );
+
+				for( unsigned int jr = 0; jr < nc; jr += nr ) {
+					unsigned int tile_columns = nc - jr < nr ? nc - jr : nr;
+					const float* panel_b = packed_b.data() + static_cast< std::size_t >( jr ) * kc;
+
+					for( unsigned int ir = 0; ir < mc; ir += mr ) {
+						unsigned int tile_rows = mc - ir < mr ? mc - ir : mr;
+						const float* panel_a = packed_a.data() + static_cast< std::size_t >( ir ) * kc;
+
+						kernel.micro_kernel( kc, panel_a, panel_b, tile.data() );
+
+						for( unsigned int i = 0; i < tile_rows; ++i ) {
+							float* destination = c.row( ic + ir + i ) + jc + jr;
+							const float* source = tile.data() + i * nr;
+
+							if( add ) {
+								for( unsigned int j = 0; j < tile_columns; ++j ) {
+									destination[ j ] += source[ j ];
+								}
+							} else {
+								for( unsigned int j = 0; j < tile_columns; ++j ) {
+									destination[ j ] = source[ j ];
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Reference matrix-matrix product, the plain triple loop. Used to check and benchmark gemm().
+ */
+void gemmNaive( ConstMatrixView a, bool transpose_a, ConstMatrixView b, bool transpose_b, MatrixView c, bool accumulate = false ) {
+	const unsigned int m = c.getHeight();
+	const unsigned int n = c.getWidth();
+	const unsigned int k = transpose_a ? a.getHeight() : a.getWidth();
+
+	for( unsigned int y = 0; y < m; ++y ) {
+		for( unsigned int x = 0; x < n; ++x ) {
+			float accum = accumulate ? c( y, x ) : 0.f;
+
+			for( unsigned int p = 0; p < k; ++p ) {
+				accum += ( transpose_a ? a( p, y ) : a( y, p ) ) * ( transpose_b ? b( x, p ) : b( p, x ) );
+			}
+
+			c( y, x ) = accum;
+		}
+	}
+}
+
+#endif // GEMMKERNELS_HPP
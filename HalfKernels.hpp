@@ -0,0 +1,316 @@
+#ifndef HALFKERNELS_HPP
+#define HALFKERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "CPUFeatures.hpp"
+#include "HalfPrecision.hpp"
+#include "Matrix.hpp"
+#include "MatrixKernels.hpp"
+#include "QuantizedKernels.hpp"
+#include "VectorView.hpp"
+
+#if NN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Reference matrix-vector product over 16 bit weights, accumulating in single precision.
+ * @param weights The row-major weight matrix, in the precision given by the template argument.
+ * @param stride The distance in elements between the starts of consecutive rows.
+ * @param height The number of rows in the matrix.
+ * @param width The number of columns in the matrix.
+ * @param input The vector to multiply by, of length width.
+ * @param bias The vector to add to the product, of length height. May be null.
+ * @param output The vector to write the result into, of length height.
+ */
+template< WeightPrecision Precision >
+void gemvHalfScalar( const std::uint16_t* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, const float* bias, float* output ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		const std::uint16_t* row = weights + static_cast< std::size_t >( y ) * stride;
+		float accum = bias ? bias[ y ] : 0.f;
+
+		for( unsigned int x = 0; x < width; ++x ) {
+			accum += decodeWeight( row[ x ], Precision ) * input[ x ];
+		}
+
+		output[ y ] = accum;
+	}
+}
+
+#if NN_X86
+template< WeightPrecision Precision >
+__m256 loadHalfAVX2( const std::uint16_t* values );
+
+// A bfloat16 is the top half of a float, so widening is a shift
+template<>
+__attribute__(( target( "avx2,fma" ) ))
+__m256 loadHalfAVX2< WeightPrecision::BFloat16 >( const std::uint16_t* values ) {
+	__m128i packed = _mm_loadu_si128( reinterpret_cast< const __m128i* >( values ) );
+	return _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_cvtepu16_epi32( packed ), 16 ) );
+}
+
+template<>
+__attribute__(( target( "avx2,fma,f16c" ) ))
+__m256 loadHalfAVX2< WeightPrecision::Float16 >( const std::uint16_t* values ) {
+	return _mm256_cvtph_ps( _mm_loadu_si128( reinterpret_cast< const __m128i* >( values ) ) );
+}
+
+template< WeightPrecision Precision >
+__attribute__(( target( "avx2,fma,f16c" ) ))
+void gemvHalfAVX2( const std::uint16_t* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, const float* bias, float* output ) {
+	unsigned int vector_width = width & ~7u;
+	unsigned int y = 0;
+
+	for( ; y + 4 <= height; y += 4 ) {
+		const std::uint16_t* row0 = weights + static_cast< std::size_t >( y ) * stride;
+		const std::uint16_t* row1 = row0 + stride;
+		const std::uint16_t* row2 = row1 + stride;
+		const std::uint16_t* row3 = row2 + stride;
+		__m256 accum0 = _mm256_setzero_ps();
+		__m256 accum1 = _mm256_setzero_ps();
+		__m256 accum2 = _mm256_setzero_ps();
+		__m256 accum3 = _mm256_setzero_ps();
+
+		for( unsigned int x = 0; x < vector_width; x += 8 ) {
+			__m256 in = _mm256_loadu_ps( input + x );
+			accum0 = _mm256_fmadd_ps( loadHalfAVX2< Precision >( row0 + x ), in, accum0 );
+			accum1 = _mm256_fmadd_ps( loadHalfAVX2< Precision >( row1 + x ), in, accum1 );
+			accum2 = _mm256_fmadd_ps( loadHalfAVX2< Precision >( row2 + x ), in, accum2 );
+			accum3 = _mm256_fmadd_ps( loadHalfAVX2< Precision >( row3 + x ), in, accum3 );
+		}
+
+		float result0 = horizontalSumAVX2( accum0 );
+		float result1 = horizontalSumAVX2( accum1 );
+		float result2 = horizontalSumAVX2( accum2 );
+		float result3 = horizontalSumAVX2( accum3 );
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			result0 += decodeWeight( row0[ x ], Precision ) * input[ x ];
+			result1 += decodeWeight( row1[ x ], Precision ) * input[ x ];
+			result2 += decodeWeight( row2[ x ], Precision ) * input[ x ];
+			result3 += decodeWeight( row3[ x ], Precision ) * input[ x ];
+		}
+
+		if( bias ) {
+			result0 += bias[ y ];
+			result1 += bias[ y + 1 ];
+			result2 += bias[ y + 2 ];
+			result3 += bias[ y + 3 ];
+		}
+
+		output[ y ] = result0;
+		output[ y + 1 ] = result1;
+		output[ y + 2 ] = result2;
+		output[ y + 3 ] = result3;
+	}
+
+	for( ; y < height; ++y ) {
+		const std::uint16_t* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m256 accum = _mm256_setzero_ps();
+
+		for( unsigned int x = 0; x < vector_width; x += 8 ) {
+			accum = _mm256_fmadd_ps( loadHalfAVX2< Precision >( row + x ), _mm256_loadu_ps( input + x ), accum );
+		}
+
+		float result = horizontalSumAVX2( accum ) + ( bias ? bias[ y ] : 0.f );
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			result += decodeWeight( row[ x ], Precision ) * input[ x ];
+		}
+
+		output[ y ] = result;
+	}
+}
+
+template< WeightPrecision Precision >
+__m512 loadHalfAVX512( const std::uint16_t* values );
+
+template<>
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+__m512 loadHalfAVX512< WeightPrecision::BFloat16 >( const std::uint16_t* values ) {
+	// The zero-masked forms avoid GCC's uninitialized warnings on the unmasked intrinsics
+	__m256i packed = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( values ) );
+	return _mm512_castsi512_ps( _mm512_maskz_slli_epi32( 0xffff, _mm512_maskz_cvtepu16_epi32( 0xffff, packed ), 16 ) );
+}
+
+template<>
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+__m512 loadHalfAVX512< WeightPrecision::Float16 >( const std::uint16_t* values ) {
+	return _mm512_maskz_cvtph_ps( 0xffff, _mm256_loadu_si256( reinterpret_cast< const __m256i* >( values ) ) );
+}
+
+template< WeightPrecision Precision >
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void gemvHalfAVX512( const std::uint16_t* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, const float* bias, float* output ) {
+	unsigned int vector_width = width & ~15u;
+	unsigned int y = 0;
+
+	for( ; y + 4 <= height; y += 4 ) {
+		const std::uint16_t* row0 = weights + static_cast< std::size_t >( y ) * stride;
+		const std::uint16_t* row1 = row0 + stride;
+		const std::uint16_t* row2 = row1 + stride;
+		const std::uint16_t* row3 = row2 + stride;
+		__m512 accum0 = _mm512_setzero_ps();
+		__m512 accum1 = _mm512_setzero_ps();
+		__m512 accum2 = _mm512_setzero_ps();
+		__m512 accum3 = _mm512_setzero_ps();
+
+		for( unsigned int x = 0; x < vector_width; x += 16 ) {
+			__m512 in = _mm512_loadu_ps( input + x );
+			accum0 = _mm512_fmadd_ps( loadHalfAVX512< Precision >( row0 + x ), in, accum0 );
+			accum1 = _mm512_fmadd_ps( loadHalfAVX512< Precision >( row1 + x ), in, accum1 );
+			accum2 = _mm512_fmadd_ps( loadHalfAVX512< Precision >( row2 + x ), in, accum2 );
+			accum3 = _mm512_fmadd_ps( loadHalfAVX512< Precision >( row3 + x ), in, accum3 );
+		}
+
+		float result0 = horizontalSumAVX512( accum0 );
+		float result1 = horizontalSumAVX512( accum1 );
+		float result2 = horizontalSumAVX512( accum2 );
+		float result3 = horizontalSumAVX512( accum3 );
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			result0 += decodeWeight( row0[ x ], Precision ) * input[ x ];
+			result1 += decodeWeight( row1[ x ], Precision ) * input[ x ];
+			result2 += decodeWeight( row2[ x ], Precision ) * input[ x ];
+			result3 += decodeWeight( row3[ x ], Precision ) * input[ x ];
+		}
+
+		if( bias ) {
+			result0 += bias[ y ];
+			result1 += bias[ y + 1 ];
+			result2 += bias[ y + 2 ];
+			result3 += bias[ y + 3 ];
+		}
+
+		output[ y ] = result0;
+		output[ y + 1 ] = result1;
+		output[ y + 2 ] = result2;
+		output[ y + 3 ] = result3;
+	}
+
+	for( ; y < height; ++y ) {
+		const std::uint16_t* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m512 accum = _mm512_setzero_ps();
+
+		for( unsigned int x = 0; x < vector_width; x += 16 ) {
+			accum = _mm512_fmadd_ps( loadHalfAVX512< Precision >( row + x ), _mm512_loadu_ps( input + x ), accum );
+		}
+
+		float result = horizontalSumAVX512( accum ) + ( bias ? bias[ y ] : 0.f );
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			result += decodeWeight( row[ x ], Precision ) * input[ x ];
+		}
+
+		output[ y ] = result;
+	}
+}
+#endif
+
+typedef void ( *HalfGEMVKernel )( const std::uint16_t*, unsigned int, unsigned int, unsigned int, const float*, const float*, float* );
+
+/**
+ * Pick the widest 16 bit matrix-vector kernel the CPU supports for a precision. Selected once per precision on first use.
+ * @param precision BFloat16 or Float16.
+ * @return The selected kernel.
+ */
+HalfGEMVKernel selectHalfGEMVKernel( WeightPrecision precision ) {
+	static const HalfGEMVKernel bfloat16_kernel = []() -> HalfGEMVKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512() ) {
+			return gemvHalfAVX512< WeightPrecision::BFloat16 >;
+		}
+
+		if( features.hasAVX2() && features.hasF16C() ) {
+			return gemvHalfAVX2< WeightPrecision::BFloat16 >;
+		}
+#endif
+		return gemvHalfScalar< WeightPrecision::BFloat16 >;
+	}();
+
+	static const HalfGEMVKernel float16_kernel = []() -> HalfGEMVKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512() ) {
+			return gemvHalfAVX512< WeightPrecision::Float16 >;
+		}
+
+		if( features.hasAVX2() && features.hasF16C() ) {
+			return gemvHalfAVX2< WeightPrecision::Float16 >;
+		}
+#endif
+		return gemvHalfScalar< WeightPrecision::Float16 >;
+	}();
+
+	return precision == WeightPrecision::BFloat16 ? bfloat16_kernel : float16_kernel;
+}
+
+/**
+ * Calculate output = activation( weights * input + bias ) over 16 bit weights. Each thread applies the activation to its rows as soon as they are done, while they are still in its cache.
+ * @param weights The weight matrix.
+ * @param input The vector to multiply by. Must match the width of the weight matrix.
+ * @param bias The vector to add to the product. Must match the height of the weight matrix, or be empty for no bias. May be the output vector.
+ * @param output The vector to write the result into. Must match the height of the weight matrix.
+ * @param function The activation to apply after the bias.
+ * @param accuracy The accuracy tier to apply it at.
+ */
+void gemv( HalfMatrixView weights, ConstVectorView input, ConstVectorView bias, VectorView output, ActivationFunction function = ActivationFunction::Identity, ActivationAccuracy accuracy = ActivationAccuracy::Exact ) {
+#ifdef NN_BOUNDS_CHECK
+	if( input.getDimension() != weights.getWidth() || output.getDimension() != weights.getHeight() || ( bias.data() && bias.getDimension() != weights.getHeight() ) ) {
+		throw std::string( "Mismatched dimensions in matrix-vector product" );
+	}
+#endif
+
+	if( input.isContiguous() && bias.isContiguous() && output.isContiguous() ) {
+		HalfGEMVKernel kernel = selectHalfGEMVKernel( weights.getPrecision() );
+		const unsigned int stride = weights.getStride();
+
+		parallelForRows( weights.getHeight(), static_cast< std::size_t >( weights.getHeight() ) * weights.getWidth(), [ & ]( unsigned int first, unsigned int count ) {
+			kernel( weights.data() + static_cast< std::size_t >( first ) * stride, stride, count, weights.getWidth(), input.data(), bias.data() ? bias.data() + first : nullptr, output.data() + first );
+			applyActivation( function, accuracy, output.slice( first, count ), output.slice( first, count ) );
+		} );
+		return;
+	}
+
+	for( unsigned int y = 0; y < weights.getHeight(); ++y ) {
+		const std::uint16_t* row = weights.data() + static_cast< std::size_t >( y ) * weights.getStride();
+		float accum = bias.data() ? bias( y ) : 0.f;
+
+		for( unsigned int x = 0; x < weights.getWidth(); ++x ) {
+			accum += decodeWeight( row[ x ], weights.getPrecision() ) * input( x );
+		}
+
+		output( y ) = activate( function, accuracy, accum );
+	}
+}
+
+/**
+ * Calculate output = activation( weights * input + bias ), reading the weights in the matrix's precision.
+ * @param weights The weight matrix.
+ * @param input The vector to multiply by. Must match the width of the weight matrix.
+ * @param bias The vector to add to the product. Must match the height of the weight matrix, or be empty for no bias. May be the output vector.
+ * @param output The vector to write the result into. Must match the height of the weight matrix.
+ * @param function The activation to apply after the bias.
+ * @param accuracy The accuracy tier to apply it at.
+ */
+void gemv( const Matrix& weights, ConstVectorView input, ConstVectorView bias, VectorView output, ActivationFunction function = ActivationFunction::Identity, ActivationAccuracy accuracy = ActivationAccuracy::Exact ) {
+	switch( weights.getPrecision() ) {
+		case WeightPrecision::Float32:
+			gemv( static_cast< ConstMatrixView >( weights ), input, bias, output, function, accuracy );
+			break;
+
+		case WeightPrecision::Int8:
+			gemv( weights.getQuantized(), input, bias, output, function, accuracy );
+			break;
+
+		default:
+			gemv( weights.getReducedView(), input, bias, output, function, accuracy );
+			break;
+	}
+}
+
+#endif // HALFKERNELS_HPP
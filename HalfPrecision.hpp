@@ -0,0 +1,211 @@
+#ifndef HALFPRECISION_HPP
+#define HALFPRECISION_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * The format a matrix's weights are streamed in during propagation. The 16 bit formats halve the bytes read per weight and still accumulate in single precision. Int8 quarters them, with a scale per row, and accumulates in integers.
+ */
+enum class WeightPrecision {
+	Float32,
+	BFloat16,
+	Float16,
+	Int8
+};
+
+/**
+ * Round a float to the nearest bfloat16, ties to even.
+ * @param value The value to convert.
+ * @return The bits of the bfloat16.
+ */
+std::uint16_t floatToBFloat16( float value ) {
+	std::uint32_t bits;
+	std::memcpy( &bits, &value, sizeof( bits ) );
+
+	// Keep NaNs quiet instead of letting rounding carry them into infinity
+	if( ( bits & 0x7fffffffu ) > 0x7f800000u ) {
+		return static_cast< std::uint16_t >( ( bits >> 16 ) | 0x0040u );
+	}
+
+	bits += 0x7fffu + ( ( bits >> 16 ) & 1u );
+	return static_cast< std::uint16_t >( bits >> 16 );
+}
+
+float bfloat16ToFloat( std::uint16_t value ) {
+	std::uint32_t bits = static_cast< std::uint32_t >( value ) << 16;
+	float result;
+	std::memcpy( &result, &bits, sizeof( result ) );
+	return result;
+}
+
+/**
+ * Round a float to the nearest IEEE half, ties to even. Values too large for a half become infinity.
+ * @param value The value to convert.
+ * @return The bits of the half.
+ */
+std::uint16_t floatToHalf( float value ) {
+	std::uint32_t bits;
+	std::memcpy( &bits, &value, sizeof( bits ) );
+
+	const std::uint32_t sign = ( bits >> 16 ) & 0x8000u;
+	const int exponent = static_cast< int >( ( bits >> 23 ) & 0xffu );
+	std::uint32_t mantissa = bits & 0x7fffffu;
+
+	if( exponent == 0xff ) {
+		return static_cast< std::uint16_t >( sign | 0x7c00u | ( mantissa ? 0x200u : 0u ) );
+	}
+
+	const int half_exponent = exponent - 127 + 15;
+
+	if( half_exponent >= 0x1f ) {
+		return static_cast< std::uint16_t >( sign | 0x7c00u );
+	}
+
+	if( half_exponent <= 0 ) {
+		// Subnormal half, or zero if even rounding cannot reach the smallest subnormal
+		if( half_exponent < -10 ) {
+			return static_cast< std::uint16_t >( sign );
+		}
+
+		mantissa |= 0x800000u;
+		const unsigned int shift = static_cast< unsigned int >( 14 - half_exponent );
+		std::uint32_t result = mantissa >> shift;
+		const std::uint32_t remainder = mantissa & ( ( 1u << shift ) - 1u );
+		const std::uint32_t halfway = 1u << ( shift - 1 );
+
+		if( remainder > halfway || ( remainder == halfway && ( result & 1u ) ) ) {
+			++result;
+		}
+
+		return static_cast< std::uint16_t >( sign | result );
+	}
+
+	// A carry out of the mantissa correctly bumps the exponent, up to infinity
+	std::uint32_t result = ( static_cast< std::uint32_t >( half_exponent ) << 10 ) | ( mantissa >> 13 );
+	const std::uint32_t remainder = mantissa & 0x1fffu;
+
+	if( remainder > 0x1000u || ( remainder == 0x1000u && ( result & 1u ) ) ) {
+		++result;
+	}
+
+	return static_cast< std::uint16_t >( sign | result );
+}
+
+float halfToFloat( std::uint16_t value ) {
+	const std::uint32_t sign = static_cast< std::uint32_t >( value & 0x8000u ) << 16;
+	const std::uint32_t exponent = ( value >> 10 ) & 0x1fu;
+	const std::uint32_t mantissa = value & 0x3ffu;
+
+	if( exponent == 0 ) {
+		float magnitude = std::ldexp( static_cast< float >( mantissa ), -24 );
+		return sign ? -magnitude : magnitude;
+	}
+
+	std::uint32_t bits;
+	if( exponent == 0x1f ) {
+		bits = sign | 0x7f800000u | ( mantissa << 13 );
+	} else {
+		bits = sign | ( ( exponent + 112u ) << 23 ) | ( mantissa << 13 );
+	}
+
+	float result;
+	std::memcpy( &result, &bits, sizeof( result ) );
+	return result;
+}
+
+/**
+ * Convert a weight to a 16 bit precision.
+ * @param value The weight to convert.
+ * @param precision BFloat16 or Float16.
+ * @return The bits of the converted weight.
+ */
+std::uint16_t encodeWeight( float value, WeightPrecision precision ) {
+	return precision == WeightPrecision::BFloat16 ? floatToBFloat16( value ) : floatToHalf( value );
+}
+
+float decodeWeight( std::uint16_t value, WeightPrecision precision ) {
+	return precision == WeightPrecision::BFloat16 ? bfloat16ToFloat( value ) : halfToFloat( value );
+}
+
+/**
+ * Get the name of a precision as it is stored in network files.
+ * @param precision The precision to name.
+ * @return The name of the precision.
+ */
+std::string getPrecisionName( WeightPrecision precision ) {
+	switch( precision ) {
+		case WeightPrecision::BFloat16:
+			return std::string( "bfloat16" );
+
+		case WeightPrecision::Float16:
+			return std::string( "float16" );
+
+		case WeightPrecision::Int8:
+			return std::string( "int8" );
+
+		default:
+			return std::string( "float32" );
+	}
+}
+
+/**
+ * Parse the name of a precision from a network file.
+ * @param name The name of the precision.
+ * @return The named precision. Unknown names are treated as Float32.
+ */
+WeightPrecision parsePrecisionName( const std::string& name ) {
+	if( name == "bfloat16" ) {
+		return WeightPrecision::BFloat16;
+	}
+
+	if( name == "float16" ) {
+		return WeightPrecision::Float16;
+	}
+
+	if( name == "int8" ) {
+		return WeightPrecision::Int8;
+	}
+
+	return WeightPrecision::Float32;
+}
+
+/**
+ * A non-owning view of a row-major matrix of 16 bit weights, in the layout of the Matrix it was taken from.
+ */
+class HalfMatrixView {
+	private:
+		const std::uint16_t* m_values;
+		unsigned int m_height;
+		unsigned int m_width;
+		unsigned int m_stride;
+		WeightPrecision m_precision;
+
+	public:
+		HalfMatrixView( const std::uint16_t* values, unsigned int height, unsigned int width, unsigned int stride, WeightPrecision precision ) : m_values( values ), m_height( height ), m_width( width ), m_stride( stride ), m_precision( precision ) {
+		}
+
+		unsigned int getHeight() const {
+			return m_height;
+		}
+
+		unsigned int getWidth() const {
+			return m_width;
+		}
+
+		unsigned int getStride() const {
+			return m_stride;
+		}
+
+		WeightPrecision getPrecision() const {
+			return m_precision;
+		}
+
+		const std::uint16_t* data() const {
+			return m_values;
+		}
+};
+
+#endif // HALFPRECISION_HPP
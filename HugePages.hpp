@@ -0,0 +1,169 @@
+#ifndef HUGEPAGES_HPP
+#define HUGEPAGES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/**
+ * How the memory behind a buffer is paged.
+ */
+enum class PageKind {
+	// Ordinary heap memory in the system's base pages
+	Normal,
+	// An anonymous mapping advised to be backed by transparent huge pages
+	TransparentHuge,
+	// A mapping taken from the reserved hugetlbfs pool
+	ExplicitHuge
+};
+
+const std::size_t huge_page_size = std::size_t( 2 ) << 20;
+
+bool& getHugePageSetting() {
+	static bool enabled = false;
+	return enabled;
+}
+
+/**
+ * Set whether matrices allocated from now on ask for 2 MB pages. Buffers smaller than one huge page always use the heap.
+ * @param enabled Whether to use huge pages.
+ */
+void setHugePageMode( bool enabled ) {
+	getHugePageSetting() = enabled;
+}
+
+bool isHugePageMode() {
+	return getHugePageSetting();
+}
+
+std::string getPageKindName( PageKind kind ) {
+	switch( kind ) {
+		case PageKind::TransparentHuge:
+			return std::string( "transparent huge" );
+
+		case PageKind::ExplicitHuge:
+			return std::string( "hugetlbfs" );
+
+		default:
+			return std::string( "normal" );
+	}
+}
+
+/**
+ * Check whether the kernel will back advised mappings with transparent huge pages.
+ * @return False when transparent huge pages are unavailable or set to never.
+ */
+bool transparentHugePagesAvailable() {
+	static const bool available = []() {
+		std::ifstream setting( "/sys/kernel/mm/transparent_hugepage/enabled" );
+		std::string mode;
+		return setting && std::getline( setting, mode ) && mode.find( "[never]" ) == std::string::npos;
+	}();
+
+	return available;
+}
+
+/**
+ * Map memory backed by 2 MB pages, preferring the reserved hugetlbfs pool and falling back to a 2 MB aligned mapping advised for transparent huge pages.
+ * @param bytes The number of bytes needed.
+ * @param mapped_bytes Set to the length of the mapping, for releaseHugePages.
+ * @param kind Set to how the mapping is backed.
+ * @return The start of the mapping, aligned to a huge page, or null if neither kind of huge page is available.
+ */
+void* allocateHugePages( std::size_t bytes, std::size_t& mapped_bytes, PageKind& kind ) {
+#ifdef __linux__
+	mapped_bytes = ( bytes + huge_page_size - 1 ) / huge_page_size * huge_page_size;
+
+#ifdef MAP_HUGETLB
+	void* explicit_pages = mmap( nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+	if( explicit_pages != MAP_FAILED ) {
+		kind = PageKind::ExplicitHuge;
+		return explicit_pages;
+	}
+#endif
+
+#ifdef MADV_HUGEPAGE
+	if( transparentHugePagesAvailable() ) {
+		// Over-map by one huge page so an aligned start can be cut out, then return the ends
+		const std::size_t padded_bytes = mapped_bytes + huge_page_size;
+		void* mapping = mmap( nullptr, padded_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+		if( mapping != MAP_FAILED ) {
+			const std::uintptr_t start = reinterpret_cast< std::uintptr_t >( mapping );
+			const std::uintptr_t aligned = ( start + huge_page_size - 1 ) & ~static_cast< std::uintptr_t >( huge_page_size - 1 );
+			const std::size_t head = aligned - start;
+			const std::size_t tail = padded_bytes - head - mapped_bytes;
+
+			if( head != 0 ) {
+				munmap( mapping, head );
+			}
+
+			if( tail != 0 ) {
+				munmap( reinterpret_cast< void* >( aligned + mapped_bytes ), tail );
+			}
+
+			madvise( reinterpret_cast< void* >( aligned ), mapped_bytes, MADV_HUGEPAGE );
+			kind = PageKind::TransparentHuge;
+			return reinterpret_cast< void* >( aligned );
+		}
+	}
+#endif
+#else
+	static_cast< void >( bytes );
+#endif
+
+	mapped_bytes = 0;
+	kind = PageKind::Normal;
+	return nullptr;
+}
+
+/**
+ * Unmap memory from allocateHugePages.
+ * @param values The start of the mapping.
+ * @param mapped_bytes The length of the mapping.
+ */
+void releaseHugePages( void* values, std::size_t mapped_bytes ) {
+#ifdef __linux__
+	if( values != nullptr ) {
+		munmap( values, mapped_bytes );
+	}
+#else
+	static_cast< void >( values );
+	static_cast< void >( mapped_bytes );
+#endif
+}
+
+/**
+ * Find how much of the mapping holding an address the kernel has actually backed with transparent huge pages, since advice can be refused.
+ * @param address An address inside the mapping.
+ * @return The number of bytes backed by transparent huge pages, or 0 if it cannot be determined.
+ */
+std::size_t getTransparentHugeBytes( const void* address ) {
+	std::ifstream smaps( "/proc/self/smaps" );
+	const std::uintptr_t target = reinterpret_cast< std::uintptr_t >( address );
+	bool in_mapping = false;
+	std::string line;
+
+	while( std::getline( smaps, line ) ) {
+		unsigned long long start = 0;
+		unsigned long long end = 0;
+		unsigned long long kilobytes = 0;
+
+		// Mapping headers start with the address range, the fields of the mapping follow
+		if( std::sscanf( line.c_str(), "%llx-%llx ", &start, &end ) == 2 && line.find( ':' ) > line.find( ' ' ) ) {
+			in_mapping = target >= start && target < end;
+		} else if( in_mapping && std::sscanf( line.c_str(), "AnonHugePages: %llu kB", &kilobytes ) == 1 ) {
+			return static_cast< std::size_t >( kilobytes ) * 1024;
+		}
+	}
+
+	return 0;
+}
+
+#endif // HUGEPAGES_HPP
@@ -1,9 +1,12 @@
 #ifndef LSTMLAYER_HPP
 #define LSTMLAYER_HPP
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
+#include "HalfKernels.hpp"
 #include "Matrix.hpp"
+#include "MatrixKernels.hpp"
 #include "NetworkLayer.hpp"
 #include "Vector.hpp"
 
@@ -29,125 +32,104 @@ class LSTMLayer : public NetworkLayer {
 		Vector m_train_state;
 		Vector m_train_output;
 
-		float activation( float input ) {
-			return 1.f / ( 1.f + std::exp( -input ) );
-		}
+		// Filled by computeGradients for the forget, learn, cell and output gates in turn, and sized on first use
+		Matrix m_weight_gradients[ 4 ];
+		Matrix m_state_weight_gradients[ 4 ];
+		Vector m_bias_gradients[ 4 ];
 
 		float activationOutputDerivative( float output ) {
 			return output * ( 1.f - output );
 		}
 
-		float activationDerivative( float input ) {
-			return activationOutputDerivative( activation( input ) );
-		}
-
-		float cellActivation( float input ) {
-			return std::tanh( input );
-		}
-
 		float cellActivationOutputDerivative( float output ) {
 			return 1.f - output * output;
 		}
 
-		float cellActivationDerivative( float input ) {
-			return cellActivationOutputDerivative( cellActivation( input ) );
+		void calculateForgetVector( ConstVectorView input, ConstVectorView previous_output, VectorView result ) {
+			gemv( m_forget_weights, input, m_forget_bias, result );
+			gemv( m_forget_state_weights, previous_output, result, result, ActivationFunction::Sigmoid, getActivationAccuracy() );
 		}
 
-		Vector calculateForgetVector( Vector input, Vector previous_output ) {
-			Vector result;
-			result.setDimension( getOutputCount() );
-
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				float accum = m_forget_bias( y );
-
-				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					accum += m_forget_weights( y, x ) * input( x );
-				}
-
-				for( unsigned int x = 0; x < getOutputCount(); ++x ) {
-					accum += m_forget_state_weights( y, x ) * previous_output( x );
-				}
-
-				result( y ) = activation( accum );
-			}
-
-			return result;
+		void calculateLearnVector( ConstVectorView input, ConstVectorView previous_output, VectorView result ) {
+			gemv( m_learn_weights, input, m_learn_bias, result );
+			gemv( m_learn_state_weights, previous_output, result, result, ActivationFunction::Sigmoid, getActivationAccuracy() );
 		}
 
-		Vector calculateLearnVector( Vector input, Vector previous_output ) {
-			Vector result;
-			result.setDimension( getOutputCount() );
-
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				float accum = m_learn_bias( y );
-
-				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					accum += m_learn_weights( y, x ) * input( x );
-				}
-
-				for( unsigned int x = 0; x < getOutputCount(); ++x ) {
-					accum += m_learn_state_weights( y, x ) * previous_output( x );
-				}
-
-				result( y ) = activation( accum );
-			}
-
-			return result;
+		void calculateInformationVector( ConstVectorView input, ConstVectorView previous_output, VectorView result ) {
+			gemv( m_cell_weights, input, m_cell_bias, result );
+			gemv( m_cell_state_weights, previous_output, result, result, ActivationFunction::Tanh, getActivationAccuracy() );
 		}
 
-		Vector calculateInformationVector( Vector input, Vector previous_output ) {
-			Vector result;
-			result.setDimension( getOutputCount() );
+		void updateCellState( ConstVectorView input ) {
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
 
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				float accum = m_cell_bias( y );
-
-				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					accum += m_cell_weights( y, x ) * input( x );
-				}
-
-				for( unsigned int x = 0; x < getOutputCount(); ++x ) {
-					accum += m_cell_state_weights( y, x ) * previous_output( x );
-				}
-
-				result( y ) = cellActivation( accum );
-			}
-
-			return result;
-		}
-
-		void updateCellState( Vector input ) {
-			Vector forget_vector = calculateForgetVector( input, m_previous_output );
-			Vector learn_vector = calculateLearnVector( input, m_previous_output );
-			Vector information_vector = calculateInformationVector( input, m_previous_output );
+			VectorView forget_vector = arena.allocateVector( getOutputCount() );
+			VectorView learn_vector = arena.allocateVector( getOutputCount() );
+			VectorView information_vector = arena.allocateVector( getOutputCount() );
+			calculateForgetVector( input, m_previous_output, forget_vector );
+			calculateLearnVector( input, m_previous_output, learn_vector );
+			calculateInformationVector( input, m_previous_output, information_vector );
 
 			m_train_state = m_cell_state;
-
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-
-				m_cell_state( y ) = forget_vector( y ) * m_train_state( y ) + learn_vector( y ) * information_vector( y );
-			}
+			m_cell_state = forget_vector * m_train_state + learn_vector * information_vector;
 		}
 
-		Vector calculateOutputVector( Vector input, Vector previous_output ) {
-			Vector result;
-			result.setDimension( getOutputCount() );
+		void calculateOutputVector( ConstVectorView input, ConstVectorView previous_output, VectorView result ) {
+			gemv( m_output_weights, input, m_output_bias, result );
+			gemv( m_output_state_weights, previous_output, result, result, ActivationFunction::Sigmoid, getActivationAccuracy() );
+		}
 
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				result( y ) = m_output_bias( y );
+		/**
+		 * Calculate the delta of each gate for a sample, from the state saved when it was propagated. The output activation derivative is folded into each gate's delta rather than stored separately.
+		 * @param input The input the sample was propagated with. Must be contiguous.
+		 * @param output The output of the layer for the sample. Must be contiguous.
+		 * @param delta The error from the next layer.
+		 */
+		void calculateGateDeltas( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView forget_delta, VectorView learn_delta, VectorView cell_delta, VectorView output_delta ) {
+			auto gate_derivative = [ this ]( float value ) { return activationOutputDerivative( value ); };
+			auto cell_derivative = [ this ]( float value ) { return cellActivationOutputDerivative( value ); };
+
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
+
+			VectorView forget_vector = arena.allocateVector( getOutputCount() );
+			VectorView learn_vector = arena.allocateVector( getOutputCount() );
+			VectorView information_vector = arena.allocateVector( getOutputCount() );
+			VectorView output_vector = arena.allocateVector( getOutputCount() );
+			calculateForgetVector( input, m_train_output, forget_vector );
+			calculateLearnVector( input, m_train_output, learn_vector );
+			calculateInformationVector( input, m_train_output, information_vector );
+			calculateOutputVector( input, m_train_output, output_vector );
+
+			auto scaled_delta = delta * apply( output, cell_derivative );
+
+			forget_delta.assign( scaled_delta * ( output_vector * m_train_state * apply( forget_vector, gate_derivative ) ) );
+			learn_delta.assign( scaled_delta * ( output_vector * information_vector * apply( learn_vector, gate_derivative ) ) );
+			cell_delta.assign( scaled_delta * ( output_vector * learn_vector * apply( information_vector, cell_derivative ) ) );
+			output_delta.assign( scaled_delta * ( m_cell_state * apply( output_vector, gate_derivative ) ) );
+		}
 
-				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					result( y ) += m_output_weights( y, x ) * input( x );
+		/**
+		 * Size the gradient buffers to the layer, zeroing them if they did not fit.
+		 */
+		void allocateGradients() {
+			for( unsigned int gate = 0; gate < 4; ++gate ) {
+				if( m_weight_gradients[ gate ].getHeight() != getOutputCount() || m_weight_gradients[ gate ].getWidth() != getInputCount() ) {
+					m_weight_gradients[ gate ].setSize( getOutputCount(), getInputCount() );
+					std::fill( m_weight_gradients[ gate ].data(), m_weight_gradients[ gate ].data() + static_cast< std::size_t >( m_weight_gradients[ gate ].getStride() ) * getOutputCount(), 0.f );
 				}
 
-				for( unsigned int x = 0; x < getOutputCount(); ++x ) {
-					result( y ) += m_output_state_weights( y, x ) * previous_output( x );
+				if( m_state_weight_gradients[ gate ].getHeight() != getOutputCount() || m_state_weight_gradients[ gate ].getWidth() != getOutputCount() ) {
+					m_state_weight_gradients[ gate ].setSize( getOutputCount(), getOutputCount() );
+					std::fill( m_state_weight_gradients[ gate ].data(), m_state_weight_gradients[ gate ].data() + static_cast< std::size_t >( m_state_weight_gradients[ gate ].getStride() ) * getOutputCount(), 0.f );
 				}
 
-				result( y ) = activation( result( y ) );
+				if( m_bias_gradients[ gate ].getDimension() != getOutputCount() ) {
+					m_bias_gradients[ gate ].setDimension( getOutputCount() );
+					std::fill( m_bias_gradients[ gate ].data(), m_bias_gradients[ gate ].data() + getOutputCount(), 0.f );
+				}
 			}
-
-			return result;
 		}
 
 	protected:
@@ -201,6 +183,8 @@ class LSTMLayer : public NetworkLayer {
 				m_cell_bias( y ) = distribution( generator );
 				m_output_bias( y ) = distribution( generator );
 			}
+
+			updateReducedCopies();
 		}
 
 		virtual void loadFromJSONInternal( Json::Value& data_value ) {
@@ -275,10 +259,10 @@ class LSTMLayer : public NetworkLayer {
 
 			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
 				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					forget_weights[ y * getInputCount() + x ] = m_forget_weights( y, x );
-					learn_weights[ y * getInputCount() + x ] = m_learn_weights( y, x );
-					cell_weights[ y * getInputCount() + x ] = m_cell_weights( y, x );
-					output_weights[ y * getInputCount() + x ] = m_output_weights( y, x );
+					forget_weights[ y * getInputCount() + x ] = m_forget_weights.getStoredValue( y, x );
+					learn_weights[ y * getInputCount() + x ] = m_learn_weights.getStoredValue( y, x );
+					cell_weights[ y * getInputCount() + x ] = m_cell_weights.getStoredValue( y, x );
+					output_weights[ y * getInputCount() + x ] = m_output_weights.getStoredValue( y, x );
 				}
 
 				forget_bias[ y ] = m_forget_bias( y );
@@ -289,10 +273,10 @@ class LSTMLayer : public NetworkLayer {
 
 			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
 				for( unsigned int x = 0; x < getOutputCount(); ++x ) {
-					forget_state_weights[ y * getOutputCount() + x ] = m_forget_state_weights( y, x );
-					learn_state_weights[ y * getOutputCount() + x ] = m_learn_state_weights( y, x );
-					cell_state_weights[ y * getOutputCount() + x ] = m_cell_state_weights( y, x );
-					output_state_weights[ y * getOutputCount() + x ] = m_output_state_weights( y, x );
+					forget_state_weights[ y * getOutputCount() + x ] = m_forget_state_weights.getStoredValue( y, x );
+					learn_state_weights[ y * getOutputCount() + x ] = m_learn_state_weights.getStoredValue( y, x );
+					cell_state_weights[ y * getOutputCount() + x ] = m_cell_state_weights.getStoredValue( y, x );
+					output_state_weights[ y * getOutputCount() + x ] = m_output_state_weights.getStoredValue( y, x );
 				}
 			}
 
@@ -318,29 +302,165 @@ class LSTMLayer : public NetworkLayer {
 			return std::string( "lstm" );
 		}
 
+		virtual void computeGradientsInternal( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta ) {
+			allocateGradients();
+
+			Vector input_storage;
+			Vector output_storage;
+			input = makeContiguous( input, input_storage );
+			output = makeContiguous( output, output_storage );
+
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
+
+			VectorView gate_deltas[ 4 ];
+			for( unsigned int gate = 0; gate < 4; ++gate ) {
+				gate_deltas[ gate ] = arena.allocateVector( getOutputCount() );
+			}
+
+			calculateGateDeltas( input, output, delta, gate_deltas[ 0 ], gate_deltas[ 1 ], gate_deltas[ 2 ], gate_deltas[ 3 ] );
+
+			const Matrix* weights[ 4 ] = { &m_forget_weights, &m_learn_weights, &m_cell_weights, &m_output_weights };
+
+			for( unsigned int gate = 0; gate < 4; ++gate ) {
+				if( new_delta.data() ) {
+					gemvTransposed( *weights[ gate ], gate_deltas[ gate ], new_delta, gate > 0 );
+				}
+
+				// A step of rate -1 adds delta * transpose( input ) to the gradients
+				rankOneUpdate( m_weight_gradients[ gate ], gate_deltas[ gate ], input, -1.f );
+				rankOneUpdate( m_state_weight_gradients[ gate ], gate_deltas[ gate ], output, -1.f );
+
+				float* bias_gradients = m_bias_gradients[ gate ].data();
+				const float* delta_values = gate_deltas[ gate ].data();
+
+				for( unsigned int y = 0; y < getOutputCount(); ++y ) {
+					bias_gradients[ y ] += delta_values[ y ];
+				}
+			}
+		}
+
+		virtual void applyGradientsInternal( Optimizer& optimizer, float scale ) {
+			allocateGradients();
+
+			Matrix* weights[ 4 ] = { &m_forget_weights, &m_learn_weights, &m_cell_weights, &m_output_weights };
+			Matrix* state_weights[ 4 ] = { &m_forget_state_weights, &m_learn_state_weights, &m_cell_state_weights, &m_output_state_weights };
+			Vector* biases[ 4 ] = { &m_forget_bias, &m_learn_bias, &m_cell_bias, &m_output_bias };
+
+			std::size_t offset = getParameterOffset();
+
+			for( unsigned int gate = 0; gate < 4; ++gate ) {
+				const std::size_t count = static_cast< std::size_t >( weights[ gate ]->getStride() ) * getOutputCount();
+				optimizer.update( offset, weights[ gate ]->data(), m_weight_gradients[ gate ].data(), count, scale );
+				std::fill( m_weight_gradients[ gate ].data(), m_weight_gradients[ gate ].data() + count, 0.f );
+				offset += count;
+			}
+
+			for( unsigned int gate = 0; gate < 4; ++gate ) {
+				const std::size_t count = static_cast< std::size_t >( state_weights[ gate ]->getStride() ) * getOutputCount();
+				optimizer.update( offset, state_weights[ gate ]->data(), m_state_weight_gradients[ gate ].data(), count, scale );
+				std::fill( m_state_weight_gradients[ gate ].data(), m_state_weight_gradients[ gate ].data() + count, 0.f );
+				offset += count;
+			}
+
+			for( unsigned int gate = 0; gate < 4; ++gate ) {
+				optimizer.update( offset, biases[ gate ]->data(), m_bias_gradients[ gate ].data(), getOutputCount(), scale );
+				std::fill( m_bias_gradients[ gate ].data(), m_bias_gradients[ gate ].data() + getOutputCount(), 0.f );
+				offset += alignParameterCount( getOutputCount() );
+			}
+
+			updateReducedCopies();
+		}
+
 	public:
-		virtual Vector propagate( Vector input ) {
+		virtual WeightPrecision getWeightPrecision() const {
+			return m_forget_weights.getPrecision();
+		}
+
+		virtual void setWeightPrecision( WeightPrecision precision ) {
+			m_forget_weights.setPrecision( precision );
+			m_learn_weights.setPrecision( precision );
+			m_cell_weights.setPrecision( precision );
+			m_output_weights.setPrecision( precision );
+			m_forget_state_weights.setPrecision( precision );
+			m_learn_state_weights.setPrecision( precision );
+			m_cell_state_weights.setPrecision( precision );
+			m_output_state_weights.setPrecision( precision );
+		}
+
+		using NetworkLayer::propagate;
+		using NetworkLayer::train;
+
+		virtual std::size_t getParameterCount() const {
+			return 4 * ( ( static_cast< std::size_t >( m_forget_weights.getStride() ) + m_forget_state_weights.getStride() ) * getOutputCount() + alignParameterCount( getOutputCount() ) );
+		}
+
+		virtual void updateReducedCopies() {
+			m_forget_weights.updateReducedCopy();
+			m_learn_weights.updateReducedCopy();
+			m_cell_weights.updateReducedCopy();
+			m_output_weights.updateReducedCopy();
+			m_forget_state_weights.updateReducedCopy();
+			m_learn_state_weights.updateReducedCopy();
+			m_cell_state_weights.updateReducedCopy();
+			m_output_state_weights.updateReducedCopy();
+		}
+
+		virtual void bindParameters( float* parameters, float* gradients ) {
+			Matrix* weights[ 8 ] = { &m_forget_weights, &m_learn_weights, &m_cell_weights, &m_output_weights, &m_forget_state_weights, &m_learn_state_weights, &m_cell_state_weights, &m_output_state_weights };
+			Vector* biases[ 4 ] = { &m_forget_bias, &m_learn_bias, &m_cell_bias, &m_output_bias };
+
+			if( gradients ) {
+				allocateGradients();
+			}
+
+			std::size_t offset = 0;
+
+			for( unsigned int i = 0; i < 8; ++i ) {
+				Matrix& weight_gradients = i < 4 ? m_weight_gradients[ i ] : m_state_weight_gradients[ i - 4 ];
+				weights[ i ]->bindValues( parameters ? parameters + offset : nullptr );
+				weight_gradients.bindValues( gradients ? gradients + offset : nullptr );
+				offset += static_cast< std::size_t >( weights[ i ]->getStride() ) * getOutputCount();
+			}
+
+			for( unsigned int gate = 0; gate < 4; ++gate ) {
+				biases[ gate ]->bindValues( parameters ? parameters + offset : nullptr );
+				m_bias_gradients[ gate ].bindValues( gradients ? gradients + offset : nullptr );
+				offset += alignParameterCount( getOutputCount() );
+			}
+		}
+
+		virtual bool isStateful() const {
+			return true;
+		}
+
+		virtual void propagate( ConstVectorView input, VectorView output ) {
 			if( input.getDimension() != getInputCount() ) {
 				throw std::string( "Invalid input size to layer propagation" );
 			}
 
-			Vector output_vector = calculateOutputVector( input, m_previous_output );
-			updateCellState( input );
+			if( output.getDimension() != getOutputCount() ) {
+				throw std::string( "Invalid output size to layer propagation" );
+			}
 
-			Vector output;
-			output.setDimension( getOutputCount() );
+			Vector input_storage;
+			input = makeContiguous( input, input_storage );
 
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				output( y ) = cellActivation( output_vector( y ) * m_cell_state( y ) );
-			}
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
+
+			VectorView output_vector = arena.allocateVector( getOutputCount() );
+			calculateOutputVector( input, m_previous_output, output_vector );
+			updateCellState( input );
+
+			output.assign( output_vector * m_cell_state );
+			applyActivation( ActivationFunction::Tanh, getActivationAccuracy(), output, output );
 
 			m_train_output = m_previous_output;
 			m_previous_output = output;
-
-			return output;
 		}
 
-		virtual Vector train( Vector input, Vector output, Vector delta, float mutability = 0.05f ) {
+		virtual void train( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta, float mutability = 0.05f ) {
 			if( input.getDimension() != getInputCount() ) {
 				throw std::string( "Invalid input size to layer training" );
 			}
@@ -353,63 +473,52 @@ class LSTMLayer : public NetworkLayer {
 				throw std::string( "Invalid output size to layer training" );
 			}
 
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				delta( y ) *= cellActivationOutputDerivative( output( y ) );
+			if( new_delta.data() && new_delta.getDimension() != getInputCount() ) {
+				throw std::string( "Invalid new delta size to layer training" );
 			}
 
-			Vector forget_vector = calculateForgetVector( input, m_train_output );
-			Vector learn_vector = calculateLearnVector( input, m_train_output );
-			Vector information_vector = calculateInformationVector( input, m_train_output );
-			Vector output_vector = calculateOutputVector( input, m_train_output );
+			Vector input_storage;
+			Vector output_storage;
+			input = makeContiguous( input, input_storage );
+			output = makeContiguous( output, output_storage );
 
-			Vector forget_delta = delta;
-			Vector learn_delta = delta;
-			Vector cell_delta = delta;
-			Vector output_delta = delta;
-
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				forget_delta( y ) *= output_vector( y ) * m_train_state( y ) * activationOutputDerivative( forget_vector( y ) );
-				learn_delta( y ) *= output_vector( y ) * information_vector( y ) * activationOutputDerivative( learn_vector( y ) );
-				cell_delta( y ) *= output_vector( y ) * learn_vector( y ) * cellActivationOutputDerivative( information_vector( y ) );
-				output_delta( y ) *= m_cell_state( y ) * activationOutputDerivative( output_vector( y ) );
-			}
+			Arena& arena = getArena();
+			ArenaScope scope( arena );
 
-			Vector new_delta;
-			new_delta.setDimension( getInputCount() );
+			VectorView forget_delta = arena.allocateVector( getOutputCount() );
+			VectorView learn_delta = arena.allocateVector( getOutputCount() );
+			VectorView cell_delta = arena.allocateVector( getOutputCount() );
+			VectorView output_delta = arena.allocateVector( getOutputCount() );
+			calculateGateDeltas( input, output, delta, forget_delta, learn_delta, cell_delta, output_delta );
 
-			for( unsigned int x = 0; x < getInputCount(); ++x ) {
+			// Each gate's weights are read once, propagating its delta and taking the step in the same pass
+			for( unsigned int x = 0; x < new_delta.getDimension(); ++x ) {
 				new_delta( x ) = 0.f;
-
-				for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-					new_delta( x ) += forget_delta( y ) * m_forget_weights( y, x );
-					new_delta( x ) += learn_delta( y ) * m_learn_weights( y, x );
-					new_delta( x ) += cell_delta( y ) * m_cell_weights( y, x );
-					new_delta( x ) += output_delta( y ) * m_output_weights( y, x );
-				}
 			}
 
-			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
-				m_forget_bias( y ) -= mutability * forget_delta( y );
-				m_learn_bias( y ) -= mutability * learn_delta( y );
-				m_cell_bias( y ) -= mutability * cell_delta( y );
-				m_output_bias( y ) -= mutability * output_delta( y );
+			backwardUpdate( m_forget_weights, forget_delta, input, mutability, new_delta );
+			backwardUpdate( m_learn_weights, learn_delta, input, mutability, new_delta );
+			backwardUpdate( m_cell_weights, cell_delta, input, mutability, new_delta );
+			backwardUpdate( m_output_weights, output_delta, input, mutability, new_delta );
 
-				for( unsigned int x = 0; x < getInputCount(); ++x ) {
-					m_forget_weights( y, x ) -= mutability * forget_delta( y ) * input( x );
-					m_learn_weights( y, x ) -= mutability * learn_delta( y ) * input( x );
-					m_cell_weights( y, x ) -= mutability * cell_delta( y ) * input( x );
-					m_output_weights( y, x ) -= mutability * output_delta( y ) * input( x );
-				}
+			rankOneUpdate( m_forget_state_weights, forget_delta, output, mutability );
+			rankOneUpdate( m_learn_state_weights, learn_delta, output, mutability );
+			rankOneUpdate( m_cell_state_weights, cell_delta, output, mutability );
+			rankOneUpdate( m_output_state_weights, output_delta, output, mutability );
 
-				for( unsigned int x = 0; x < getOutputCount(); ++x ) {
-					m_forget_state_weights( y, x ) -= mutability * forget_delta( y ) * output( x );
-					m_learn_state_weights( y, x ) -= mutability * learn_delta( y ) * output( x );
-					m_cell_state_weights( y, x ) -= mutability * cell_delta( y ) * output( x );
-					m_output_state_weights( y, x ) -= mutability * output_delta( y ) * output( x );
-				}
+			const float* forget_delta_values = forget_delta.data();
+			const float* learn_delta_values = learn_delta.data();
+			const float* cell_delta_values = cell_delta.data();
+			const float* output_delta_values = output_delta.data();
+
+			for( unsigned int y = 0; y < getOutputCount(); ++y ) {
+				m_forget_bias( y ) -= mutability * forget_delta_values[ y ];
+				m_learn_bias( y ) -= mutability * learn_delta_values[ y ];
+				m_cell_bias( y ) -= mutability * cell_delta_values[ y ];
+				m_output_bias( y ) -= mutability * output_delta_values[ y ];
 			}
 
-			return new_delta;
+			updateReducedCopies();
 		}
 
 		virtual void resetState() {
@@ -1,15 +1,31 @@
 #ifndef MATRIX_HPP
 #define MATRIX_HPP
 
-#include <vector>
+#include <cstdint>
+#include <string>
+#include "AlignedBuffer.hpp"
+#include "HalfPrecision.hpp"
+#include "MatrixKernels.hpp"
+#include "MatrixView.hpp"
+#include "QuantizedMatrix.hpp"
 
 class Matrix {
 	private:
 		unsigned int m_width;
 		unsigned int m_height;
-		std::vector< float > m_values;
+		unsigned int m_stride;
+		unsigned int m_row_alignment;
+		AlignedBuffer< float > m_values;
+
+		// Single precision values stay the master copy for training; propagation reads the reduced copy when there is one
+		WeightPrecision m_precision;
+		AlignedBuffer< std::uint16_t > m_reduced_values;
+		QuantizedMatrix m_quantized_values;
 
 	public:
+		Matrix() : m_width( 0 ), m_height( 0 ), m_stride( 0 ), m_row_alignment( 16 ), m_precision( WeightPrecision::Float32 ) {
+		}
+
 		/**
 		 * Get the width of the matrix.
 		 * @return The width of the matrix.
@@ -27,14 +43,163 @@ class Matrix {
 		}
 
 		/**
-		 * Set the size of the matrix. Matrix contents are undefined afterwards.
+		 * Get the distance between the starts of consecutive rows of the matrix.
+		 * @return The row stride of the matrix, in elements.
+		 */
+		unsigned int getStride() const {
+			return m_stride;
+		}
+
+		/**
+		 * Get the number of elements each row's stride is rounded up to.
+		 * @return The row alignment of the matrix, in elements.
+		 */
+		unsigned int getRowAlignment() const {
+			return m_row_alignment;
+		}
+
+		/**
+		 * Set the number of elements each row's stride is rounded up to. The default of 16 starts every row on a 64 byte boundary. Takes effect on the next resize.
+		 * @param elements The row alignment, in elements. 1 packs rows back to back.
+		 */
+		void setRowAlignment( unsigned int elements ) {
+			m_row_alignment = elements == 0 ? 1 : elements;
+		}
+
+		/**
+		 * Set the size of the matrix, padding each row out to the row alignment. Matrix contents are undefined afterwards.
 		 * @param height The height of the matrix.
 		 * @param width The width of the matrix.
 		 */
 		void setSize( unsigned int height, unsigned int width ) {
+			setSize( height, width, ( width + m_row_alignment - 1 ) / m_row_alignment * m_row_alignment );
+		}
+
+		/**
+		 * Set the size of the matrix with an explicit leading dimension. Matrix contents are undefined afterwards, except that the padding past the width of each row is zero.
+		 * @param height The height of the matrix.
+		 * @param width The width of the matrix.
+		 * @param stride The distance between the starts of consecutive rows. Values smaller than the width are raised to it.
+		 */
+		void setSize( unsigned int height, unsigned int width, unsigned int stride ) {
 			m_width = width;
 			m_height = height;
-			m_values.resize( m_width * m_height );
+			m_stride = stride < width ? width : stride;
+			m_values.setHugePages( isHugePageMode() );
+			m_values.resize( static_cast< std::size_t >( m_stride ) * m_height );
+			firstTouchRows( m_values.data(), m_stride, m_height, m_width );
+
+			if( m_precision == WeightPrecision::Int8 ) {
+				updateReducedCopy();
+			} else if( m_precision != WeightPrecision::Float32 ) {
+				m_reduced_values.setHugePages( isHugePageMode() );
+				m_reduced_values.resize( m_values.size() );
+				firstTouchRows( m_reduced_values.data(), m_stride, m_height, m_width );
+			}
+		}
+
+		/**
+		 * Move the single precision values into external memory, such as a network's flat parameter buffer, and use that from now on. Reduced precision copies stay with the matrix. Resizing to a different size gives the matrix memory of its own again.
+		 * @param values The memory to use, holding getHeight() * getStride() floats and aligned to 64 bytes. Must outlive its use by the matrix. Null moves the values back into memory of its own.
+		 */
+		void bindValues( float* values ) {
+			m_values.bind( values );
+		}
+
+		WeightPrecision getPrecision() const {
+			return m_precision;
+		}
+
+		/**
+		 * Set the precision propagation reads the matrix in. Reduced precisions keep a 16 or 8 bit copy of the values alongside the single precision ones, filled from them now.
+		 * @param precision The precision to use.
+		 */
+		void setPrecision( WeightPrecision precision ) {
+			m_precision = precision;
+
+			if( precision != WeightPrecision::BFloat16 && precision != WeightPrecision::Float16 ) {
+				m_reduced_values = AlignedBuffer< std::uint16_t >();
+			}
+
+			if( precision != WeightPrecision::Int8 ) {
+				m_quantized_values = QuantizedMatrix();
+			}
+
+			if( precision == WeightPrecision::BFloat16 || precision == WeightPrecision::Float16 ) {
+				m_reduced_values.setHugePages( isHugePageMode() );
+				m_reduced_values.resize( m_values.size() );
+				firstTouchRows( m_reduced_values.data(), m_stride, m_height, m_width );
+			}
+
+			updateReducedCopy();
+		}
+
+		/**
+		 * Refill the reduced precision copy from the single precision values. Must be called after the values are changed for propagation to see the change. Does nothing at Float32.
+		 */
+		void updateReducedCopy() {
+			if( m_precision == WeightPrecision::Float32 ) {
+				return;
+			}
+
+			if( m_precision == WeightPrecision::Int8 ) {
+				m_quantized_values.quantize( m_values.data(), m_stride, m_height, m_width );
+				return;
+			}
+
+			// Padding is converted too, so the copy's padding is zero like the master's
+			const float* values = m_values.data();
+			std::uint16_t* reduced = m_reduced_values.data();
+			for( std::size_t i = 0; i < m_values.size(); ++i ) {
+				reduced[ i ] = encodeWeight( values[ i ], m_precision );
+			}
+		}
+
+		/**
+		 * Get a component of the matrix as propagation sees it, rounded to the matrix's precision. This is what gets saved, so reduced precision weights load back exactly.
+		 * @param y The y index of the desired component.
+		 * @param x The x index of the desired component.
+		 * @return The component in the matrix's precision.
+		 */
+		float getStoredValue( unsigned int y, unsigned int x ) const {
+			if( m_precision == WeightPrecision::Float32 ) {
+				return ( *this )( y, x );
+			}
+
+#ifdef NN_BOUNDS_CHECK
+			if( y >= m_height || x >= m_width ) {
+				throw std::string( "Matrix access out of bounds" );
+			}
+#endif
+			if( m_precision == WeightPrecision::Int8 ) {
+				return m_quantized_values.getValue( y, x );
+			}
+
+			return decodeWeight( m_reduced_values[ static_cast< std::size_t >( y ) * m_stride + x ], m_precision );
+		}
+
+		/**
+		 * Get how the single precision values are paged.
+		 * @return The kind of pages backing the values.
+		 */
+		PageKind getPageKind() const {
+			return m_values.getPageKind();
+		}
+
+		/**
+		 * Get a view of the reduced precision copy. Only valid when the precision is BFloat16 or Float16.
+		 * @return The view, laid out with the same stride as the matrix.
+		 */
+		HalfMatrixView getReducedView() const {
+			return HalfMatrixView( m_reduced_values.data(), m_height, m_width, m_stride, m_precision );
+		}
+
+		/**
+		 * Get the quantized copy. Only filled when the precision is Int8.
+		 * @return The quantized matrix.
+		 */
+		const QuantizedMatrix& getQuantized() const {
+			return m_quantized_values;
 		}
 
 		/**
@@ -60,12 +225,65 @@ class Matrix {
 		 * @return The component of the matrix being accessed.
 		 */
 		float& operator()( unsigned int y, unsigned int x ) {
-			return m_values[ ( y % m_height ) * m_width + ( x % m_width ) ];
+#ifdef NN_BOUNDS_CHECK
+			if( y >= m_height || x >= m_width ) {
+				throw std::string( "Matrix access out of bounds" );
+			}
+#endif
+			return m_values[ static_cast< std::size_t >( y ) * m_stride + x ];
+		}
+
+		float operator()( unsigned int y, unsigned int x ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( y >= m_height || x >= m_width ) {
+				throw std::string( "Matrix access out of bounds" );
+			}
+#endif
+			return m_values[ static_cast< std::size_t >( y ) * m_stride + x ];
+		}
+
+		/**
+		 * Get a pointer to the start of a row of the matrix, for use in inner loops.
+		 * @param y The index of the row.
+		 * @return A pointer to the first component of the row. The row holds getWidth() components.
+		 */
+		float* row( unsigned int y ) {
+#ifdef NN_BOUNDS_CHECK
+			if( y >= m_height ) {
+				throw std::string( "Matrix row out of bounds" );
+			}
+#endif
+			return m_values.data() + static_cast< std::size_t >( y ) * m_stride;
+		}
+
+		const float* row( unsigned int y ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( y >= m_height ) {
+				throw std::string( "Matrix row out of bounds" );
+			}
+#endif
+			return m_values.data() + static_cast< std::size_t >( y ) * m_stride;
 		}
 
+		/**
+		 * Get the underlying storage of the matrix. Row y starts at element y * getStride().
+		 * @return A pointer to the first component of the matrix, aligned to 64 bytes.
+		 */
 		float* data() {
 			return m_values.data();
 		}
+
+		const float* data() const {
+			return m_values.data();
+		}
+
+		operator MatrixView() {
+			return MatrixView( data(), m_height, m_width, m_stride );
+		}
+
+		operator ConstMatrixView() const {
+			return ConstMatrixView( data(), m_height, m_width, m_stride );
+		}
 };
 
 #endif // MATRIX_HPP
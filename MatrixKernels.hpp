@@ -0,0 +1,1051 @@
+#ifndef MATRIXKERNELS_HPP
+#define MATRIXKERNELS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include "ActivationKernels.hpp"
+#include "AlignedBuffer.hpp"
+#include "CPUFeatures.hpp"
+#include "MatrixView.hpp"
+#include "NumaTopology.hpp"
+#include "VectorView.hpp"
+
+#if NN_X86
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Reference matrix-vector product, output = activation( weights * input + bias ). Used as the fallback when no vector instruction set is available. Every GEMV kernel finishes each output in registers with its epilogue, the bias add and the activation, and stores it once.
+ * @param weights The row-major weight matrix.
+ * @param stride The distance in floats between the starts of consecutive rows.
+ * @param height The number of rows in the matrix.
+ * @param width The number of columns in the matrix.
+ * @param input The vector to multiply by, of length width.
+ * @param bias The vector to add to the product, of length height. May be null.
+ * @param output The vector to write the result into, of length height.
+ */
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+void gemvScalar( const float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, const float* bias, float* output ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		const float* row = weights + static_cast< std::size_t >( y ) * stride;
+		float accum = bias ? bias[ y ] : 0.f;
+
+		for( unsigned int x = 0; x < width; ++x ) {
+			accum += row[ x ] * input[ x ];
+		}
+
+		output[ y ] = activate( Function, Accuracy, accum );
+	}
+}
+
+/**
+ * Reference transposed matrix-vector product, accumulating output += transpose( weights ) * input. Rows are streamed in order, each one scaled by its input element and added to the output, so the weights are read exactly as they are stored.
+ * @param weights The row-major weight matrix.
+ * @param stride The distance in floats between the starts of consecutive rows.
+ * @param height The number of rows in the matrix.
+ * @param width The number of columns in the matrix.
+ * @param input The vector to multiply by, of length height.
+ * @param output The vector to add the result to, of length width.
+ */
+void gemvTransposedScalar( const float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, float* output ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		const float* row = weights + static_cast< std::size_t >( y ) * stride;
+		const float scale = input[ y ];
+
+		for( unsigned int x = 0; x < width; ++x ) {
+			output[ x ] += scale * row[ x ];
+		}
+	}
+}
+
+/**
+ * Get the delta of a row scaled by the derivative of its activation. This is the prologue of every backward pass kernel, so the scaled deltas are never stored.
+ * @param delta The deltas at the activations' outputs.
+ * @param activation_output The outputs of the activations, or null if the deltas are already scaled.
+ * @param function The activation the outputs came from.
+ * @param y The row.
+ * @return The delta of the row at the weighted sum.
+ */
+float scaledRowDelta( const float* delta, const float* activation_output, ActivationFunction function, unsigned int y ) {
+	return activation_output ? delta[ y ] * activationDerivativeFromOutput( function, activation_output[ y ] ) : delta[ y ];
+}
+
+/**
+ * Reference fused backward pass. For every row, scales delta[ y ] by the activation's derivative, adds the scaled delta times the row to new_delta using the weights as they were, then applies the update row -= rate * scaled delta * input and the same step to the row's bias. Each weight is loaded and stored once.
+ * @param weights The row-major weight matrix to update.
+ * @param stride The distance in floats between the starts of consecutive rows.
+ * @param height The number of rows in the matrix.
+ * @param width The number of columns in the matrix.
+ * @param delta The delta of each row, of length height.
+ * @param activation_output The activation output of each row, of length height. May be null when the deltas are already scaled.
+ * @param function The activation the outputs came from.
+ * @param input The input the layer was trained on, of length width.
+ * @param rate The learning rate.
+ * @param bias The bias to update, of length height. May be null.
+ * @param new_delta The vector to add transpose( weights ) * delta to, of length width. May be null for only the update.
+ */
+void backwardUpdateScalar( float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* delta, const float* activation_output, ActivationFunction function, const float* input, float rate, float* bias, float* new_delta ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		float* row = weights + static_cast< std::size_t >( y ) * stride;
+		const float scale = scaledRowDelta( delta, activation_output, function, y );
+		const float step = rate * scale;
+
+		if( bias ) {
+			bias[ y ] -= step;
+		}
+
+		if( new_delta ) {
+			for( unsigned int x = 0; x < width; ++x ) {
+				new_delta[ x ] += scale * row[ x ];
+				row[ x ] -= step * input[ x ];
+			}
+		} else {
+			for( unsigned int x = 0; x < width; ++x ) {
+				row[ x ] -= step * input[ x ];
+			}
+		}
+	}
+}
+
+#if NN_X86
+__attribute__(( target( "sse2" ) ))
+float horizontalSumSSE2( __m128 value ) {
+	__m128 shuffled = _mm_shuffle_ps( value, value, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+	__m128 sums = _mm_add_ps( value, shuffled );
+	shuffled = _mm_movehl_ps( shuffled, sums );
+	sums = _mm_add_ss( sums, shuffled );
+	return _mm_cvtss_f32( sums );
+}
+
+/**
+ * Apply a GEMV epilogue to a single result. Goes through the vector path so every output is rounded alike.
+ */
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "sse2" ) ))
+float gemvEpilogueSSE2( float value ) {
+	return _mm_cvtss_f32( activateSSE2< Function, Accuracy >( _mm_set_ss( value ) ) );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "sse2" ) ))
+void gemvSSE2( const float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, const float* bias, float* output ) {
+	unsigned int vector_width = width & ~3u;
+
+	for( unsigned int y = 0; y < height; ++y ) {
+		const float* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m128 accum = _mm_setzero_ps();
+
+		for( unsigned int x = 0; x < vector_width; x += 4 ) {
+			accum = _mm_add_ps( accum, _mm_mul_ps( _mm_loadu_ps( row + x ), _mm_loadu_ps( input + x ) ) );
+		}
+
+		float result = horizontalSumSSE2( accum ) + ( bias ? bias[ y ] : 0.f );
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			result += row[ x ] * input[ x ];
+		}
+
+		output[ y ] = gemvEpilogueSSE2< Function, Accuracy >( result );
+	}
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+float horizontalSumAVX2( __m256 value ) {
+	__m128 sums = _mm_add_ps( _mm256_castps256_ps128( value ), _mm256_extractf128_ps( value, 1 ) );
+	sums = _mm_add_ps( sums, _mm_movehl_ps( sums, sums ) );
+	sums = _mm_add_ss( sums, _mm_movehdup_ps( sums ) );
+	return _mm_cvtss_f32( sums );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "avx2,fma" ) ))
+void gemvAVX2( const float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, const float* bias, float* output ) {
+	unsigned int vector_width = width & ~7u;
+
+	// Results are gathered eight rows at a time so the epilogue runs on a full register, and each output is stored once
+	for( unsigned int y = 0; y < height; y += 8 ) {
+		const unsigned int rows = std::min( 8u, height - y );
+		alignas( 32 ) float results[ 8 ] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+		unsigned int r = 0;
+
+		// Four rows at a time so each input load is shared between them
+		for( ; r + 4 <= rows; r += 4 ) {
+			const float* row0 = weights + static_cast< std::size_t >( y + r ) * stride;
+			const float* row1 = row0 + stride;
+			const float* row2 = row1 + stride;
+			const float* row3 = row2 + stride;
+			__m256 accum0 = _mm256_setzero_ps();
+			__m256 accum1 = _mm256_setzero_ps();
+			__m256 accum2 = _mm256_setzero_ps();
+			__m256 accum3 = _mm256_setzero_ps();
+
+			for( unsigned int x = 0; x < vector_width; x += 8 ) {
+				__m256 in = _mm256_loadu_ps( input + x );
+				accum0 = _mm256_fmadd_ps( _mm256_loadu_ps( row0 + x ), in, accum0 );
+				accum1 = _mm256_fmadd_ps( _mm256_loadu_ps( row1 + x ), in, accum1 );
+				accum2 = _mm256_fmadd_ps( _mm256_loadu_ps( row2 + x ), in, accum2 );
+				accum3 = _mm256_fmadd_ps( _mm256_loadu_ps( row3 + x ), in, accum3 );
+			}
+
+			float result0 = horizontalSumAVX2( accum0 );
+			float result1 = horizontalSumAVX2( accum1 );
+			float result2 = horizontalSumAVX2( accum2 );
+			float result3 = horizontalSumAVX2( accum3 );
+
+			for( unsigned int x = vector_width; x < width; ++x ) {
+				result0 += row0[ x ] * input[ x ];
+				result1 += row1[ x ] * input[ x ];
+				result2 += row2[ x ] * input[ x ];
+				result3 += row3[ x ] * input[ x ];
+			}
+
+			results[ r ] = result0;
+			results[ r + 1 ] = result1;
+			results[ r + 2 ] = result2;
+			results[ r + 3 ] = result3;
+		}
+
+		for( ; r < rows; ++r ) {
+			const float* row = weights + static_cast< std::size_t >( y + r ) * stride;
+			__m256 accum = _mm256_setzero_ps();
+
+			for( unsigned int x = 0; x < vector_width; x += 8 ) {
+				accum = _mm256_fmadd_ps( _mm256_loadu_ps( row + x ), _mm256_loadu_ps( input + x ), accum );
+			}
+
+			float result = horizontalSumAVX2( accum );
+
+			for( unsigned int x = vector_width; x < width; ++x ) {
+				result += row[ x ] * input[ x ];
+			}
+
+			results[ r ] = result;
+		}
+
+		if( rows == 8 ) {
+			__m256 sums = _mm256_load_ps( results );
+			if( bias ) {
+				sums = _mm256_add_ps( sums, _mm256_loadu_ps( bias + y ) );
+			}
+
+			_mm256_storeu_ps( output + y, activateAVX2< Function, Accuracy >( sums ) );
+		} else {
+			for( unsigned int i = 0; i < rows; ++i ) {
+				results[ i ] += bias ? bias[ y + i ] : 0.f;
+			}
+
+			_mm256_store_ps( results, activateAVX2< Function, Accuracy >( _mm256_load_ps( results ) ) );
+			std::copy( results, results + rows, output + y );
+		}
+	}
+}
+
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+float horizontalSumAVX512( __m512 value ) {
+	alignas( 64 ) float lanes[ 16 ];
+	_mm512_store_ps( lanes, value );
+	return horizontalSumAVX2( _mm256_add_ps( _mm256_load_ps( lanes ), _mm256_load_ps( lanes + 8 ) ) );
+}
+
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void gemvAVX512( const float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, const float* bias, float* output ) {
+	unsigned int vector_width = width & ~15u;
+
+	// Masked tail so odd widths stay in vector registers
+	const __mmask16 tail_mask = static_cast< __mmask16 >( ( 1u << ( width - vector_width ) ) - 1u );
+
+	// Results are gathered sixteen rows at a time so the epilogue runs on a full register, and each output is stored once
+	for( unsigned int y = 0; y < height; y += 16 ) {
+		const unsigned int rows = std::min( 16u, height - y );
+		alignas( 64 ) float results[ 16 ];
+		unsigned int r = 0;
+
+		for( ; r + 4 <= rows; r += 4 ) {
+			const float* row0 = weights + static_cast< std::size_t >( y + r ) * stride;
+			const float* row1 = row0 + stride;
+			const float* row2 = row1 + stride;
+			const float* row3 = row2 + stride;
+			__m512 accum0 = _mm512_setzero_ps();
+			__m512 accum1 = _mm512_setzero_ps();
+			__m512 accum2 = _mm512_setzero_ps();
+			__m512 accum3 = _mm512_setzero_ps();
+
+			for( unsigned int x = 0; x < vector_width; x += 16 ) {
+				__m512 in = _mm512_loadu_ps( input + x );
+				accum0 = _mm512_fmadd_ps( _mm512_loadu_ps( row0 + x ), in, accum0 );
+				accum1 = _mm512_fmadd_ps( _mm512_loadu_ps( row1 + x ), in, accum1 );
+				accum2 = _mm512_fmadd_ps( _mm512_loadu_ps( row2 + x ), in, accum2 );
+				accum3 = _mm512_fmadd_ps( _mm512_loadu_ps( row3 + x ), in, accum3 );
+			}
+
+			if( vector_width < width ) {
+				__m512 in = _mm512_maskz_loadu_ps( tail_mask, input + vector_width );
+				accum0 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row0 + vector_width ), in, accum0 );
+				accum1 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row1 + vector_width ), in, accum1 );
+				accum2 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row2 + vector_width ), in, accum2 );
+				accum3 = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row3 + vector_width ), in, accum3 );
+			}
+
+			results[ r ] = horizontalSumAVX512( accum0 );
+			results[ r + 1 ] = horizontalSumAVX512( accum1 );
+			results[ r + 2 ] = horizontalSumAVX512( accum2 );
+			results[ r + 3 ] = horizontalSumAVX512( accum3 );
+		}
+
+		for( ; r < rows; ++r ) {
+			const float* row = weights + static_cast< std::size_t >( y + r ) * stride;
+			__m512 accum = _mm512_setzero_ps();
+
+			for( unsigned int x = 0; x < vector_width; x += 16 ) {
+				accum = _mm512_fmadd_ps( _mm512_loadu_ps( row + x ), _mm512_loadu_ps( input + x ), accum );
+			}
+
+			if( vector_width < width ) {
+				accum = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row + vector_width ), _mm512_maskz_loadu_ps( tail_mask, input + vector_width ), accum );
+			}
+
+			results[ r ] = horizontalSumAVX512( accum );
+		}
+
+		const __mmask16 row_mask = static_cast< __mmask16 >( ( 1u << rows ) - 1u );
+		__m512 sums = _mm512_maskz_load_ps( row_mask, results );
+		if( bias ) {
+			sums = _mm512_add_ps( sums, _mm512_maskz_loadu_ps( row_mask, bias + y ) );
+		}
+
+		_mm512_mask_storeu_ps( output + y, row_mask, activateAVX512< Function, Accuracy >( sums ) );
+	}
+}
+
+__attribute__(( target( "sse2" ) ))
+void gemvTransposedSSE2( const float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, float* output ) {
+	unsigned int vector_width = width & ~3u;
+
+	for( unsigned int y = 0; y < height; ++y ) {
+		const float* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m128 scale = _mm_set1_ps( input[ y ] );
+
+		for( unsigned int x = 0; x < vector_width; x += 4 ) {
+			_mm_storeu_ps( output + x, _mm_add_ps( _mm_loadu_ps( output + x ), _mm_mul_ps( scale, _mm_loadu_ps( row + x ) ) ) );
+		}
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			output[ x ] += input[ y ] * row[ x ];
+		}
+	}
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+void gemvTransposedAVX2( const float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, float* output ) {
+	unsigned int vector_width = width & ~7u;
+	unsigned int y = 0;
+
+	// Four rows at a time so each output load and store is shared between them
+	for( ; y + 4 <= height; y += 4 ) {
+		const float* row0 = weights + static_cast< std::size_t >( y ) * stride;
+		const float* row1 = row0 + stride;
+		const float* row2 = row1 + stride;
+		const float* row3 = row2 + stride;
+		__m256 scale0 = _mm256_set1_ps( input[ y ] );
+		__m256 scale1 = _mm256_set1_ps( input[ y + 1 ] );
+		__m256 scale2 = _mm256_set1_ps( input[ y + 2 ] );
+		__m256 scale3 = _mm256_set1_ps( input[ y + 3 ] );
+
+		for( unsigned int x = 0; x < vector_width; x += 8 ) {
+			__m256 out = _mm256_loadu_ps( output + x );
+			out = _mm256_fmadd_ps( _mm256_loadu_ps( row0 + x ), scale0, out );
+			out = _mm256_fmadd_ps( _mm256_loadu_ps( row1 + x ), scale1, out );
+			out = _mm256_fmadd_ps( _mm256_loadu_ps( row2 + x ), scale2, out );
+			out = _mm256_fmadd_ps( _mm256_loadu_ps( row3 + x ), scale3, out );
+			_mm256_storeu_ps( output + x, out );
+		}
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			output[ x ] += input[ y ] * row0[ x ] + input[ y + 1 ] * row1[ x ] + input[ y + 2 ] * row2[ x ] + input[ y + 3 ] * row3[ x ];
+		}
+	}
+
+	for( ; y < height; ++y ) {
+		const float* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m256 scale = _mm256_set1_ps( input[ y ] );
+
+		for( unsigned int x = 0; x < vector_width; x += 8 ) {
+			_mm256_storeu_ps( output + x, _mm256_fmadd_ps( _mm256_loadu_ps( row + x ), scale, _mm256_loadu_ps( output + x ) ) );
+		}
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			output[ x ] += input[ y ] * row[ x ];
+		}
+	}
+}
+
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void gemvTransposedAVX512( const float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* input, float* output ) {
+	unsigned int vector_width = width & ~15u;
+	__mmask16 tail_mask = static_cast< __mmask16 >( ( 1u << ( width - vector_width ) ) - 1u );
+	unsigned int y = 0;
+
+	for( ; y + 4 <= height; y += 4 ) {
+		const float* row0 = weights + static_cast< std::size_t >( y ) * stride;
+		const float* row1 = row0 + stride;
+		const float* row2 = row1 + stride;
+		const float* row3 = row2 + stride;
+		__m512 scale0 = _mm512_set1_ps( input[ y ] );
+		__m512 scale1 = _mm512_set1_ps( input[ y + 1 ] );
+		__m512 scale2 = _mm512_set1_ps( input[ y + 2 ] );
+		__m512 scale3 = _mm512_set1_ps( input[ y + 3 ] );
+
+		for( unsigned int x = 0; x < vector_width; x += 16 ) {
+			__m512 out = _mm512_loadu_ps( output + x );
+			out = _mm512_fmadd_ps( _mm512_loadu_ps( row0 + x ), scale0, out );
+			out = _mm512_fmadd_ps( _mm512_loadu_ps( row1 + x ), scale1, out );
+			out = _mm512_fmadd_ps( _mm512_loadu_ps( row2 + x ), scale2, out );
+			out = _mm512_fmadd_ps( _mm512_loadu_ps( row3 + x ), scale3, out );
+			_mm512_storeu_ps( output + x, out );
+		}
+
+		if( vector_width < width ) {
+			__m512 out = _mm512_maskz_loadu_ps( tail_mask, output + vector_width );
+			out = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row0 + vector_width ), scale0, out );
+			out = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row1 + vector_width ), scale1, out );
+			out = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row2 + vector_width ), scale2, out );
+			out = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row3 + vector_width ), scale3, out );
+			_mm512_mask_storeu_ps( output + vector_width, tail_mask, out );
+		}
+	}
+
+	for( ; y < height; ++y ) {
+		const float* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m512 scale = _mm512_set1_ps( input[ y ] );
+
+		for( unsigned int x = 0; x < vector_width; x += 16 ) {
+			_mm512_storeu_ps( output + x, _mm512_fmadd_ps( _mm512_loadu_ps( row + x ), scale, _mm512_loadu_ps( output + x ) ) );
+		}
+
+		if( vector_width < width ) {
+			__m512 out = _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, row + vector_width ), scale, _mm512_maskz_loadu_ps( tail_mask, output + vector_width ) );
+			_mm512_mask_storeu_ps( output + vector_width, tail_mask, out );
+		}
+	}
+}
+
+__attribute__(( target( "sse2" ) ))
+void backwardUpdateSSE2( float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* delta, const float* activation_output, ActivationFunction function, const float* input, float rate, float* bias, float* new_delta ) {
+	unsigned int vector_width = width & ~3u;
+
+	for( unsigned int y = 0; y < height; ++y ) {
+		float* row = weights + static_cast< std::size_t >( y ) * stride;
+		const float row_scale = scaledRowDelta( delta, activation_output, function, y );
+		__m128 scale = _mm_set1_ps( row_scale );
+		__m128 step = _mm_set1_ps( rate * row_scale );
+
+		if( bias ) {
+			bias[ y ] -= rate * row_scale;
+		}
+
+		for( unsigned int x = 0; x < vector_width; x += 4 ) {
+			__m128 weight = _mm_loadu_ps( row + x );
+
+			if( new_delta ) {
+				_mm_storeu_ps( new_delta + x, _mm_add_ps( _mm_loadu_ps( new_delta + x ), _mm_mul_ps( scale, weight ) ) );
+			}
+
+			_mm_storeu_ps( row + x, _mm_sub_ps( weight, _mm_mul_ps( step, _mm_loadu_ps( input + x ) ) ) );
+		}
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			if( new_delta ) {
+				new_delta[ x ] += row_scale * row[ x ];
+			}
+
+			row[ x ] -= rate * row_scale * input[ x ];
+		}
+	}
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+void backwardUpdateAVX2( float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* delta, const float* activation_output, ActivationFunction function, const float* input, float rate, float* bias, float* new_delta ) {
+	unsigned int vector_width = width & ~7u;
+	unsigned int y = 0;
+
+	// Two rows at a time so each input and new_delta access is shared between them
+	for( ; y + 2 <= height; y += 2 ) {
+		float* row0 = weights + static_cast< std::size_t >( y ) * stride;
+		float* row1 = row0 + stride;
+		const float row_scale0 = scaledRowDelta( delta, activation_output, function, y );
+		const float row_scale1 = scaledRowDelta( delta, activation_output, function, y + 1 );
+		__m256 scale0 = _mm256_set1_ps( row_scale0 );
+		__m256 scale1 = _mm256_set1_ps( row_scale1 );
+		__m256 step0 = _mm256_set1_ps( -rate * row_scale0 );
+		__m256 step1 = _mm256_set1_ps( -rate * row_scale1 );
+
+		if( bias ) {
+			bias[ y ] -= rate * row_scale0;
+			bias[ y + 1 ] -= rate * row_scale1;
+		}
+
+		for( unsigned int x = 0; x < vector_width; x += 8 ) {
+			__m256 in = _mm256_loadu_ps( input + x );
+			__m256 weight0 = _mm256_loadu_ps( row0 + x );
+			__m256 weight1 = _mm256_loadu_ps( row1 + x );
+
+			if( new_delta ) {
+				__m256 out = _mm256_loadu_ps( new_delta + x );
+				out = _mm256_fmadd_ps( weight0, scale0, out );
+				out = _mm256_fmadd_ps( weight1, scale1, out );
+				_mm256_storeu_ps( new_delta + x, out );
+			}
+
+			_mm256_storeu_ps( row0 + x, _mm256_fmadd_ps( in, step0, weight0 ) );
+			_mm256_storeu_ps( row1 + x, _mm256_fmadd_ps( in, step1, weight1 ) );
+		}
+
+		for( unsigned int x = vector_width; x < width; ++x ) {
+			if( new_delta ) {
+				new_delta[ x ] += row_scale0 * row0[ x ] + row_scale1 * row1[ x ];
+			}
+
+			row0[ x ] -= rate * row_scale0 * input[ x ];
+			row1[ x ] -= rate * row_scale1 * input[ x ];
+		}
+	}
+
+	if( y < height ) {
+		backwardUpdateSSE2( weights + static_cast< std::size_t >( y ) * stride, stride, height - y, width, delta + y, activation_output ? activation_output + y : nullptr, function, input, rate, bias ? bias + y : nullptr, new_delta );
+	}
+}
+
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void backwardUpdateAVX512( float* weights, unsigned int stride, unsigned int height, unsigned int width, const float* delta, const float* activation_output, ActivationFunction function, const float* input, float rate, float* bias, float* new_delta ) {
+	unsigned int vector_width = width & ~15u;
+	__mmask16 tail_mask = static_cast< __mmask16 >( ( 1u << ( width - vector_width ) ) - 1u );
+
+	for( unsigned int y = 0; y < height; ++y ) {
+		float* row = weights + static_cast< std::size_t >( y ) * stride;
+		const float row_scale = scaledRowDelta( delta, activation_output, function, y );
+		__m512 scale = _mm512_set1_ps( row_scale );
+		__m512 step = _mm512_set1_ps( -rate * row_scale );
+
+		if( bias ) {
+			bias[ y ] -= rate * row_scale;
+		}
+
+		for( unsigned int x = 0; x < vector_width; x += 16 ) {
+			__m512 weight = _mm512_loadu_ps( row + x );
+
+			if( new_delta ) {
+				_mm512_storeu_ps( new_delta + x, _mm512_fmadd_ps( weight, scale, _mm512_loadu_ps( new_delta + x ) ) );
+			}
+
+			_mm512_storeu_ps( row + x, _mm512_fmadd_ps( _mm512_loadu_ps( input + x ), step, weight ) );
+		}
+
+		if( vector_width < width ) {
+			__m512 weight = _mm512_maskz_loadu_ps( tail_mask, row + vector_width );
+
+			if( new_delta ) {
+				_mm512_mask_storeu_ps( new_delta + vector_width, tail_mask, _mm512_fmadd_ps( weight, scale, _mm512_maskz_loadu_ps( tail_mask, new_delta + vector_width ) ) );
+			}
+
+			_mm512_mask_storeu_ps( row + vector_width, tail_mask, _mm512_fmadd_ps( _mm512_maskz_loadu_ps( tail_mask, input + vector_width ), step, weight ) );
+		}
+	}
+}
+#endif
+
+typedef void ( *GEMVKernel )( const float*, unsigned int, unsigned int, unsigned int, const float*, const float*, float* );
+
+/**
+ * Pick the widest matrix-vector kernel the CPU supports for an epilogue.
+ * @return The selected kernel.
+ */
+template< ActivationFunction Function, ActivationAccuracy Accuracy >
+GEMVKernel selectGEMVKernelFor() {
+#if NN_X86
+	const CPUFeatures& features = CPUFeatures::get();
+
+	if( features.hasAVX512() ) {
+		return gemvAVX512< Function, Accuracy >;
+	}
+
+	if( features.hasAVX2() ) {
+		return gemvAVX2< Function, Accuracy >;
+	}
+
+	if( features.hasSSE2() ) {
+		return gemvSSE2< Function, Accuracy >;
+	}
+#endif
+	return gemvScalar< Function, Accuracy >;
+}
+
+/**
+ * Pick the widest matrix-vector kernel the CPU supports, finishing each output with an activation. Selected once on first use.
+ * @param function The activation to apply after the bias.
+ * @param accuracy The accuracy tier to apply it at.
+ * @return The selected kernel.
+ */
+GEMVKernel selectGEMVKernel( ActivationFunction function = ActivationFunction::Identity, ActivationAccuracy accuracy = ActivationAccuracy::Exact ) {
+	static const GEMVKernel tanh_kernels[] = {
+		selectGEMVKernelFor< ActivationFunction::Tanh, ActivationAccuracy::Exact >(),
+		selectGEMVKernelFor< ActivationFunction::Tanh, ActivationAccuracy::Accurate >(),
+		selectGEMVKernelFor< ActivationFunction::Tanh, ActivationAccuracy::Fast >()
+	};
+
+	static const GEMVKernel sigmoid_kernels[] = {
+		selectGEMVKernelFor< ActivationFunction::Sigmoid, ActivationAccuracy::Exact >(),
+		selectGEMVKernelFor< ActivationFunction::Sigmoid, ActivationAccuracy::Accurate >(),
+		selectGEMVKernelFor< ActivationFunction::Sigmoid, ActivationAccuracy::Fast >()
+	};
+
+	static const GEMVKernel identity_kernel = selectGEMVKernelFor< ActivationFunction::Identity, ActivationAccuracy::Exact >();
+
+	const unsigned int tier = static_cast< unsigned int >( accuracy );
+
+	switch( function ) {
+		case ActivationFunction::Tanh:
+			return tanh_kernels[ tier ];
+
+		case ActivationFunction::Sigmoid:
+			return sigmoid_kernels[ tier ];
+
+		default:
+			return identity_kernel;
+	}
+}
+
+typedef void ( *TransposedGEMVKernel )( const float*, unsigned int, unsigned int, unsigned int, const float*, float* );
+
+/**
+ * Pick the widest transposed matrix-vector kernel the CPU supports. Selected once on first use.
+ * @return The selected kernel.
+ */
+TransposedGEMVKernel selectTransposedGEMVKernel() {
+	static const TransposedGEMVKernel kernel = []() -> TransposedGEMVKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512() ) {
+			return gemvTransposedAVX512;
+		}
+
+		if( features.hasAVX2() ) {
+			return gemvTransposedAVX2;
+		}
+
+		if( features.hasSSE2() ) {
+			return gemvTransposedSSE2;
+		}
+#endif
+		return gemvTransposedScalar;
+	}();
+
+	return kernel;
+}
+
+typedef void ( *BackwardUpdateKernel )( float*, unsigned int, unsigned int, unsigned int, const float*, const float*, ActivationFunction, const float*, float, float*, float* );
+
+/**
+ * Pick the widest fused backward pass kernel the CPU supports. Selected once on first use.
+ * @return The selected kernel.
+ */
+BackwardUpdateKernel selectBackwardUpdateKernel() {
+	static const BackwardUpdateKernel kernel = []() -> BackwardUpdateKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512() ) {
+			return backwardUpdateAVX512;
+		}
+
+		if( features.hasAVX2() ) {
+			return backwardUpdateAVX2;
+		}
+
+		if( features.hasSSE2() ) {
+			return backwardUpdateSSE2;
+		}
+#endif
+		return backwardUpdateScalar;
+	}();
+
+	return kernel;
+}
+
+/**
+ * Get the name of the instruction set used by the matrix kernels.
+ * @return The instruction set name.
+ */
+const char* getMatrixKernelName() {
+#if NN_X86
+	GEMVKernel kernel = selectGEMVKernel();
+
+	if( kernel == gemvAVX512< ActivationFunction::Identity, ActivationAccuracy::Exact > ) {
+		return "AVX-512";
+	}
+
+	if( kernel == gemvAVX2< ActivationFunction::Identity, ActivationAccuracy::Exact > ) {
+		return "AVX2";
+	}
+
+	if( kernel == gemvSSE2< ActivationFunction::Identity, ActivationAccuracy::Exact > ) {
+		return "SSE2";
+	}
+#endif
+	return "scalar";
+}
+
+// Below this many weights, the cost of starting threads outweighs splitting the rows between them
+const std::size_t parallel_work_threshold = 1 << 16;
+
+int& getKernelThreadSetting() {
+	static int threads = 0;
+	return threads;
+}
+
+/**
+ * Set the number of threads large matrix kernels are split across.
+ * @param threads The number of threads. 0 uses OpenMP's default and 1 keeps every kernel serial.
+ */
+void setKernelThreadCount( int threads ) {
+	getKernelThreadSetting() = threads < 0 ? 0 : threads;
+}
+
+/**
+ * Get the number of threads a kernel should be split across.
+ * @param work The number of weights the kernel reads.
+ * @return 1 below the parallel work threshold or without OpenMP, otherwise the configured thread count.
+ */
+int getKernelThreadCount( std::size_t work = parallel_work_threshold ) {
+#ifdef _OPENMP
+	if( work < parallel_work_threshold ) {
+		return 1;
+	}
+
+	return getKernelThreadSetting() > 0 ? getKernelThreadSetting() : omp_get_max_threads();
+#else
+	static_cast< void >( work );
+	return 1;
+#endif
+}
+
+bool& getNumaModeSetting() {
+	static bool enabled = false;
+	return enabled;
+}
+
+/**
+ * Set whether kernel threads are pinned across the NUMA nodes and matrices are first touched by the threads that later read them. Matrices allocated in this mode keep each thread's rows on that thread's node.
+ * @param enabled Whether to use the NUMA aware mode.
+ */
+void setNumaMode( bool enabled ) {
+	getNumaModeSetting() = enabled;
+}
+
+bool isNumaMode() {
+	return getNumaModeSetting();
+}
+
+/**
+ * Pin the calling kernel thread for its place in the team when in NUMA mode, or release it when the mode has been turned off. Called at the start of every parallel region, so pinning follows changes to the thread count.
+ * @param thread The index of the thread in its team.
+ * @param threads The size of the team.
+ */
+void bindKernelThread( int thread, int threads ) {
+	// The team size the thread is pinned for, or 0 when it is free to run anywhere
+	static thread_local int pinned_team = 0;
+	const int wanted_team = isNumaMode() ? threads : 0;
+
+	if( pinned_team == wanted_team ) {
+		return;
+	}
+
+	const NumaTopology& topology = NumaTopology::get();
+
+	if( wanted_team == 0 ) {
+		std::vector< int > cpus;
+		for( unsigned int node = 0; node < topology.getNodeCount(); ++node ) {
+			cpus.insert( cpus.end(), topology.getNodeCPUs( node ).begin(), topology.getNodeCPUs( node ).end() );
+		}
+		setThreadAffinity( cpus );
+	} else {
+		setThreadAffinity( std::vector< int >( 1, topology.getThreadCPU( thread, threads ) ) );
+	}
+
+	pinned_team = wanted_team;
+}
+
+/**
+ * Run a kernel over a range of rows, split into one contiguous chunk per thread when there is enough work. Thread local buffers must be passed to the kernel by address, as each worker sees its own instances.
+ * @param height The number of rows.
+ * @param work The number of weights the rows hold, compared against the parallel work threshold.
+ * @param rows The kernel, called as rows( first, count ) for each chunk.
+ */
+template< typename RowFunction >
+void parallelForRows( unsigned int height, std::size_t work, RowFunction rows ) {
+	const int thread_count = getKernelThreadCount( work );
+
+	if( thread_count <= 1 || height < 2 ) {
+		rows( 0u, height );
+		return;
+	}
+
+	#pragma omp parallel num_threads( thread_count )
+	{
+#ifdef _OPENMP
+		const int thread = omp_get_thread_num();
+		const int threads = omp_get_num_threads();
+#else
+		const int thread = 0;
+		const int threads = 1;
+#endif
+		const unsigned int first = static_cast< unsigned int >( static_cast< std::size_t >( height ) * thread / threads );
+		const unsigned int last = static_cast< unsigned int >( static_cast< std::size_t >( height ) * ( thread + 1 ) / threads );
+
+		bindKernelThread( thread, threads );
+
+		if( first < last ) {
+			rows( first, last - first );
+		}
+	}
+}
+
+/**
+ * Zero a newly allocated row-major buffer. In NUMA mode each row chunk is zeroed by the thread that the kernels give it to, so its pages are placed on that thread's node.
+ * @param values The buffer to zero.
+ * @param stride The distance in elements between the starts of consecutive rows.
+ * @param height The number of rows.
+ * @param width The number of elements the kernels read from each row, which decides whether they split the rows.
+ */
+template< typename T >
+void firstTouchRows( T* values, std::size_t stride, unsigned int height, unsigned int width ) {
+	if( stride * height == 0 ) {
+		return;
+	}
+
+	if( !isNumaMode() ) {
+		std::memset( values, 0, stride * height * sizeof( T ) );
+		return;
+	}
+
+	parallelForRows( height, static_cast< std::size_t >( height ) * width, [ & ]( unsigned int first, unsigned int count ) {
+		std::memset( values + first * stride, 0, count * stride * sizeof( T ) );
+	} );
+}
+
+/**
+ * Calculate output = activation( weights * input + bias ), writing each output once.
+ * @param weights The weight matrix.
+ * @param input The vector to multiply by. Must match the width of the weight matrix.
+ * @param bias The vector to add to the product. Must match the height of the weight matrix, or be empty for no bias. May be the output vector.
+ * @param output The vector to write the result into. Must match the height of the weight matrix.
+ * @param function The activation to apply after the bias.
+ * @param accuracy The accuracy tier to apply it at.
+ */
+void gemv( ConstMatrixView weights, ConstVectorView input, ConstVectorView bias, VectorView output, ActivationFunction function = ActivationFunction::Identity, ActivationAccuracy accuracy = ActivationAccuracy::Exact ) {
+#ifdef NN_BOUNDS_CHECK
+	if( input.getDimension() != weights.getWidth() || output.getDimension() != weights.getHeight() || ( bias.data() && bias.getDimension() != weights.getHeight() ) ) {
+		throw std::string( "Mismatched dimensions in matrix-vector product" );
+	}
+#endif
+
+	if( input.isContiguous() && bias.isContiguous() && output.isContiguous() ) {
+		GEMVKernel kernel = selectGEMVKernel( function, accuracy );
+		const unsigned int stride = weights.getStride();
+
+		parallelForRows( weights.getHeight(), static_cast< std::size_t >( weights.getHeight() ) * weights.getWidth(), [ & ]( unsigned int first, unsigned int count ) {
+			kernel( weights.data() + static_cast< std::size_t >( first ) * stride, stride, count, weights.getWidth(), input.data(), bias.data() ? bias.data() + first : nullptr, output.data() + first );
+		} );
+		return;
+	}
+
+	// Strided vectors cannot use vector loads, so take the reference path
+	for( unsigned int y = 0; y < weights.getHeight(); ++y ) {
+		const float* row = weights.row( y );
+		float accum = bias.data() ? bias( y ) : 0.f;
+
+		for( unsigned int x = 0; x < weights.getWidth(); ++x ) {
+			accum += row[ x ] * input( x );
+		}
+
+		output( y ) = activate( function, accuracy, accum );
+	}
+}
+
+/**
+ * Calculate output = transpose( weights ) * input, or add it to output, without forming the transpose. Used to propagate deltas backwards through a layer.
+ * @param weights The weight matrix.
+ * @param input The vector to multiply by. Must match the height of the weight matrix.
+ * @param output The vector to write the result into. Must match the width of the weight matrix.
+ * @param accumulate Whether to add the result to output instead of overwriting it.
+ */
+void gemvTransposed( ConstMatrixView weights, ConstVectorView input, VectorView output, bool accumulate = false ) {
+#ifdef NN_BOUNDS_CHECK
+	if( input.getDimension() != weights.getHeight() || output.getDimension() != weights.getWidth() ) {
+		throw std::string( "Mismatched dimensions in transposed matrix-vector product" );
+	}
+#endif
+
+	if( !accumulate ) {
+		for( unsigned int x = 0; x < output.getDimension(); ++x ) {
+			output( x ) = 0.f;
+		}
+	}
+
+	if( input.isContiguous() && output.isContiguous() ) {
+		TransposedGEMVKernel kernel = selectTransposedGEMVKernel();
+		const unsigned int width = weights.getWidth();
+
+		// Each output element sums over every row, so the work is split by columns instead, in whole cache lines
+		parallelForRows( ( width + 15 ) / 16, static_cast< std::size_t >( weights.getHeight() ) * width, [ & ]( unsigned int first, unsigned int count ) {
+			const unsigned int first_column = first * 16;
+			const unsigned int last_column = std::min( width, ( first + count ) * 16 );
+			kernel( weights.data() + first_column, weights.getStride(), weights.getHeight(), last_column - first_column, input.data(), output.data() + first_column );
+		} );
+		return;
+	}
+
+	for( unsigned int y = 0; y < weights.getHeight(); ++y ) {
+		const float* row = weights.row( y );
+		const float scale = input( y );
+
+		for( unsigned int x = 0; x < weights.getWidth(); ++x ) {
+			output( x ) += scale * row[ x ];
+		}
+	}
+}
+
+/**
+ * Propagate a delta back through a layer's weights and apply the gradient step to them in a single pass. Each row's delta is first scaled by the derivative of its activation, then new_delta += transpose( weights ) * delta is computed with the weights from before the step, and weights -= rate * delta * transpose( input ) and bias -= rate * delta applied. Large matrices are split by rows across threads, each accumulating its own partial new_delta.
+ * @param weights The weight matrix to update.
+ * @param delta The delta at each row's activation output. Must match the height of the weight matrix.
+ * @param activation_output The output of each row's activation. Must match the height of the weight matrix, or be empty when the deltas are already scaled.
+ * @param function The activation the outputs came from.
+ * @param input The input the layer was trained on. Must match the width of the weight matrix.
+ * @param rate The learning rate.
+ * @param bias The bias to update. Must match the height of the weight matrix, or be empty to leave it out.
+ * @param new_delta The vector to add the propagated delta to. Must match the width of the weight matrix, or be empty for only the update.
+ */
+void backwardUpdate( MatrixView weights, ConstVectorView delta, ConstVectorView activation_output, ActivationFunction function, ConstVectorView input, float rate, VectorView bias, VectorView new_delta ) {
+#ifdef NN_BOUNDS_CHECK
+	if( delta.getDimension() != weights.getHeight() || input.getDimension() != weights.getWidth() || ( new_delta.data() && new_delta.getDimension() != weights.getWidth() ) ) {
+		throw std::string( "Mismatched dimensions in backward update" );
+	}
+
+	if( ( activation_output.data() && activation_output.getDimension() != weights.getHeight() ) || ( bias.data() && bias.getDimension() != weights.getHeight() ) ) {
+		throw std::string( "Mismatched dimensions in backward update" );
+	}
+#endif
+
+	const unsigned int height = weights.getHeight();
+	const unsigned int width = weights.getWidth();
+
+	if( !delta.isContiguous() || !activation_output.isContiguous() || !input.isContiguous() || !bias.isContiguous() || !new_delta.isContiguous() ) {
+		for( unsigned int y = 0; y < height; ++y ) {
+			float* row = weights.row( y );
+			const float scale = activation_output.data() ? delta( y ) * activationDerivativeFromOutput( function, activation_output( y ) ) : delta( y );
+			const float step = rate * scale;
+
+			for( unsigned int x = 0; x < width; ++x ) {
+				if( new_delta.data() ) {
+					new_delta( x ) += scale * row[ x ];
+				}
+
+				row[ x ] -= step * input( x );
+			}
+
+			if( bias.data() ) {
+				bias( y ) -= step;
+			}
+		}
+
+		return;
+	}
+
+	BackwardUpdateKernel kernel = selectBackwardUpdateKernel();
+
+	const int thread_count = getKernelThreadCount( static_cast< std::size_t >( height ) * width );
+
+	if( thread_count <= 1 || height < 2 ) {
+		kernel( weights.data(), weights.getStride(), height, width, delta.data(), activation_output.data(), function, input.data(), rate, bias.data(), new_delta.data() );
+		return;
+	}
+
+	// One padded partial new_delta per thread, summed once every row is done
+	const std::size_t partial_stride = ( width + 15u ) & ~static_cast< std::size_t >( 15u );
+	static thread_local AlignedBuffer< float > partial_storage;
+	if( new_delta.data() ) {
+		partial_storage.resize( partial_stride * thread_count );
+	}
+
+	// The buffer belongs to the calling thread, so the workers are handed its address
+	float* partials = partial_storage.data();
+
+	#pragma omp parallel num_threads( thread_count )
+	{
+#ifdef _OPENMP
+		const int thread = omp_get_thread_num();
+		const int threads = omp_get_num_threads();
+#else
+		const int thread = 0;
+		const int threads = 1;
+#endif
+		const unsigned int first = static_cast< unsigned int >( static_cast< std::size_t >( height ) * thread / threads );
+		const unsigned int last = static_cast< unsigned int >( static_cast< std::size_t >( height ) * ( thread + 1 ) / threads );
+		float* partial = nullptr;
+
+		bindKernelThread( thread, threads );
+
+		if( new_delta.data() ) {
+			partial = partials + partial_stride * thread;
+			for( unsigned int x = 0; x < width; ++x ) {
+				partial[ x ] = 0.f;
+			}
+		}
+
+		kernel( weights.data() + static_cast< std::size_t >( first ) * weights.getStride(), weights.getStride(), last - first, width, delta.data() + first, activation_output.data() ? activation_output.data() + first : nullptr, function, input.data(), rate, bias.data() ? bias.data() + first : nullptr, partial );
+
+		if( new_delta.data() ) {
+			#pragma omp barrier
+			#pragma omp for
+			for( unsigned int x = 0; x < width; ++x ) {
+				float sum = new_delta( x );
+				for( int t = 0; t < threads; ++t ) {
+					sum += partials[ partial_stride * t + x ];
+				}
+				new_delta( x ) = sum;
+			}
+		}
+	}
+}
+
+/**
+ * Propagate an already scaled delta back through a layer's weights and apply the gradient step to them in a single pass: new_delta += transpose( weights ) * delta, computed with the weights from before the step, then weights -= rate * delta * transpose( input ).
+ * @param weights The weight matrix to update.
+ * @param delta The delta of each row. Must match the height of the weight matrix.
+ * @param input The input the layer was trained on. Must match the width of the weight matrix.
+ * @param rate The learning rate.
+ * @param new_delta The vector to add the propagated delta to. Must match the width of the weight matrix, or be empty for only the update.
+ */
+void backwardUpdate( MatrixView weights, ConstVectorView delta, ConstVectorView input, float rate, VectorView new_delta ) {
+	backwardUpdate( weights, delta, ConstVectorView(), ActivationFunction::Identity, input, rate, VectorView(), new_delta );
+}
+
+/**
+ * Apply the gradient step weights -= rate * delta * transpose( input ), without propagating a delta.
+ * @param weights The weight matrix to update.
+ * @param delta The delta of each row. Must match the height of the weight matrix.
+ * @param input The input the layer was trained on. Must match the width of the weight matrix.
+ * @param rate The learning rate.
+ */
+void rankOneUpdate( MatrixView weights, ConstVectorView delta, ConstVectorView input, float rate ) {
+	backwardUpdate( weights, delta, input, rate, VectorView() );
+}
+
+#endif // MATRIXKERNELS_HPP
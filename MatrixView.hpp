@@ -0,0 +1,100 @@
+#ifndef MATRIXVIEW_HPP
+#define MATRIXVIEW_HPP
+
+#include <cstddef>
+#include <string>
+
+/**
+ * A non-owning view of a row-major matrix stored in an external float buffer. Rows are spaced out by an explicit stride, so a view can cover a block of a larger matrix.
+ */
+template< typename T >
+class BasicMatrixView {
+	private:
+		T* m_values;
+		unsigned int m_height;
+		unsigned int m_width;
+		unsigned int m_stride;
+
+	public:
+		BasicMatrixView() : m_values( nullptr ), m_height( 0 ), m_width( 0 ), m_stride( 0 ) {
+		}
+
+		/**
+		 * Create a view over an external buffer.
+		 * @param values The buffer to view. Must outlive the view.
+		 * @param height The number of rows in the view.
+		 * @param width The number of columns in the view.
+		 * @param stride The distance between the starts of consecutive rows, in elements.
+		 */
+		BasicMatrixView( T* values, unsigned int height, unsigned int width, unsigned int stride ) : m_values( values ), m_height( height ), m_width( width ), m_stride( stride ) {
+		}
+
+		/**
+		 * Create a view over an external buffer, starting part of the way in.
+		 * @param values The buffer to view. Must outlive the view.
+		 * @param offset The index of the element the first row starts at.
+		 * @param height The number of rows in the view.
+		 * @param width The number of columns in the view.
+		 * @param stride The distance between the starts of consecutive rows, in elements.
+		 */
+		BasicMatrixView( T* values, std::size_t offset, unsigned int height, unsigned int width, unsigned int stride ) : m_values( values + offset ), m_height( height ), m_width( width ), m_stride( stride ) {
+		}
+
+		/**
+		 * Views of mutable data can be used wherever a read-only view is expected.
+		 */
+		template< typename U >
+		BasicMatrixView( const BasicMatrixView< U >& other ) : m_values( other.data() ), m_height( other.getHeight() ), m_width( other.getWidth() ), m_stride( other.getStride() ) {
+		}
+
+		unsigned int getHeight() const {
+			return m_height;
+		}
+
+		unsigned int getWidth() const {
+			return m_width;
+		}
+
+		unsigned int getStride() const {
+			return m_stride;
+		}
+
+		/**
+		 * Get a view of a block of this view.
+		 * @param y The first row of the block.
+		 * @param x The first column of the block.
+		 * @param height The number of rows in the block.
+		 * @param width The number of columns in the block.
+		 * @return The block, sharing this view's stride.
+		 */
+		BasicMatrixView block( unsigned int y, unsigned int x, unsigned int height, unsigned int width ) const {
+			return BasicMatrixView( m_values + static_cast< std::size_t >( y ) * m_stride + x, height, width, m_stride );
+		}
+
+		T& operator()( unsigned int y, unsigned int x ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( y >= m_height || x >= m_width ) {
+				throw std::string( "Matrix view access out of bounds" );
+			}
+#endif
+			return m_values[ static_cast< std::size_t >( y ) * m_stride + x ];
+		}
+
+		T* row( unsigned int y ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( y >= m_height ) {
+				throw std::string( "Matrix view row out of bounds" );
+			}
+#endif
+			return m_values + static_cast< std::size_t >( y ) * m_stride;
+		}
+
+		T* data() const {
+			return m_values;
+		}
+};
+
+typedef BasicMatrixView< float > MatrixView;
+typedef BasicMatrixView< const float > ConstMatrixView;
+
+#endif // MATRIXVIEW_HPP
@@ -3,25 +3,108 @@
 
 #include <string>
 #include "json/json.h"
+#include "ActivationKernels.hpp"
+#include "Arena.hpp"
+#include "HalfPrecision.hpp"
+#include "MatrixView.hpp"
+#include "Optimizer.hpp"
 #include "Vector.hpp"
+#include "VectorView.hpp"
 
 class NetworkLayer {
 	private:
 		unsigned int m_inputs;
 		unsigned int m_outputs;
 
+		Arena* m_arena;
+		Arena m_local_arena;
+
+		ActivationAccuracy m_activation_accuracy;
+
+		std::size_t m_parameter_offset;
+		unsigned int m_gradient_samples;
+
 	protected:
+		/**
+		 * Get the arena to take per-step temporaries from. Allocations should be made inside an ArenaScope so standalone layers do not grow their arena without bound.
+		 * @return The arena of the owning network, or the layer's own arena if it has not been added to one.
+		 */
+		Arena& getArena() {
+			return m_arena ? *m_arena : m_local_arena;
+		}
+
 		virtual void setSizeInternal( const unsigned int inputs, const unsigned int outputs ) = 0;
 
+		/**
+		 * Size the layer for parameters about to be loaded from its data object. Layers whose saved form does not need their usual storage can skip allocating and initializing it.
+		 * @param inputs The number of inputs to the layer.
+		 * @param outputs The number of outputs from the layer.
+		 * @param data_value The layer's data object, as given to loadFromJSONInternal() next.
+		 */
+		virtual void setSizeForLoadInternal( const unsigned int inputs, const unsigned int outputs, Json::Value& ) {
+			setSizeInternal( inputs, outputs );
+		}
+
 		virtual void loadFromJSONInternal( Json::Value& data_value ) = 0;
 		virtual Json::Value saveToJSONInternal() = 0;
 		virtual std::string getJSONTypeName() const = 0;
 
+		/**
+		 * Round a run of parameters up to a whole number of cache lines, so every run laid out after it in a flat buffer starts 64 byte aligned.
+		 * @param count The number of parameters in the run.
+		 * @return The space the run takes up.
+		 */
+		static std::size_t alignParameterCount( std::size_t count ) {
+			return ( count + 15 ) / 16 * 16;
+		}
+
+		/**
+		 * Add the gradients of one sample to the layer's gradient buffers, sizing and zeroing them first if they do not fit. Arguments are as for train() and already validated.
+		 */
+		virtual void computeGradientsInternal( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta ) = 0;
+
+		/**
+		 * Add the gradients of a batch of samples to the layer's gradient buffers. Arguments are as for computeGradientsBatch() and already validated. Defaults to adding the samples one at a time, in row order.
+		 */
+		virtual void computeGradientsBatchInternal( ConstMatrixView inputs, ConstMatrixView outputs, ConstMatrixView deltas, MatrixView new_deltas ) {
+			for( unsigned int b = 0; b < inputs.getHeight(); ++b ) {
+				VectorView new_delta = new_deltas.data() ? VectorView( new_deltas.row( b ), getInputCount() ) : VectorView();
+				computeGradientsInternal( ConstVectorView( inputs.row( b ), getInputCount() ), ConstVectorView( outputs.row( b ), getOutputCount() ), ConstVectorView( deltas.row( b ), getOutputCount() ), new_delta );
+			}
+		}
+
+		/**
+		 * Step the parameters against the gradient buffers, in the order getParameterCount() counts them, then zero the buffers.
+		 * @param optimizer The update rule to step with.
+		 * @param scale The factor to multiply the gradients by.
+		 */
+		virtual void applyGradientsInternal( Optimizer& optimizer, float scale ) = 0;
+
 	public:
+		NetworkLayer() : m_inputs( 0 ), m_outputs( 0 ), m_arena( nullptr ), m_activation_accuracy( ActivationAccuracy::Exact ), m_parameter_offset( 0 ), m_gradient_samples( 0 ) {
+		}
+
+		virtual ~NetworkLayer() {
+		}
+
+		/**
+		 * Set the arena the layer takes its temporaries from.
+		 * @param arena The arena to use, which must outlive the layer, or null to use the layer's own arena.
+		 */
+		void setArena( Arena* arena ) {
+			m_arena = arena;
+		}
+
 		void loadFromJSON( Json::Value& layer_value ) {
-			setInputCount( layer_value[ "inputs" ].asUInt() );
-			setOutputCount( layer_value[ "outputs" ].asUInt() );
+			// Sized once, for both counts together, as each resize reallocates the parameters
+			m_inputs = layer_value[ "inputs" ].asUInt();
+			m_outputs = layer_value[ "outputs" ].asUInt();
+			setSizeForLoadInternal( m_inputs, m_outputs, layer_value[ "data" ] );
 			loadFromJSONInternal( layer_value[ "data" ] );
+
+			// Set after the weights are loaded so the reduced copies are filled from them
+			setWeightPrecision( parsePrecisionName( layer_value.get( "precision", "float32" ).asString() ) );
+			setActivationAccuracy( parseActivationAccuracyName( layer_value.get( "activation-accuracy", "exact" ).asString() ) );
 		}
 
 		Json::Value saveToJSON() {
@@ -29,6 +112,8 @@ class NetworkLayer {
 			layer_object[ "inputs" ] = Json::Value( getInputCount() );
 			layer_object[ "outputs" ] = Json::Value( getOutputCount() );
 			layer_object[ "type" ] = Json::Value( getJSONTypeName() );
+			layer_object[ "precision" ] = Json::Value( getPrecisionName( getWeightPrecision() ) );
+			layer_object[ "activation-accuracy" ] = Json::Value( getActivationAccuracyName( getActivationAccuracy() ) );
 			layer_object[ "data" ] = saveToJSONInternal();
 			return layer_object;
 		}
@@ -51,12 +136,78 @@ class NetworkLayer {
 			setSizeInternal( getInputCount(), outputs );
 		}
 
+		/**
+		 * Get the precision the layer's weights are read in during propagation.
+		 * @return The weight precision. Layers without reduced precision support always use Float32.
+		 */
+		virtual WeightPrecision getWeightPrecision() const {
+			return WeightPrecision::Float32;
+		}
+
+		/**
+		 * Set the precision the layer's weights are read in during propagation. Training still updates single precision weights. Ignored by layers without reduced precision support.
+		 * @param precision The weight precision to use.
+		 */
+		virtual void setWeightPrecision( WeightPrecision ) {
+		}
+
+		ActivationAccuracy getActivationAccuracy() const {
+			return m_activation_accuracy;
+		}
+
+		/**
+		 * Set how closely the layer's activation functions follow libm. Applies to propagation and training alike.
+		 * @param accuracy The accuracy tier to use.
+		 */
+		void setActivationAccuracy( ActivationAccuracy accuracy ) {
+			m_activation_accuracy = accuracy;
+		}
+
+		/**
+		 * Whether the layer is specialized for its size at compile time. Such layers only hold single precision weights that have not been pruned, and the network swaps them for general layers when either is asked for.
+		 * @return True for fixed size layers.
+		 */
+		virtual bool isFixedSize() const {
+			return false;
+		}
+
+		/**
+		 * Drop the layer's small weights and switch it to sparse storage, so propagation and training only touch the weights left. Ignored by layers without sparse support.
+		 * @param threshold The magnitude below which weights are dropped.
+		 * @return The fraction of the layer's weights still stored.
+		 */
+		virtual float prune( float ) {
+			return 1.f;
+		}
+
+		/**
+		 * Propagate data through the network layer into a caller's buffer.
+		 * @param input The input data to propagate.
+		 * @param output The vector to write the output of the network layer into. Must match the output count and must not overlap the input.
+		 */
+		virtual void propagate( ConstVectorView input, VectorView output ) = 0;
+
 		/**
 		 * Propagate data through the network layer.
 		 * @param input The input data to propagate.
 		 * @return The output of the network layer.
 		 */
-		virtual Vector propagate( Vector input ) = 0;
+		Vector propagate( ConstVectorView input ) {
+			Vector output;
+			output.setDimension( getOutputCount() );
+			propagate( input, output );
+			return output;
+		}
+
+		/**
+		 * Train the network layer, writing the error for the previous layer into a caller's buffer.
+		 * @param input The input to the layer for training on.
+		 * @param output The output of the layer being trained.
+		 * @param delta The error from the next layer for training on.
+		 * @param new_delta The vector to write the error for passing into the next layer into. Must match the input count and must not overlap the other arguments, or be empty when the error is not needed.
+		 * @param mutability The rate at which the layer is allowed to change.
+		 */
+		virtual void train( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta, float mutability = 0.05f ) = 0;
 
 		/**
 		 * Train the network layer.
@@ -66,7 +217,181 @@ class NetworkLayer {
 		 * @param mutability The rate at which the layer is allowed to change.
 		 * @return The error for passing into the next layer.
 		 */
-		virtual Vector train( Vector input, Vector output, Vector delta, float mutability = 0.05f ) = 0;
+		Vector train( ConstVectorView input, ConstVectorView output, ConstVectorView delta, float mutability = 0.05f ) {
+			Vector new_delta;
+			new_delta.setDimension( getInputCount() );
+			train( input, output, delta, new_delta, mutability );
+			return new_delta;
+		}
+
+		/**
+		 * Get the number of learnable parameters the layer holds, counting the padding of matrix rows and of each run of parameters out to a 64 byte boundary.
+		 * @return The parameter count.
+		 */
+		virtual std::size_t getParameterCount() const = 0;
+
+		/**
+		 * Move the layer's parameters, and optionally its gradients, into external buffers and use them there from now on. Each run of parameters starts at a 64 byte boundary, in the order applyGradients() steps them, and the gaps between runs are left alone. Resizing or pruning the layer gives it memory of its own again.
+		 * @param parameters Where to keep the parameters. Must hold getParameterCount() floats, be aligned to 64 bytes and outlive its use by the layer. Null moves them back into memory of the layer's own.
+		 * @param gradients Where to keep the gradients, laid out like the parameters, or null for the layer to keep them in memory of its own.
+		 */
+		virtual void bindParameters( float* parameters, float* gradients ) = 0;
+
+		/**
+		 * Refill anything derived from the parameters, such as reduced precision copies of the weights. Must be called after the parameters are changed from outside the layer.
+		 */
+		virtual void updateReducedCopies() {
+		}
+
+		/**
+		 * Get where the layer's parameters start among those of the network it is in, which locates the layer's optimizer state.
+		 * @return The offset of the layer's first parameter.
+		 */
+		std::size_t getParameterOffset() const {
+			return m_parameter_offset;
+		}
+
+		void setParameterOffset( std::size_t offset ) {
+			m_parameter_offset = offset;
+		}
+
+		/**
+		 * Compute the gradients of one sample and add them to the layer's gradient buffers, without changing its parameters. Stateful layers must be given each sample right after propagating it.
+		 * @param input The input to the layer for training on.
+		 * @param output The output of the layer being trained.
+		 * @param delta The error from the next layer for training on.
+		 * @param new_delta The vector to write the error for passing into the next layer into. Must match the input count and must not overlap the other arguments, or be empty when the error is not needed.
+		 */
+		void computeGradients( ConstVectorView input, ConstVectorView output, ConstVectorView delta, VectorView new_delta ) {
+			if( input.getDimension() != getInputCount() ) {
+				throw std::string( "Invalid input size to layer gradients" );
+			}
+
+			if( delta.getDimension() != getOutputCount() ) {
+				throw std::string( "Invalid delta size to layer gradients" );
+			}
+
+			if( output.getDimension() != getOutputCount() ) {
+				throw std::string( "Invalid output size to layer gradients" );
+			}
+
+			if( new_delta.data() && new_delta.getDimension() != getInputCount() ) {
+				throw std::string( "Invalid new delta size to layer gradients" );
+			}
+
+			computeGradientsInternal( input, output, delta, new_delta );
+			++m_gradient_samples;
+		}
+
+		/**
+		 * Compute the gradients of a batch of samples and add them to the layer's gradient buffers, without changing its parameters. Only valid for layers that are not stateful.
+		 * @param inputs The inputs to the layer for training on, one sample per row.
+		 * @param outputs The outputs of the layer being trained, one sample per row.
+		 * @param deltas The errors from the next layer for training on, one sample per row.
+		 * @param new_deltas The matrix to write the errors for passing into the next layer into, one sample per row, or an empty view when the errors are not needed.
+		 */
+		void computeGradientsBatch( ConstMatrixView inputs, ConstMatrixView outputs, ConstMatrixView deltas, MatrixView new_deltas ) {
+			const unsigned int batch_size = inputs.getHeight();
+
+			if( inputs.getWidth() != getInputCount() || outputs.getWidth() != getOutputCount() || deltas.getWidth() != getOutputCount() || outputs.getHeight() != batch_size || deltas.getHeight() != batch_size ) {
+				throw std::string( "Invalid batch size to layer gradients" );
+			}
+
+			if( new_deltas.data() && ( new_deltas.getWidth() != getInputCount() || new_deltas.getHeight() != batch_size ) ) {
+				throw std::string( "Invalid new delta batch size to layer gradients" );
+			}
+
+			computeGradientsBatchInternal( inputs, outputs, deltas, new_deltas );
+			m_gradient_samples += batch_size;
+		}
+
+		/**
+		 * Step the layer's parameters against the gradients added since the last step, averaged over the samples they came from, and clear them. Does nothing when no gradients have been added.
+		 * @param optimizer The update rule to step with. Its beginStep() must already have been called for this step.
+		 */
+		void applyGradients( Optimizer& optimizer ) {
+			if( m_gradient_samples == 0 ) {
+				return;
+			}
+
+			applyGradientsInternal( optimizer, 1.f / m_gradient_samples );
+			m_gradient_samples = 0;
+		}
+
+		/**
+		 * Record that the gradients were stepped and cleared from outside the layer, through the buffers given to bindParameters(), and refill anything derived from the parameters.
+		 */
+		void markGradientsApplied() {
+			m_gradient_samples = 0;
+			updateReducedCopies();
+		}
+
+		/**
+		 * Get the number of samples whose gradients are waiting to be applied.
+		 * @return The sample count.
+		 */
+		unsigned int getGradientSampleCount() const {
+			return m_gradient_samples;
+		}
+
+		/**
+		 * Whether the layer carries state from one sample to the next, so samples must be propagated and trained one at a time and in order.
+		 * @return True for recurrent layers.
+		 */
+		virtual bool isStateful() const {
+			return false;
+		}
+
+		/**
+		 * Propagate a batch of samples through the network layer. Layers without a batched path propagate the samples one at a time, in order.
+		 * @param inputs The input data to propagate, one sample per row.
+		 * @param outputs The matrix to write the outputs of the network layer into, one sample per row. Must have a row per input and match the output count.
+		 */
+		virtual void propagateBatch( ConstMatrixView inputs, MatrixView outputs ) {
+			if( inputs.getWidth() != getInputCount() || outputs.getWidth() != getOutputCount() || inputs.getHeight() != outputs.getHeight() ) {
+				throw std::string( "Invalid batch size to layer propagation" );
+			}
+
+			for( unsigned int b = 0; b < inputs.getHeight(); ++b ) {
+				propagate( ConstVectorView( inputs.row( b ), getInputCount() ), VectorView( outputs.row( b ), getOutputCount() ) );
+			}
+		}
+
+		/**
+		 * Train the network layer on a batch of samples, making one update from the error averaged over the batch. Layers without a batched path accumulate the gradients of the samples one at a time, which is only valid for layers that are not stateful.
+		 * @param inputs The inputs to the layer for training on, one sample per row.
+		 * @param outputs The outputs of the layer being trained, one sample per row.
+		 * @param deltas The errors from the next layer for training on, one sample per row.
+		 * @param new_deltas The matrix to write the errors for passing into the next layer into, one sample per row, or an empty view when the errors are not needed.
+		 * @param mutability The rate at which the layer is allowed to change.
+		 */
+		virtual void trainBatch( ConstMatrixView inputs, ConstMatrixView outputs, ConstMatrixView deltas, MatrixView new_deltas, float mutability = 0.05f ) {
+			const unsigned int batch_size = inputs.getHeight();
+
+			if( inputs.getWidth() != getInputCount() || outputs.getWidth() != getOutputCount() || deltas.getWidth() != getOutputCount() || outputs.getHeight() != batch_size || deltas.getHeight() != batch_size ) {
+				throw std::string( "Invalid batch size to layer training" );
+			}
+
+			if( new_deltas.data() && ( new_deltas.getWidth() != getInputCount() || new_deltas.getHeight() != batch_size ) ) {
+				throw std::string( "Invalid new delta batch size to layer training" );
+			}
+
+			// A single sample gets the same step from train(), which reads the weights once instead of accumulating and then applying
+			if( batch_size == 1 ) {
+				VectorView new_delta = new_deltas.data() ? VectorView( new_deltas.row( 0 ), getInputCount() ) : VectorView();
+				train( ConstVectorView( inputs.row( 0 ), getInputCount() ), ConstVectorView( outputs.row( 0 ), getOutputCount() ), ConstVectorView( deltas.row( 0 ), getOutputCount() ), new_delta, mutability );
+				return;
+			}
+
+			for( unsigned int b = 0; b < batch_size; ++b ) {
+				VectorView new_delta = new_deltas.data() ? VectorView( new_deltas.row( b ), getInputCount() ) : VectorView();
+				computeGradients( ConstVectorView( inputs.row( b ), getInputCount() ), ConstVectorView( outputs.row( b ), getOutputCount() ), ConstVectorView( deltas.row( b ), getOutputCount() ), new_delta );
+			}
+
+			SGDOptimizer optimizer( mutability );
+			optimizer.beginStep( getParameterCount() );
+			applyGradients( optimizer );
+		}
 
 		/**
 		 * Reset the state of the layer.
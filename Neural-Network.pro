@@ -2,18 +2,47 @@ TEMPLATE = app
 CONFIG += console c++14
 CONFIG -= app_bundle
 CONFIG -= qt
+QMAKE_CXXFLAGS += -fopenmp
 LIBS += -lsfml-audio -fopenmp
 
+# Bounds-check Matrix and Vector accesses in debug builds
+CONFIG(debug, debug|release): DEFINES += NN_BOUNDS_CHECK
+
 SOURCES += \
 	jsoncpp.cpp \
     Audio.cpp
 
 HEADERS += \
+    ActivationKernels.hpp \
+    AlignedBuffer.hpp \
+    Arena.hpp \
+    Benchmark.hpp \
+    CPUFeatures.hpp \
+    ComplexBuffer.hpp \
     NetworkLayer.hpp \
     Vector.hpp \
+    VectorExpression.hpp \
+    VectorView.hpp \
     Matrix.hpp \
+    MatrixView.hpp \
     FeedForwardLayer.hpp \
+    FixedFeedForwardLayer.hpp \
+    FixedMatrix.hpp \
+    FixedVector.hpp \
+    GEMMKernels.hpp \
+    HalfKernels.hpp \
+    HalfPrecision.hpp \
+    HugePages.hpp \
+    MatrixKernels.hpp \
     NeuralNetwork.hpp \
+    NumaTopology.hpp \
+    Optimizer.hpp \
+    OptimizerKernels.hpp \
+    QuantizedKernels.hpp \
+    QuantizedMatrix.hpp \
+    SparseKernels.hpp \
+    SparseMatrix.hpp \
+    Spectrogram.hpp \
     LSTMLayer.hpp \
     FFT.hpp \
     json/json-forwards.h \
@@ -1,17 +1,166 @@
 #ifndef NEURALNETWORK_HPP
 #define NEURALNETWORK_HPP
 
+#include <cstring>
 #include <memory>
+#include <vector>
 #include "json/json.h"
+#include "AlignedBuffer.hpp"
+#include "Arena.hpp"
 #include "NetworkLayer.hpp"
 #include "FeedForwardLayer.hpp"
+#include "FixedFeedForwardLayer.hpp"
 #include "LSTMLayer.hpp"
+#include "Optimizer.hpp"
 
 class NeuralNetwork {
 	private:
 		std::vector< std::shared_ptr< NetworkLayer > > m_layers;
 
+		// Scratch memory shared by all layers, reset after every step
+		Arena m_arena;
+
+		// m_results[ i ] is the output of layer i and m_deltas[ i ] the error at its input, kept between steps to reuse their storage
+		std::vector< Vector > m_results;
+		std::vector< Vector > m_deltas;
+
+		// The views of each layer's batch outputs during a batched training step, kept to reuse the vector's storage
+		std::vector< MatrixView > m_batch_results;
+
+		// Every layer's parameters, and optionally gradients, each layer's starting at its parameter offset
+		AlignedBuffer< float > m_parameters;
+		AlignedBuffer< float > m_gradients;
+		bool m_flat_gradients;
+
+		/**
+		 * Size the per-layer buffers to the current layers. Does nothing once they fit, so steady state steps allocate no vectors.
+		 */
+		void allocateBuffers() {
+			m_results.resize( m_layers.size() );
+			m_deltas.resize( m_layers.size() );
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				m_results[ i ].setDimension( m_layers[ i ]->getOutputCount() );
+				m_deltas[ i ].setDimension( m_layers[ i ]->getInputCount() );
+			}
+		}
+
+		/**
+		 * Lay every layer's parameters out one after another in a single flat buffer, and their gradients in a second one when flat gradients are on, and move the layers onto them. Must be called whenever a layer's parameter count changes.
+		 */
+		void packParameters() {
+			std::size_t count = 0;
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				m_layers[ i ]->setParameterOffset( count );
+				count += m_layers[ i ]->getParameterCount();
+			}
+
+			// The gaps between runs are zeroed here and never written again
+			AlignedBuffer< float > parameters;
+			parameters.setHugePages( isHugePageMode() );
+			parameters.resize( count );
+			parameters.clear();
+
+			AlignedBuffer< float > gradients;
+			if( m_flat_gradients ) {
+				gradients.setHugePages( isHugePageMode() );
+				gradients.resize( count );
+				gradients.clear();
+			}
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				const std::size_t offset = m_layers[ i ]->getParameterOffset();
+				m_layers[ i ]->bindParameters( parameters.data() + offset, m_flat_gradients ? gradients.data() + offset : nullptr );
+			}
+
+			// Only now that the layers have copied themselves out can the old buffers go
+			m_parameters = std::move( parameters );
+			m_gradients = std::move( gradients );
+		}
+
+		/**
+		 * Replace every fixed size layer with a FeedForwardLayer holding the same weights, so that reduced precision and pruning reach all of the network.
+		 */
+		void generalizeFixedSizeLayers() {
+			bool replaced = false;
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				if( !m_layers[ i ]->isFixedSize() ) {
+					continue;
+				}
+
+				Json::Value layer_value = m_layers[ i ]->saveToJSON();
+				FeedForwardLayer* layer = new FeedForwardLayer;
+				layer->loadFromJSON( layer_value );
+				layer->setArena( &m_arena );
+				m_layers[ i ].reset( layer );
+				replaced = true;
+			}
+
+			if( replaced ) {
+				packParameters();
+			}
+		}
+
+		/**
+		 * Whether any layer carries state from one sample to the next, so batches must be trained a sample at a time.
+		 * @return True if a layer is stateful.
+		 */
+		bool hasStatefulLayers() const {
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				if( m_layers[ i ]->isStateful() ) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		/**
+		 * Propagate a batch for a training step, keeping every layer's outputs in m_batch_results for the backward pass. The outputs and errors live in the arena until it is reset.
+		 * @param inputs The inputs to the neural network, one sample per row.
+		 * @param outputs The expected outputs of the neural network, one sample per row.
+		 * @param output_deltas Set to the error at the network's output, one sample per row.
+		 * @return The loss summed over the batch.
+		 */
+		float propagateTrainingBatch( ConstMatrixView inputs, ConstMatrixView outputs, MatrixView& output_deltas ) {
+			const unsigned int batch_size = inputs.getHeight();
+			std::vector< MatrixView >& results = m_batch_results;
+			results.resize( m_layers.size() );
+
+			ConstMatrixView layer_inputs = inputs;
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				results[ i ] = m_arena.allocateMatrix( batch_size, m_layers[ i ]->getOutputCount() );
+				m_layers[ i ]->propagateBatch( layer_inputs, results[ i ] );
+				layer_inputs = results[ i ];
+			}
+
+			const unsigned int output_count = outputs.getWidth();
+			output_deltas = m_arena.allocateMatrix( batch_size, output_count );
+
+			float loss = 0.f;
+			for( unsigned int b = 0; b < batch_size; ++b ) {
+				const float* result = results.back().row( b );
+				const float* expected = outputs.row( b );
+				float* delta = output_deltas.row( b );
+
+				for( unsigned int x = 0; x < output_count; ++x ) {
+					delta[ x ] = result[ x ] - expected[ x ];
+					loss += 0.5f * delta[ x ] * delta[ x ];
+				}
+			}
+
+			return loss;
+		}
+
+		NeuralNetwork( const NeuralNetwork& ) = delete;
+		NeuralNetwork& operator=( const NeuralNetwork& ) = delete;
+
 	public:
+		NeuralNetwork() : m_flat_gradients( false ) {
+		}
+
 		void loadFromJSON( Json::Value& layer_array ) {
 			m_layers.clear();
 
@@ -19,7 +168,17 @@ class NeuralNetwork {
 				NetworkLayer* layer = nullptr;
 
 				if( layer_array[ i ][ "type" ].asString() == std::string( "feedforward" ) || layer_array[ i ][ "type" ].asString() == std::string( "feed-forward" ) ) {
-					layer = new FeedForwardLayer;
+					// Prefer a layer specialized for this exact size when one is compiled in, unless it was pruned or reads reduced precision weights, which only the general layer supports
+					const bool sparse = layer_array[ i ][ "data" ].get( "sparse", false ).asBool();
+					const bool reduced = parsePrecisionName( layer_array[ i ].get( "precision", "float32" ).asString() ) != WeightPrecision::Float32;
+
+					if( !sparse && !reduced ) {
+						layer = PrecompiledFeedForwardLayers::create( layer_array[ i ][ "inputs" ].asUInt(), layer_array[ i ][ "outputs" ].asUInt() );
+					}
+
+					if( layer == nullptr ) {
+						layer = new FeedForwardLayer;
+					}
 				} else if( layer_array[ i ][ "type" ].asString() == std::string( "lstm" ) ) {
 					layer = new LSTMLayer;
 				}
@@ -49,30 +208,63 @@ class NeuralNetwork {
 		 * @param layer The layer to add to the network. Number of inputs may be adjusted for compatability with the network.
 		 */
 		void addLayer( NetworkLayer* layer ) {
-			if( !m_layers.empty() ) {
+			// Resizing reinitializes the weights, so leave loaded layers that already fit alone
+			if( !m_layers.empty() && layer->getInputCount() != m_layers.back()->getOutputCount() ) {
 				layer->setInputCount( m_layers.back()->getOutputCount() );
 			}
 
+			layer->setArena( &m_arena );
+
 			m_layers.emplace_back( layer );
+			packParameters();
+		}
+
+		unsigned int getInputCount() const {
+			return m_layers.front()->getInputCount();
+		}
+
+		unsigned int getOutputCount() const {
+			return m_layers.back()->getOutputCount();
 		}
 
 		/**
-		 * Propagate data through the neural network.
+		 * Propagate data through the neural network into a caller's buffer.
 		 * @param input The data to propagate through the network.
-		 * @return The output of the neural network.
+		 * @param output The vector to write the output of the neural network into. Must match the output count of the last layer.
 		 */
-		Vector propagate( Vector input ) {
+		void propagate( ConstVectorView input, VectorView output ) {
 			if( input.getDimension() != m_layers.front()->getInputCount() ) {
 				throw std::string( "Invalid input size to network propagation" );
 			}
 
-			Vector data = input;
+			if( output.getDimension() != m_layers.back()->getOutputCount() ) {
+				throw std::string( "Invalid output size to network propagation" );
+			}
+
+			allocateBuffers();
 
-			for( auto& layer : m_layers ) {
-				data = layer->propagate( data );
+			// Intermediate results go to the preallocated buffers and the last layer writes straight into the output
+			ConstVectorView layer_input = input;
+			for( unsigned int i = 0; i + 1 < m_layers.size(); ++i ) {
+				m_layers[ i ]->propagate( layer_input, m_results[ i ] );
+				layer_input = m_results[ i ];
 			}
 
-			return data;
+			m_layers.back()->propagate( layer_input, output );
+
+			m_arena.reset();
+		}
+
+		/**
+		 * Propagate data through the neural network.
+		 * @param input The data to propagate through the network.
+		 * @return The output of the neural network.
+		 */
+		Vector propagate( ConstVectorView input ) {
+			Vector output;
+			output.setDimension( m_layers.back()->getOutputCount() );
+			propagate( input, output );
+			return output;
 		}
 
 		/**
@@ -82,7 +274,7 @@ class NeuralNetwork {
 		 * @param mutability The rate at which the network is allowed to adjust.
 		 * @return The loss on the sample.
 		 */
-		float train( Vector input, Vector output, float mutability = 0.05f ) {
+		float train( ConstVectorView input, ConstVectorView output, float mutability = 0.05f ) {
 			if( input.getDimension() != m_layers.front()->getInputCount() ) {
 				throw std::string( "Invalid input size to network training" );
 			}
@@ -91,34 +283,373 @@ class NeuralNetwork {
 				throw std::string( "Invalid output size to network training" );
 			}
 
-			std::vector< Vector > results( m_layers.size() + 1 );
-			results[ 0 ] = input;
+			allocateBuffers();
 
-			// Go forward to get the results
+			// Go forward to get the results, the input of layer 0 is read in place
+			ConstVectorView layer_input = input;
 			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
-				results[ i + 1 ] = m_layers[ i ]->propagate( results[ i ] );
+				m_layers[ i ]->propagate( layer_input, m_results[ i ] );
+				layer_input = m_results[ i ];
 			}
 
-			Vector delta;
-			delta.setDimension( output.getDimension() );
+			VectorView output_delta = m_arena.allocateVector( output.getDimension() );
+			output_delta.assign( m_results.back() - output );
+
+			// Go backwards to train, nothing needs the error at the network's input so layer 0 skips computing it
+			ConstVectorView layer_delta = output_delta;
+			for( int i = m_layers.size() - 1; i >= 0; --i ) {
+				ConstVectorView train_input = i == 0 ? input : ConstVectorView( m_results[ i - 1 ] );
+				m_layers[ i ]->train( train_input, m_results[ i ], layer_delta, i == 0 ? VectorView() : VectorView( m_deltas[ i ] ), mutability );
+				layer_delta = m_deltas[ i ];
+			}
+
+			float loss = 0.f;
 			for( unsigned int i = 0; i < output.getDimension(); ++i ) {
-				delta( i ) = results[ m_layers.size() ]( i ) - output( i );
+				float error = output( i ) - m_results.back()( i );
+				loss += 0.5f * error * error;
 			}
 
-			// Go backwards to train
+			m_arena.reset();
+
+			return loss;
+		}
+
+		/**
+		 * Compute the gradients of the loss on a sample and add them to every layer's gradient buffers, leaving the parameters unchanged until applyGradients() is called.
+		 * @param input The input to the neural network.
+		 * @param output The expected output of the neural network.
+		 * @return The loss on the sample.
+		 */
+		float computeGradients( ConstVectorView input, ConstVectorView output ) {
+			if( input.getDimension() != m_layers.front()->getInputCount() ) {
+				throw std::string( "Invalid input size to network gradients" );
+			}
+
+			if( output.getDimension() != m_layers.back()->getOutputCount() ) {
+				throw std::string( "Invalid output size to network gradients" );
+			}
+
+			allocateBuffers();
+
+			ConstVectorView layer_input = input;
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				m_layers[ i ]->propagate( layer_input, m_results[ i ] );
+				layer_input = m_results[ i ];
+			}
+
+			VectorView output_delta = m_arena.allocateVector( output.getDimension() );
+			output_delta.assign( m_results.back() - output );
+
+			ConstVectorView layer_delta = output_delta;
 			for( int i = m_layers.size() - 1; i >= 0; --i ) {
-				delta = m_layers[ i ]->train( results[ i ], results[ i + 1 ], delta, mutability );
+				ConstVectorView gradient_input = i == 0 ? input : ConstVectorView( m_results[ i - 1 ] );
+				m_layers[ i ]->computeGradients( gradient_input, m_results[ i ], layer_delta, i == 0 ? VectorView() : VectorView( m_deltas[ i ] ) );
+				layer_delta = m_deltas[ i ];
 			}
 
 			float loss = 0.f;
 			for( unsigned int i = 0; i < output.getDimension(); ++i ) {
-				float error = output( i ) - results.back()( i );
+				float error = output( i ) - m_results.back()( i );
 				loss += 0.5f * error * error;
 			}
 
+			m_arena.reset();
+
 			return loss;
 		}
 
+		/**
+		 * Step every layer's parameters against the gradients computed since the last step, averaged over their samples. With flat gradients the optimizer steps every parameter in a single pass.
+		 * @param optimizer The update rule to step with.
+		 */
+		void applyGradients( Optimizer& optimizer ) {
+			// Every layer has seen the same samples, as computeGradients() passes each through all of them
+			const unsigned int samples = m_layers.empty() ? 0 : m_layers.front()->getGradientSampleCount();
+
+			if( samples == 0 ) {
+				return;
+			}
+
+			optimizer.beginStep( m_parameters.size() );
+
+			if( m_flat_gradients ) {
+				// The gaps between runs have zero gradients, which every rule leaves at zero
+				optimizer.update( 0, m_parameters.data(), m_gradients.data(), m_parameters.size(), 1.f / samples );
+				m_gradients.clear();
+
+				for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+					m_layers[ i ]->markGradientsApplied();
+				}
+
+				return;
+			}
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				m_layers[ i ]->applyGradients( optimizer );
+			}
+		}
+
+		/**
+		 * Train the neural network on a batch of samples with an update rule, stepping once from the gradients averaged over the batch. The gradients of the whole batch are computed together, except in networks with stateful layers, whose samples pass through one at a time in row order.
+		 * @param inputs The inputs to the neural network, one sample per row.
+		 * @param outputs The expected outputs of the neural network, one sample per row.
+		 * @param optimizer The update rule to step with.
+		 * @return The loss summed over the batch.
+		 */
+		float trainBatch( ConstMatrixView inputs, ConstMatrixView outputs, Optimizer& optimizer ) {
+			const unsigned int batch_size = inputs.getHeight();
+
+			if( inputs.getWidth() != m_layers.front()->getInputCount() ) {
+				throw std::string( "Invalid input size to network training" );
+			}
+
+			if( outputs.getWidth() != m_layers.back()->getOutputCount() || outputs.getHeight() != batch_size ) {
+				throw std::string( "Invalid output size to network training" );
+			}
+
+			float loss = 0.f;
+
+			if( hasStatefulLayers() ) {
+				for( unsigned int b = 0; b < batch_size; ++b ) {
+					loss += computeGradients( ConstVectorView( inputs.row( b ), inputs.getWidth() ), ConstVectorView( outputs.row( b ), outputs.getWidth() ) );
+				}
+
+				applyGradients( optimizer );
+
+				return loss;
+			}
+
+			MatrixView output_deltas;
+			loss = propagateTrainingBatch( inputs, outputs, output_deltas );
+
+			// Go backwards adding up the gradients, nothing needs the error at the network's input so layer 0 skips computing it
+			ConstMatrixView layer_deltas = output_deltas;
+			for( int i = m_layers.size() - 1; i >= 0; --i ) {
+				ConstMatrixView gradient_inputs = i == 0 ? inputs : ConstMatrixView( m_batch_results[ i - 1 ] );
+				MatrixView new_deltas = i == 0 ? MatrixView() : m_arena.allocateMatrix( batch_size, m_layers[ i ]->getInputCount() );
+				m_layers[ i ]->computeGradientsBatch( gradient_inputs, m_batch_results[ i ], layer_deltas, new_deltas );
+				layer_deltas = new_deltas;
+			}
+
+			m_arena.reset();
+
+			applyGradients( optimizer );
+
+			return loss;
+		}
+
+		/**
+		 * Get the number of learnable parameters in the network, counting the padding of matrix rows and of each run of parameters out to a 64 byte boundary.
+		 * @return The parameter count.
+		 */
+		std::size_t getParameterCount() const {
+			std::size_t count = 0;
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				count += m_layers[ i ]->getParameterCount();
+			}
+
+			return count;
+		}
+
+		/**
+		 * Get where each layer's parameters start, followed by the total parameter count. Optimizer state lines up with the parameters of any network with the same layout.
+		 * @return The offset of each layer's parameters, then the parameter count.
+		 */
+		std::vector< std::size_t > getParameterLayout() const {
+			std::vector< std::size_t > layout;
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				layout.push_back( m_layers[ i ]->getParameterOffset() );
+			}
+
+			layout.push_back( m_parameters.size() );
+
+			return layout;
+		}
+
+		/**
+		 * Get the flat buffer every layer keeps its parameters in. A snapshot of the model is a copy of getParameterCount() floats from here.
+		 * @return The parameters, aligned to 64 bytes.
+		 */
+		const float* getParameters() const {
+			return m_parameters.data();
+		}
+
+		/**
+		 * Overwrite every parameter from a snapshot taken through getParameters(), in one copy.
+		 * @param values The snapshot, holding getParameterCount() floats. The network's layers must not have changed since it was taken.
+		 */
+		void setParameters( const float* values ) {
+			std::memcpy( m_parameters.data(), values, m_parameters.size() * sizeof( float ) );
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				m_layers[ i ]->updateReducedCopies();
+			}
+		}
+
+		/**
+		 * Get the flat buffer every layer keeps its gradients in, laid out like the parameters.
+		 * @return The gradients, or null if flat gradients are off.
+		 */
+		float* getGradients() {
+			return m_flat_gradients ? m_gradients.data() : nullptr;
+		}
+
+		bool hasFlatGradients() const {
+			return m_flat_gradients;
+		}
+
+		/**
+		 * Set whether the layers keep their gradients in one flat buffer laid out like the parameters, rather than in buffers of their own. Pending gradients carry over either way.
+		 * @param enabled Whether to use flat gradients.
+		 */
+		void setFlatGradients( bool enabled ) {
+			m_flat_gradients = enabled;
+			packParameters();
+		}
+
+		/**
+		 * Propagate a batch of samples through the neural network into a caller's buffer. Samples pass through stateful layers in row order.
+		 * @param inputs The data to propagate through the network, one sample per row.
+		 * @param outputs The matrix to write the outputs of the neural network into, one sample per row. Must have a row per input and match the output count of the last layer.
+		 */
+		void propagateBatch( ConstMatrixView inputs, MatrixView outputs ) {
+			if( inputs.getWidth() != m_layers.front()->getInputCount() ) {
+				throw std::string( "Invalid input size to network propagation" );
+			}
+
+			if( outputs.getWidth() != m_layers.back()->getOutputCount() || outputs.getHeight() != inputs.getHeight() ) {
+				throw std::string( "Invalid output size to network propagation" );
+			}
+
+			// Intermediate batches live in the arena for the length of the step
+			ConstMatrixView layer_inputs = inputs;
+			for( unsigned int i = 0; i + 1 < m_layers.size(); ++i ) {
+				MatrixView layer_outputs = m_arena.allocateMatrix( inputs.getHeight(), m_layers[ i ]->getOutputCount() );
+				m_layers[ i ]->propagateBatch( layer_inputs, layer_outputs );
+				layer_inputs = layer_outputs;
+			}
+
+			m_layers.back()->propagateBatch( layer_inputs, outputs );
+
+			m_arena.reset();
+		}
+
+		/**
+		 * Train the neural network on a batch of samples, updating each layer once from the error averaged over the batch. Networks with stateful layers train on the samples one at a time, in row order.
+		 * @param inputs The inputs to the neural network, one sample per row.
+		 * @param outputs The expected outputs of the neural network, one sample per row.
+		 * @param mutability The rate at which the network is allowed to adjust.
+		 * @return The loss summed over the batch.
+		 */
+		float trainBatch( ConstMatrixView inputs, ConstMatrixView outputs, float mutability = 0.05f ) {
+			const unsigned int batch_size = inputs.getHeight();
+
+			if( inputs.getWidth() != m_layers.front()->getInputCount() ) {
+				throw std::string( "Invalid input size to network training" );
+			}
+
+			if( outputs.getWidth() != m_layers.back()->getOutputCount() || outputs.getHeight() != batch_size ) {
+				throw std::string( "Invalid output size to network training" );
+			}
+
+			if( hasStatefulLayers() ) {
+				float loss = 0.f;
+
+				for( unsigned int b = 0; b < batch_size; ++b ) {
+					loss += train( ConstVectorView( inputs.row( b ), inputs.getWidth() ), ConstVectorView( outputs.row( b ), outputs.getWidth() ), mutability );
+				}
+
+				return loss;
+			}
+
+			MatrixView output_deltas;
+			float loss = propagateTrainingBatch( inputs, outputs, output_deltas );
+
+			// Go backwards to train, nothing needs the error at the network's input so layer 0 skips computing it
+			ConstMatrixView layer_deltas = output_deltas;
+			for( int i = m_layers.size() - 1; i >= 0; --i ) {
+				ConstMatrixView train_inputs = i == 0 ? inputs : ConstMatrixView( m_batch_results[ i - 1 ] );
+				MatrixView new_deltas = i == 0 ? MatrixView() : m_arena.allocateMatrix( batch_size, m_layers[ i ]->getInputCount() );
+				m_layers[ i ]->trainBatch( train_inputs, m_batch_results[ i ], layer_deltas, new_deltas, mutability );
+				layer_deltas = new_deltas;
+			}
+
+			m_arena.reset();
+
+			return loss;
+		}
+
+		/**
+		 * Get the scratch memory usage of the most recent training or propagation step.
+		 * @return The statistics of the network's arena for that step.
+		 */
+		const ArenaStatistics& getStepStatistics() const {
+			return m_arena.getStepStatistics();
+		}
+
+		/**
+		 * Get the precision the network's weights are read in during propagation.
+		 * @return The reduced precision used by the layers that support one, or Float32 if none are reduced.
+		 */
+		WeightPrecision getWeightPrecision() const {
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				if( m_layers[ i ]->getWeightPrecision() != WeightPrecision::Float32 ) {
+					return m_layers[ i ]->getWeightPrecision();
+				}
+			}
+
+			return WeightPrecision::Float32;
+		}
+
+		/**
+		 * Set the precision every layer's weights are read in during propagation.
+		 * @param precision The weight precision to use.
+		 */
+		void setWeightPrecision( WeightPrecision precision ) {
+			if( precision != WeightPrecision::Float32 ) {
+				generalizeFixedSizeLayers();
+			}
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				m_layers[ i ]->setWeightPrecision( precision );
+			}
+		}
+
+		ActivationAccuracy getActivationAccuracy() const {
+			return m_layers.empty() ? ActivationAccuracy::Exact : m_layers.front()->getActivationAccuracy();
+		}
+
+		/**
+		 * Set how closely every layer's activation functions follow libm.
+		 * @param accuracy The accuracy tier to use.
+		 */
+		void setActivationAccuracy( ActivationAccuracy accuracy ) {
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				m_layers[ i ]->setActivationAccuracy( accuracy );
+			}
+		}
+
+		/**
+		 * Prune every layer's small weights.
+		 * @param threshold The magnitude below which weights are dropped.
+		 * @return The fraction of each layer's weights still stored, in layer order.
+		 */
+		std::vector< float > prune( float threshold ) {
+			std::vector< float > densities;
+
+			generalizeFixedSizeLayers();
+
+			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
+				densities.push_back( m_layers[ i ]->prune( threshold ) );
+			}
+
+			packParameters();
+
+			return densities;
+		}
+
 		void resetState() {
 			for( unsigned int i = 0; i < m_layers.size(); ++i ) {
 				m_layers[ i ]->resetState();
@@ -0,0 +1,188 @@
+#ifndef NUMATOPOLOGY_HPP
+#define NUMATOPOLOGY_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * The NUMA nodes of the machine and the CPUs attached to each, read once from /sys. Machines without NUMA information are treated as a single node holding every CPU.
+ */
+class NumaTopology {
+	private:
+		std::vector< std::vector< int > > m_node_cpus;
+
+		/**
+		 * Parse a kernel CPU list such as "0-3,8-11".
+		 * @param list The list to parse.
+		 * @return The CPUs in the list.
+		 */
+		static std::vector< int > parseCPUList( const std::string& list ) {
+			std::vector< int > cpus;
+			std::stringstream stream( list );
+			std::string range;
+
+			while( std::getline( stream, range, ',' ) ) {
+				int first = 0;
+				int last = 0;
+				const int fields = std::sscanf( range.c_str(), "%d-%d", &first, &last );
+
+				if( fields == 1 ) {
+					last = first;
+				} else if( fields != 2 ) {
+					continue;
+				}
+
+				for( int cpu = first; cpu <= last; ++cpu ) {
+					cpus.push_back( cpu );
+				}
+			}
+
+			return cpus;
+		}
+
+		NumaTopology() {
+#ifdef __linux__
+			std::ifstream online( "/sys/devices/system/node/online" );
+			std::string node_list;
+
+			if( online && std::getline( online, node_list ) ) {
+				std::vector< int > nodes = parseCPUList( node_list );
+
+				for( unsigned int i = 0; i < nodes.size(); ++i ) {
+					std::ifstream cpu_file( "/sys/devices/system/node/node" + std::to_string( nodes[ i ] ) + "/cpulist" );
+					std::string cpu_list;
+
+					// Memory-only nodes have no CPUs to run on and are left out
+					if( cpu_file && std::getline( cpu_file, cpu_list ) ) {
+						std::vector< int > cpus = parseCPUList( cpu_list );
+						if( !cpus.empty() ) {
+							m_node_cpus.push_back( cpus );
+						}
+					}
+				}
+			}
+#endif
+
+			if( m_node_cpus.empty() ) {
+				const unsigned int cpu_count = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+				m_node_cpus.push_back( std::vector< int >() );
+				for( unsigned int cpu = 0; cpu < cpu_count; ++cpu ) {
+					m_node_cpus.back().push_back( static_cast< int >( cpu ) );
+				}
+			}
+		}
+
+	public:
+		/**
+		 * Get the topology of the machine the program is running on. Read once on first use.
+		 * @return The detected topology.
+		 */
+		static const NumaTopology& get() {
+			static const NumaTopology topology;
+			return topology;
+		}
+
+		unsigned int getNodeCount() const {
+			return static_cast< unsigned int >( m_node_cpus.size() );
+		}
+
+		const std::vector< int >& getNodeCPUs( unsigned int node ) const {
+			return m_node_cpus[ node ];
+		}
+
+		/**
+		 * Get the node a kernel thread runs on. Threads are spread over the nodes in order, so the contiguous row chunks the kernels hand out are sharded across the nodes in order too.
+		 * @param thread The index of the thread in its team.
+		 * @param threads The size of the team.
+		 * @return The index of the node.
+		 */
+		unsigned int getThreadNode( int thread, int threads ) const {
+			return static_cast< unsigned int >( static_cast< std::size_t >( thread ) * m_node_cpus.size() / threads );
+		}
+
+		/**
+		 * Get the CPU a kernel thread is pinned to.
+		 * @param thread The index of the thread in its team.
+		 * @param threads The size of the team.
+		 * @return The CPU number.
+		 */
+		int getThreadCPU( int thread, int threads ) const {
+			const unsigned int node = getThreadNode( thread, threads );
+
+			// The first team index that maps onto this node
+			int first = 0;
+			while( getThreadNode( first, threads ) != node ) {
+				++first;
+			}
+
+			const std::vector< int >& cpus = m_node_cpus[ node ];
+			return cpus[ static_cast< std::size_t >( thread - first ) % cpus.size() ];
+		}
+};
+
+/**
+ * Restrict the calling thread to a set of CPUs.
+ * @param cpus The CPUs the thread may run on.
+ * @return Whether the affinity was set. Always false off Linux.
+ */
+bool setThreadAffinity( const std::vector< int >& cpus ) {
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO( &set );
+	for( unsigned int i = 0; i < cpus.size(); ++i ) {
+		if( cpus[ i ] >= 0 && cpus[ i ] < CPU_SETSIZE ) {
+			CPU_SET( cpus[ i ], &set );
+		}
+	}
+
+	return sched_setaffinity( 0, sizeof( set ), &set ) == 0;
+#else
+	static_cast< void >( cpus );
+	return false;
+#endif
+}
+
+/**
+ * Find the NUMA node each page of a buffer is resident on.
+ * @param values The start of the buffer.
+ * @param bytes The length of the buffer in bytes.
+ * @return The node of each page of the buffer, negative for pages not yet touched, or empty if the kernel cannot be asked.
+ */
+std::vector< int > getPageNodes( const void* values, std::size_t bytes ) {
+	std::vector< int > nodes;
+
+#if defined( __linux__ ) && defined( SYS_move_pages )
+	const std::uintptr_t page_size = static_cast< std::uintptr_t >( sysconf( _SC_PAGESIZE ) );
+	const std::uintptr_t start = reinterpret_cast< std::uintptr_t >( values ) & ~( page_size - 1 );
+	const std::uintptr_t end = reinterpret_cast< std::uintptr_t >( values ) + bytes;
+
+	std::vector< void* > pages;
+	for( std::uintptr_t page = start; page < end; page += page_size ) {
+		pages.push_back( reinterpret_cast< void* >( page ) );
+	}
+
+	// With no target nodes, move_pages only reports where each page is
+	nodes.resize( pages.size() );
+	if( pages.empty() || syscall( SYS_move_pages, 0, static_cast< unsigned long >( pages.size() ), pages.data(), nullptr, nodes.data(), 0 ) != 0 ) {
+		nodes.clear();
+	}
+#else
+	static_cast< void >( values );
+	static_cast< void >( bytes );
+#endif
+
+	return nodes;
+}
+
+#endif // NUMATOPOLOGY_HPP
@@ -0,0 +1,405 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include "json/json.h"
+#include "AlignedBuffer.hpp"
+#include "HugePages.hpp"
+#include "OptimizerKernels.hpp"
+
+/**
+ * An update rule that steps a model's parameters against the gradients of its loss. Layers hand their parameters over in runs, each located by its offset among all of the model's parameters, so rules that keep per-parameter state can find it. A network with flat gradients hands over all of its parameters as a single run.
+ */
+class Optimizer {
+	private:
+		float m_rate;
+
+	protected:
+		virtual std::string getJSONTypeName() const = 0;
+		virtual void loadFromJSONInternal( Json::Value& data_value ) = 0;
+		virtual Json::Value saveToJSONInternal() const = 0;
+
+		/**
+		 * Resize a per-parameter state buffer, keeping the values that still fit and zeroing the rest.
+		 * @param state The state buffer.
+		 * @param size The new number of parameters it covers.
+		 */
+		static void resizeState( AlignedBuffer< float >& state, std::size_t size ) {
+			AlignedBuffer< float > resized;
+			resized.setHugePages( isHugePageMode() );
+			resized.resize( size );
+			resized.clear();
+
+			const std::size_t kept = std::min( size, state.size() );
+			if( kept != 0 ) {
+				std::memcpy( resized.data(), state.data(), kept * sizeof( float ) );
+			}
+
+			state = std::move( resized );
+		}
+
+		/**
+		 * Get the per-parameter state of a run, growing the buffer with zeros when the run lies past its end.
+		 * @param state The state buffer.
+		 * @param offset The index of the run's first parameter.
+		 * @param count The number of parameters in the run.
+		 * @return The state of the run's first parameter.
+		 */
+		static float* getState( AlignedBuffer< float >& state, std::size_t offset, std::size_t count ) {
+			if( offset + count > state.size() ) {
+				resizeState( state, offset + count );
+			}
+
+			return state.data() + offset;
+		}
+
+		static Json::Value saveState( const AlignedBuffer< float >& state ) {
+			Json::Value values( Json::arrayValue );
+			values.resize( state.size() );
+
+			for( unsigned int i = 0; i < state.size(); ++i ) {
+				values[ i ] = state[ i ];
+			}
+
+			return values;
+		}
+
+		static void loadState( Json::Value& values, AlignedBuffer< float >& state ) {
+			state.setHugePages( isHugePageMode() );
+			state.resize( values.size() );
+
+			for( unsigned int i = 0; i < values.size(); ++i ) {
+				state[ i ] = values[ i ].asFloat();
+			}
+		}
+
+	public:
+		Optimizer( float rate ) : m_rate( rate ) {
+		}
+
+		virtual ~Optimizer() {
+		}
+
+		float getRate() const {
+			return m_rate;
+		}
+
+		void setRate( float rate ) {
+			m_rate = rate;
+		}
+
+		void loadFromJSON( Json::Value& optimizer_value ) {
+			setRate( optimizer_value.get( "rate", getRate() ).asFloat() );
+			loadFromJSONInternal( optimizer_value[ "data" ] );
+		}
+
+		Json::Value saveToJSON() const {
+			Json::Value optimizer_object( Json::objectValue );
+			optimizer_object[ "type" ] = Json::Value( getJSONTypeName() );
+			optimizer_object[ "rate" ] = Json::Value( getRate() );
+			optimizer_object[ "data" ] = saveToJSONInternal();
+			return optimizer_object;
+		}
+
+		/**
+		 * Start a step, before any of its runs are updated. Per-parameter state kept for a model of a different size is dropped, as it no longer lines up with the parameters.
+		 * @param parameter_count The number of parameters in the model being stepped.
+		 */
+		virtual void beginStep( std::size_t ) {
+		}
+
+		/**
+		 * Forget all per-parameter state, as when training a new model.
+		 */
+		virtual void reset() {
+		}
+
+		/**
+		 * Step a run of parameters.
+		 * @param offset The index of the run's first parameter among all of the model's parameters.
+		 * @param parameters The parameters to step.
+		 * @param gradients The gradients of the loss with respect to the parameters.
+		 * @param count The number of parameters in the run.
+		 * @param scale The factor to multiply the gradients by first, which turns gradients summed over a batch into their average.
+		 */
+		virtual void update( std::size_t offset, float* parameters, const float* gradients, std::size_t count, float scale = 1.f ) = 0;
+};
+
+/**
+ * Plain stochastic gradient descent, the update train() makes: every parameter moves against its gradient in proportion to the learning rate.
+ */
+class SGDOptimizer : public Optimizer {
+	protected:
+		virtual std::string getJSONTypeName() const {
+			return std::string( "sgd" );
+		}
+
+		virtual void loadFromJSONInternal( Json::Value& ) {
+		}
+
+		virtual Json::Value saveToJSONInternal() const {
+			return Json::Value( Json::objectValue );
+		}
+
+	public:
+		SGDOptimizer( float rate = 0.05f ) : Optimizer( rate ) {
+		}
+
+		virtual void update( std::size_t, float* parameters, const float* gradients, std::size_t count, float scale = 1.f ) {
+			SGDKernel kernel = selectSGDKernel();
+			const float rate = getRate();
+
+			parallelForParameters( count, [ & ]( std::size_t first, std::size_t chunk ) {
+				kernel( parameters + first, gradients + first, chunk, rate, scale );
+			} );
+		}
+};
+
+/**
+ * Stochastic gradient descent with momentum. Each parameter keeps a velocity that gathers its gradients over the steps, which carries training through noisy gradients and along shallow valleys of the loss.
+ */
+class MomentumOptimizer : public Optimizer {
+	private:
+		float m_momentum;
+		bool m_nesterov;
+
+		AlignedBuffer< float > m_velocity;
+
+	protected:
+		MomentumOptimizer( float rate, float momentum, bool nesterov ) : Optimizer( rate ), m_momentum( momentum ), m_nesterov( nesterov ) {
+		}
+
+		virtual std::string getJSONTypeName() const {
+			return std::string( m_nesterov ? "nesterov" : "momentum" );
+		}
+
+		virtual void loadFromJSONInternal( Json::Value& data_value ) {
+			m_momentum = data_value.get( "momentum", m_momentum ).asFloat();
+			loadState( data_value[ "velocity" ], m_velocity );
+		}
+
+		virtual Json::Value saveToJSONInternal() const {
+			Json::Value data_object( Json::objectValue );
+			data_object[ "momentum" ] = Json::Value( m_momentum );
+			data_object[ "velocity" ] = saveState( m_velocity );
+			return data_object;
+		}
+
+	public:
+		MomentumOptimizer( float rate = 0.01f, float momentum = 0.9f ) : Optimizer( rate ), m_momentum( momentum ), m_nesterov( false ) {
+		}
+
+		float getMomentum() const {
+			return m_momentum;
+		}
+
+		void setMomentum( float momentum ) {
+			m_momentum = momentum;
+		}
+
+		virtual void beginStep( std::size_t parameter_count ) {
+			if( m_velocity.size() != parameter_count ) {
+				resizeState( m_velocity, 0 );
+				resizeState( m_velocity, parameter_count );
+			}
+		}
+
+		virtual void reset() {
+			resizeState( m_velocity, 0 );
+		}
+
+		virtual void update( std::size_t offset, float* parameters, const float* gradients, std::size_t count, float scale = 1.f ) {
+			MomentumKernel kernel = selectMomentumKernel( m_nesterov );
+			float* velocity = getState( m_velocity, offset, count );
+			const float rate = getRate();
+			const float momentum = m_momentum;
+
+			parallelForParameters( count, [ & ]( std::size_t first, std::size_t chunk ) {
+				kernel( parameters + first, gradients + first, velocity + first, chunk, rate, momentum, scale );
+			} );
+		}
+};
+
+/**
+ * Momentum with Nesterov's correction: each parameter moves by the gradient plus where its velocity is about to take it, which damps the overshoot of plain momentum.
+ */
+class NesterovOptimizer : public MomentumOptimizer {
+	public:
+		NesterovOptimizer( float rate = 0.01f, float momentum = 0.9f ) : MomentumOptimizer( rate, momentum, true ) {
+		}
+};
+
+/**
+ * RMSProp. Each parameter's step is divided by a running root mean square of its gradients, so parameters with small gradients are not left behind by those with large ones.
+ */
+class RMSPropOptimizer : public Optimizer {
+	private:
+		float m_decay;
+		float m_epsilon;
+
+		AlignedBuffer< float > m_average;
+
+	protected:
+		virtual std::string getJSONTypeName() const {
+			return std::string( "rmsprop" );
+		}
+
+		virtual void loadFromJSONInternal( Json::Value& data_value ) {
+			m_decay = data_value.get( "decay", m_decay ).asFloat();
+			m_epsilon = data_value.get( "epsilon", m_epsilon ).asFloat();
+			loadState( data_value[ "average" ], m_average );
+		}
+
+		virtual Json::Value saveToJSONInternal() const {
+			Json::Value data_object( Json::objectValue );
+			data_object[ "decay" ] = Json::Value( m_decay );
+			data_object[ "epsilon" ] = Json::Value( m_epsilon );
+			data_object[ "average" ] = saveState( m_average );
+			return data_object;
+		}
+
+	public:
+		RMSPropOptimizer( float rate = 0.001f, float decay = 0.9f, float epsilon = 1e-8f ) : Optimizer( rate ), m_decay( decay ), m_epsilon( epsilon ) {
+		}
+
+		virtual void beginStep( std::size_t parameter_count ) {
+			if( m_average.size() != parameter_count ) {
+				resizeState( m_average, 0 );
+				resizeState( m_average, parameter_count );
+			}
+		}
+
+		virtual void reset() {
+			resizeState( m_average, 0 );
+		}
+
+		virtual void update( std::size_t offset, float* parameters, const float* gradients, std::size_t count, float scale = 1.f ) {
+			RMSPropKernel kernel = selectRMSPropKernel();
+			float* average = getState( m_average, offset, count );
+			const float rate = getRate();
+			const float decay = m_decay;
+			const float epsilon = m_epsilon;
+
+			parallelForParameters( count, [ & ]( std::size_t first, std::size_t chunk ) {
+				kernel( parameters + first, gradients + first, average + first, chunk, rate, decay, epsilon, scale );
+			} );
+		}
+};
+
+/**
+ * Adam. Steps each parameter by the ratio of running means of its gradients and of their squares, corrected for the zeros both means start from, which combines momentum with the per-parameter step sizes of RMSProp.
+ */
+class AdamOptimizer : public Optimizer {
+	private:
+		float m_beta1;
+		float m_beta2;
+		float m_epsilon;
+
+		// The number of steps begun, which sets the bias correction
+		unsigned int m_step;
+
+		AlignedBuffer< float > m_first_moment;
+		AlignedBuffer< float > m_second_moment;
+
+	protected:
+		virtual std::string getJSONTypeName() const {
+			return std::string( "adam" );
+		}
+
+		virtual void loadFromJSONInternal( Json::Value& data_value ) {
+			m_beta1 = data_value.get( "beta1", m_beta1 ).asFloat();
+			m_beta2 = data_value.get( "beta2", m_beta2 ).asFloat();
+			m_epsilon = data_value.get( "epsilon", m_epsilon ).asFloat();
+			m_step = data_value.get( "step", 0 ).asUInt();
+			loadState( data_value[ "first-moment" ], m_first_moment );
+			loadState( data_value[ "second-moment" ], m_second_moment );
+		}
+
+		virtual Json::Value saveToJSONInternal() const {
+			Json::Value data_object( Json::objectValue );
+			data_object[ "beta1" ] = Json::Value( m_beta1 );
+			data_object[ "beta2" ] = Json::Value( m_beta2 );
+			data_object[ "epsilon" ] = Json::Value( m_epsilon );
+			data_object[ "step" ] = Json::Value( m_step );
+			data_object[ "first-moment" ] = saveState( m_first_moment );
+			data_object[ "second-moment" ] = saveState( m_second_moment );
+			return data_object;
+		}
+
+	public:
+		AdamOptimizer( float rate = 0.001f, float beta1 = 0.9f, float beta2 = 0.999f, float epsilon = 1e-8f ) : Optimizer( rate ), m_beta1( beta1 ), m_beta2( beta2 ), m_epsilon( epsilon ), m_step( 0 ) {
+		}
+
+		unsigned int getStep() const {
+			return m_step;
+		}
+
+		virtual void beginStep( std::size_t parameter_count ) {
+			if( m_first_moment.size() != parameter_count || m_second_moment.size() != parameter_count ) {
+				reset();
+				resizeState( m_first_moment, parameter_count );
+				resizeState( m_second_moment, parameter_count );
+			}
+
+			++m_step;
+		}
+
+		virtual void reset() {
+			resizeState( m_first_moment, 0 );
+			resizeState( m_second_moment, 0 );
+			m_step = 0;
+		}
+
+		virtual void update( std::size_t offset, float* parameters, const float* gradients, std::size_t count, float scale = 1.f ) {
+			AdamKernel kernel = selectAdamKernel();
+			float* first_moment = getState( m_first_moment, offset, count );
+			float* second_moment = getState( m_second_moment, offset, count );
+
+			// Dividing the moments by 1 - beta^step is folded into the rate and epsilon, so the kernels need no per-step terms
+			const double step = std::max( m_step, 1u );
+			const double first_correction = 1.0 - std::pow( static_cast< double >( m_beta1 ), step );
+			const double second_correction = std::sqrt( 1.0 - std::pow( static_cast< double >( m_beta2 ), step ) );
+			const float rate = static_cast< float >( getRate() * second_correction / first_correction );
+			const float epsilon = static_cast< float >( m_epsilon * second_correction );
+			const float beta1 = m_beta1;
+			const float beta2 = m_beta2;
+
+			parallelForParameters( count, [ & ]( std::size_t first, std::size_t chunk ) {
+				kernel( parameters + first, gradients + first, first_moment + first, second_moment + first, chunk, rate, beta1, beta2, epsilon, scale );
+			} );
+		}
+};
+
+/**
+ * Create an optimizer from its saved description, with its hyperparameters and per-parameter state, so training can resume where it stopped.
+ * @param optimizer_value The value saved by the optimizer's saveToJSON().
+ * @return The optimizer, which the caller takes ownership of, or null if the type is unknown.
+ */
+Optimizer* createOptimizerFromJSON( Json::Value& optimizer_value ) {
+	const std::string type = optimizer_value[ "type" ].asString();
+	Optimizer* optimizer = nullptr;
+
+	if( type == "sgd" ) {
+		optimizer = new SGDOptimizer;
+	} else if( type == "momentum" ) {
+		optimizer = new MomentumOptimizer;
+	} else if( type == "nesterov" ) {
+		optimizer = new NesterovOptimizer;
+	} else if( type == "rmsprop" ) {
+		optimizer = new RMSPropOptimizer;
+	} else if( type == "adam" ) {
+		optimizer = new AdamOptimizer;
+	}
+
+	if( optimizer != nullptr ) {
+		optimizer->loadFromJSON( optimizer_value );
+	}
+
+	return optimizer;
+}
+
+#endif // OPTIMIZER_HPP
@@ -0,0 +1,481 @@
+#ifndef OPTIMIZERKERNELS_HPP
+#define OPTIMIZERKERNELS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "CPUFeatures.hpp"
+#include "MatrixKernels.hpp"
+
+#if NN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Reference stochastic gradient descent step, parameters -= rate * scale * gradients.
+ * @param parameters The parameters to step.
+ * @param gradients The gradients of the loss with respect to the parameters.
+ * @param count The number of parameters.
+ * @param rate The learning rate.
+ * @param scale The factor to multiply the gradients by first.
+ */
+void sgdScalar( float* parameters, const float* gradients, std::size_t count, float rate, float scale ) {
+	const float step = rate * scale;
+
+	for( std::size_t i = 0; i < count; ++i ) {
+		parameters[ i ] -= step * gradients[ i ];
+	}
+}
+
+/**
+ * Reference momentum step. The velocity gathers the scaled gradients, velocity = momentum * velocity + gradient, and the parameters move against it. The Nesterov form moves them against gradient + momentum * velocity instead, looking one step ahead.
+ * @param parameters The parameters to step.
+ * @param gradients The gradients of the loss with respect to the parameters.
+ * @param velocity The velocity of each parameter, updated in place.
+ * @param count The number of parameters.
+ * @param rate The learning rate.
+ * @param momentum The fraction of the velocity kept from one step to the next.
+ * @param scale The factor to multiply the gradients by first.
+ */
+template< bool Nesterov >
+void momentumScalar( float* parameters, const float* gradients, float* velocity, std::size_t count, float rate, float momentum, float scale ) {
+	for( std::size_t i = 0; i < count; ++i ) {
+		const float gradient = gradients[ i ] * scale;
+		const float moved = momentum * velocity[ i ] + gradient;
+		velocity[ i ] = moved;
+		parameters[ i ] -= rate * ( Nesterov ? gradient + momentum * moved : moved );
+	}
+}
+
+/**
+ * Reference RMSProp step. Each parameter's step is divided by a running root mean square of its gradients, average = decay * average + ( 1 - decay ) * gradient^2.
+ * @param parameters The parameters to step.
+ * @param gradients The gradients of the loss with respect to the parameters.
+ * @param average The running mean of each parameter's squared gradients, updated in place.
+ * @param count The number of parameters.
+ * @param rate The learning rate.
+ * @param decay The fraction of the running mean kept from one step to the next.
+ * @param epsilon The term added to the root mean square, which keeps the division finite.
+ * @param scale The factor to multiply the gradients by first.
+ */
+void rmsPropScalar( float* parameters, const float* gradients, float* average, std::size_t count, float rate, float decay, float epsilon, float scale ) {
+	for( std::size_t i = 0; i < count; ++i ) {
+		const float gradient = gradients[ i ] * scale;
+		const float mean = decay * average[ i ] + ( 1.f - decay ) * gradient * gradient;
+		average[ i ] = mean;
+		parameters[ i ] -= rate * gradient / ( std::sqrt( mean ) + epsilon );
+	}
+}
+
+/**
+ * Reference Adam step. Keeps running means of each parameter's gradients and squared gradients and steps by their ratio. Bias correction for the step count is folded into the rate and epsilon by the caller.
+ * @param parameters The parameters to step.
+ * @param gradients The gradients of the loss with respect to the parameters.
+ * @param first_moment The running mean of each parameter's gradients, updated in place.
+ * @param second_moment The running mean of each parameter's squared gradients, updated in place.
+ * @param count The number of parameters.
+ * @param rate The bias corrected learning rate.
+ * @param beta1 The fraction of the first moment kept from one step to the next.
+ * @param beta2 The fraction of the second moment kept from one step to the next.
+ * @param epsilon The bias corrected term added to the root of the second moment.
+ * @param scale The factor to multiply the gradients by first.
+ */
+void adamScalar( float* parameters, const float* gradients, float* first_moment, float* second_moment, std::size_t count, float rate, float beta1, float beta2, float epsilon, float scale ) {
+	for( std::size_t i = 0; i < count; ++i ) {
+		const float gradient = gradients[ i ] * scale;
+		const float first = beta1 * first_moment[ i ] + ( 1.f - beta1 ) * gradient;
+		const float second = beta2 * second_moment[ i ] + ( 1.f - beta2 ) * gradient * gradient;
+		first_moment[ i ] = first;
+		second_moment[ i ] = second;
+		parameters[ i ] -= rate * first / ( std::sqrt( second ) + epsilon );
+	}
+}
+
+#if NN_X86
+__attribute__(( target( "sse2" ) ))
+void sgdSSE2( float* parameters, const float* gradients, std::size_t count, float rate, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 3 );
+	const __m128 step = _mm_set1_ps( rate * scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 4 ) {
+		_mm_storeu_ps( parameters + i, _mm_sub_ps( _mm_loadu_ps( parameters + i ), _mm_mul_ps( step, _mm_loadu_ps( gradients + i ) ) ) );
+	}
+
+	sgdScalar( parameters + vector_count, gradients + vector_count, count - vector_count, rate, scale );
+}
+
+template< bool Nesterov >
+__attribute__(( target( "sse2" ) ))
+void momentumSSE2( float* parameters, const float* gradients, float* velocity, std::size_t count, float rate, float momentum, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 3 );
+	const __m128 rates = _mm_set1_ps( rate );
+	const __m128 momentums = _mm_set1_ps( momentum );
+	const __m128 scales = _mm_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 4 ) {
+		const __m128 gradient = _mm_mul_ps( _mm_loadu_ps( gradients + i ), scales );
+		const __m128 moved = _mm_add_ps( _mm_mul_ps( momentums, _mm_loadu_ps( velocity + i ) ), gradient );
+		const __m128 direction = Nesterov ? _mm_add_ps( gradient, _mm_mul_ps( momentums, moved ) ) : moved;
+		_mm_storeu_ps( velocity + i, moved );
+		_mm_storeu_ps( parameters + i, _mm_sub_ps( _mm_loadu_ps( parameters + i ), _mm_mul_ps( rates, direction ) ) );
+	}
+
+	momentumScalar< Nesterov >( parameters + vector_count, gradients + vector_count, velocity + vector_count, count - vector_count, rate, momentum, scale );
+}
+
+__attribute__(( target( "sse2" ) ))
+void rmsPropSSE2( float* parameters, const float* gradients, float* average, std::size_t count, float rate, float decay, float epsilon, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 3 );
+	const __m128 rates = _mm_set1_ps( rate );
+	const __m128 decays = _mm_set1_ps( decay );
+	const __m128 complements = _mm_set1_ps( 1.f - decay );
+	const __m128 epsilons = _mm_set1_ps( epsilon );
+	const __m128 scales = _mm_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 4 ) {
+		const __m128 gradient = _mm_mul_ps( _mm_loadu_ps( gradients + i ), scales );
+		const __m128 mean = _mm_add_ps( _mm_mul_ps( decays, _mm_loadu_ps( average + i ) ), _mm_mul_ps( complements, _mm_mul_ps( gradient, gradient ) ) );
+		_mm_storeu_ps( average + i, mean );
+		const __m128 step = _mm_div_ps( _mm_mul_ps( rates, gradient ), _mm_add_ps( _mm_sqrt_ps( mean ), epsilons ) );
+		_mm_storeu_ps( parameters + i, _mm_sub_ps( _mm_loadu_ps( parameters + i ), step ) );
+	}
+
+	rmsPropScalar( parameters + vector_count, gradients + vector_count, average + vector_count, count - vector_count, rate, decay, epsilon, scale );
+}
+
+__attribute__(( target( "sse2" ) ))
+void adamSSE2( float* parameters, const float* gradients, float* first_moment, float* second_moment, std::size_t count, float rate, float beta1, float beta2, float epsilon, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 3 );
+	const __m128 rates = _mm_set1_ps( rate );
+	const __m128 beta1s = _mm_set1_ps( beta1 );
+	const __m128 beta2s = _mm_set1_ps( beta2 );
+	const __m128 complement1s = _mm_set1_ps( 1.f - beta1 );
+	const __m128 complement2s = _mm_set1_ps( 1.f - beta2 );
+	const __m128 epsilons = _mm_set1_ps( epsilon );
+	const __m128 scales = _mm_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 4 ) {
+		const __m128 gradient = _mm_mul_ps( _mm_loadu_ps( gradients + i ), scales );
+		const __m128 first = _mm_add_ps( _mm_mul_ps( beta1s, _mm_loadu_ps( first_moment + i ) ), _mm_mul_ps( complement1s, gradient ) );
+		const __m128 second = _mm_add_ps( _mm_mul_ps( beta2s, _mm_loadu_ps( second_moment + i ) ), _mm_mul_ps( complement2s, _mm_mul_ps( gradient, gradient ) ) );
+		_mm_storeu_ps( first_moment + i, first );
+		_mm_storeu_ps( second_moment + i, second );
+		const __m128 step = _mm_div_ps( _mm_mul_ps( rates, first ), _mm_add_ps( _mm_sqrt_ps( second ), epsilons ) );
+		_mm_storeu_ps( parameters + i, _mm_sub_ps( _mm_loadu_ps( parameters + i ), step ) );
+	}
+
+	adamScalar( parameters + vector_count, gradients + vector_count, first_moment + vector_count, second_moment + vector_count, count - vector_count, rate, beta1, beta2, epsilon, scale );
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+void sgdAVX2( float* parameters, const float* gradients, std::size_t count, float rate, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 7 );
+	const __m256 step = _mm256_set1_ps( -rate * scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 8 ) {
+		_mm256_storeu_ps( parameters + i, _mm256_fmadd_ps( step, _mm256_loadu_ps( gradients + i ), _mm256_loadu_ps( parameters + i ) ) );
+	}
+
+	sgdScalar( parameters + vector_count, gradients + vector_count, count - vector_count, rate, scale );
+}
+
+template< bool Nesterov >
+__attribute__(( target( "avx2,fma" ) ))
+void momentumAVX2( float* parameters, const float* gradients, float* velocity, std::size_t count, float rate, float momentum, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 7 );
+	const __m256 rates = _mm256_set1_ps( -rate );
+	const __m256 momentums = _mm256_set1_ps( momentum );
+	const __m256 scales = _mm256_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 8 ) {
+		const __m256 gradient = _mm256_mul_ps( _mm256_loadu_ps( gradients + i ), scales );
+		const __m256 moved = _mm256_fmadd_ps( momentums, _mm256_loadu_ps( velocity + i ), gradient );
+		const __m256 direction = Nesterov ? _mm256_fmadd_ps( momentums, moved, gradient ) : moved;
+		_mm256_storeu_ps( velocity + i, moved );
+		_mm256_storeu_ps( parameters + i, _mm256_fmadd_ps( rates, direction, _mm256_loadu_ps( parameters + i ) ) );
+	}
+
+	momentumScalar< Nesterov >( parameters + vector_count, gradients + vector_count, velocity + vector_count, count - vector_count, rate, momentum, scale );
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+void rmsPropAVX2( float* parameters, const float* gradients, float* average, std::size_t count, float rate, float decay, float epsilon, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 7 );
+	const __m256 rates = _mm256_set1_ps( rate );
+	const __m256 decays = _mm256_set1_ps( decay );
+	const __m256 complements = _mm256_set1_ps( 1.f - decay );
+	const __m256 epsilons = _mm256_set1_ps( epsilon );
+	const __m256 scales = _mm256_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 8 ) {
+		const __m256 gradient = _mm256_mul_ps( _mm256_loadu_ps( gradients + i ), scales );
+		const __m256 mean = _mm256_fmadd_ps( decays, _mm256_loadu_ps( average + i ), _mm256_mul_ps( complements, _mm256_mul_ps( gradient, gradient ) ) );
+		_mm256_storeu_ps( average + i, mean );
+		const __m256 step = _mm256_div_ps( _mm256_mul_ps( rates, gradient ), _mm256_add_ps( _mm256_sqrt_ps( mean ), epsilons ) );
+		_mm256_storeu_ps( parameters + i, _mm256_sub_ps( _mm256_loadu_ps( parameters + i ), step ) );
+	}
+
+	rmsPropScalar( parameters + vector_count, gradients + vector_count, average + vector_count, count - vector_count, rate, decay, epsilon, scale );
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+void adamAVX2( float* parameters, const float* gradients, float* first_moment, float* second_moment, std::size_t count, float rate, float beta1, float beta2, float epsilon, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 7 );
+	const __m256 rates = _mm256_set1_ps( rate );
+	const __m256 beta1s = _mm256_set1_ps( beta1 );
+	const __m256 beta2s = _mm256_set1_ps( beta2 );
+	const __m256 complement1s = _mm256_set1_ps( 1.f - beta1 );
+	const __m256 complement2s = _mm256_set1_ps( 1.f - beta2 );
+	const __m256 epsilons = _mm256_set1_ps( epsilon );
+	const __m256 scales = _mm256_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 8 ) {
+		const __m256 gradient = _mm256_mul_ps( _mm256_loadu_ps( gradients + i ), scales );
+		const __m256 first = _mm256_fmadd_ps( beta1s, _mm256_loadu_ps( first_moment + i ), _mm256_mul_ps( complement1s, gradient ) );
+		const __m256 second = _mm256_fmadd_ps( beta2s, _mm256_loadu_ps( second_moment + i ), _mm256_mul_ps( complement2s, _mm256_mul_ps( gradient, gradient ) ) );
+		_mm256_storeu_ps( first_moment + i, first );
+		_mm256_storeu_ps( second_moment + i, second );
+		const __m256 step = _mm256_div_ps( _mm256_mul_ps( rates, first ), _mm256_add_ps( _mm256_sqrt_ps( second ), epsilons ) );
+		_mm256_storeu_ps( parameters + i, _mm256_sub_ps( _mm256_loadu_ps( parameters + i ), step ) );
+	}
+
+	adamScalar( parameters + vector_count, gradients + vector_count, first_moment + vector_count, second_moment + vector_count, count - vector_count, rate, beta1, beta2, epsilon, scale );
+}
+
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void sgdAVX512( float* parameters, const float* gradients, std::size_t count, float rate, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 15 );
+	const __m512 step = _mm512_set1_ps( -rate * scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 16 ) {
+		_mm512_storeu_ps( parameters + i, _mm512_fmadd_ps( step, _mm512_loadu_ps( gradients + i ), _mm512_loadu_ps( parameters + i ) ) );
+	}
+
+	sgdScalar( parameters + vector_count, gradients + vector_count, count - vector_count, rate, scale );
+}
+
+template< bool Nesterov >
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void momentumAVX512( float* parameters, const float* gradients, float* velocity, std::size_t count, float rate, float momentum, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 15 );
+	const __m512 rates = _mm512_set1_ps( -rate );
+	const __m512 momentums = _mm512_set1_ps( momentum );
+	const __m512 scales = _mm512_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 16 ) {
+		const __m512 gradient = _mm512_mul_ps( _mm512_loadu_ps( gradients + i ), scales );
+		const __m512 moved = _mm512_fmadd_ps( momentums, _mm512_loadu_ps( velocity + i ), gradient );
+		const __m512 direction = Nesterov ? _mm512_fmadd_ps( momentums, moved, gradient ) : moved;
+		_mm512_storeu_ps( velocity + i, moved );
+		_mm512_storeu_ps( parameters + i, _mm512_fmadd_ps( rates, direction, _mm512_loadu_ps( parameters + i ) ) );
+	}
+
+	momentumScalar< Nesterov >( parameters + vector_count, gradients + vector_count, velocity + vector_count, count - vector_count, rate, momentum, scale );
+}
+
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void rmsPropAVX512( float* parameters, const float* gradients, float* average, std::size_t count, float rate, float decay, float epsilon, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 15 );
+	const __m512 rates = _mm512_set1_ps( rate );
+	const __m512 decays = _mm512_set1_ps( decay );
+	const __m512 complements = _mm512_set1_ps( 1.f - decay );
+	const __m512 epsilons = _mm512_set1_ps( epsilon );
+	const __m512 scales = _mm512_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 16 ) {
+		const __m512 gradient = _mm512_mul_ps( _mm512_loadu_ps( gradients + i ), scales );
+		const __m512 mean = _mm512_fmadd_ps( decays, _mm512_loadu_ps( average + i ), _mm512_mul_ps( complements, _mm512_mul_ps( gradient, gradient ) ) );
+		_mm512_storeu_ps( average + i, mean );
+		const __m512 step = _mm512_div_ps( _mm512_mul_ps( rates, gradient ), _mm512_add_ps( _mm512_sqrt_ps( mean ), epsilons ) );
+		_mm512_storeu_ps( parameters + i, _mm512_sub_ps( _mm512_loadu_ps( parameters + i ), step ) );
+	}
+
+	rmsPropScalar( parameters + vector_count, gradients + vector_count, average + vector_count, count - vector_count, rate, decay, epsilon, scale );
+}
+
+__attribute__(( target( "avx512f,avx2,fma" ) ))
+void adamAVX512( float* parameters, const float* gradients, float* first_moment, float* second_moment, std::size_t count, float rate, float beta1, float beta2, float epsilon, float scale ) {
+	const std::size_t vector_count = count & ~static_cast< std::size_t >( 15 );
+	const __m512 rates = _mm512_set1_ps( rate );
+	const __m512 beta1s = _mm512_set1_ps( beta1 );
+	const __m512 beta2s = _mm512_set1_ps( beta2 );
+	const __m512 complement1s = _mm512_set1_ps( 1.f - beta1 );
+	const __m512 complement2s = _mm512_set1_ps( 1.f - beta2 );
+	const __m512 epsilons = _mm512_set1_ps( epsilon );
+	const __m512 scales = _mm512_set1_ps( scale );
+
+	for( std::size_t i = 0; i < vector_count; i += 16 ) {
+		const __m512 gradient = _mm512_mul_ps( _mm512_loadu_ps( gradients + i ), scales );
+		const __m512 first = _mm512_fmadd_ps( beta1s, _mm512_loadu_ps( first_moment + i ), _mm512_mul_ps( complement1s, gradient ) );
+		const __m512 second = _mm512_fmadd_ps( beta2s, _mm512_loadu_ps( second_moment + i ), _mm512_mul_ps( complement2s, _mm512_mul_ps( gradient, gradient ) ) );
+		_mm512_storeu_ps( first_moment + i, first );
+		_mm512_storeu_ps( second_moment + i, second );
+		const __m512 step = _mm512_div_ps( _mm512_mul_ps( rates, first ), _mm512_add_ps( _mm512_sqrt_ps( second ), epsilons ) );
+		_mm512_storeu_ps( parameters + i, _mm512_sub_ps( _mm512_loadu_ps( parameters + i ), step ) );
+	}
+
+	adamScalar( parameters + vector_count, gradients + vector_count, first_moment + vector_count, second_moment + vector_count, count - vector_count, rate, beta1, beta2, epsilon, scale );
+}
+#endif
+
+typedef void ( *SGDKernel )( float*, const float*, std::size_t, float, float );
+typedef void ( *MomentumKernel )( float*, const float*, float*, std::size_t, float, float, float );
+typedef void ( *RMSPropKernel )( float*, const float*, float*, std::size_t, float, float, float, float );
+typedef void ( *AdamKernel )( float*, const float*, float*, float*, std::size_t, float, float, float, float, float );
+
+/**
+ * Pick the widest stochastic gradient descent kernel the CPU supports. Selected once on first use.
+ * @return The selected kernel.
+ */
+SGDKernel selectSGDKernel() {
+	static const SGDKernel kernel = []() -> SGDKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512() ) {
+			return sgdAVX512;
+		}
+
+		if( features.hasAVX2() ) {
+			return sgdAVX2;
+		}
+
+		if( features.hasSSE2() ) {
+			return sgdSSE2;
+		}
+#endif
+		return sgdScalar;
+	}();
+
+	return kernel;
+}
+
+template< bool Nesterov >
+MomentumKernel selectMomentumKernelFor() {
+#if NN_X86
+	const CPUFeatures& features = CPUFeatures::get();
+
+	if( features.hasAVX512() ) {
+		return momentumAVX512< Nesterov >;
+	}
+
+	if( features.hasAVX2() ) {
+		return momentumAVX2< Nesterov >;
+	}
+
+	if( features.hasSSE2() ) {
+		return momentumSSE2< Nesterov >;
+	}
+#endif
+	return momentumScalar< Nesterov >;
+}
+
+/**
+ * Pick the widest momentum kernel the CPU supports. Selected once per form on first use.
+ * @param nesterov Whether to take the Nesterov form of the step.
+ * @return The selected kernel.
+ */
+MomentumKernel selectMomentumKernel( bool nesterov ) {
+	static const MomentumKernel classical_kernel = selectMomentumKernelFor< false >();
+	static const MomentumKernel nesterov_kernel = selectMomentumKernelFor< true >();
+
+	return nesterov ? nesterov_kernel : classical_kernel;
+}
+
+/**
+ * Pick the widest RMSProp kernel the CPU supports. Selected once on first use.
+ * @return The selected kernel.
+ */
+RMSPropKernel selectRMSPropKernel() {
+	static const RMSPropKernel kernel = []() -> RMSPropKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512() ) {
+			return rmsPropAVX512;
+		}
+
+		if( features.hasAVX2() ) {
+			return rmsPropAVX2;
+		}
+
+		if( features.hasSSE2() ) {
+			return rmsPropSSE2;
+		}
+#endif
+		return rmsPropScalar;
+	}();
+
+	return kernel;
+}
+
+/**
+ * Pick the widest Adam kernel the CPU supports. Selected once on first use.
+ * @return The selected kernel.
+ */
+AdamKernel selectAdamKernel() {
+	static const AdamKernel kernel = []() -> AdamKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512() ) {
+			return adamAVX512;
+		}
+
+		if( features.hasAVX2() ) {
+			return adamAVX2;
+		}
+
+		if( features.hasSSE2() ) {
+			return adamSSE2;
+		}
+#endif
+		return adamScalar;
+	}();
+
+	return kernel;
+}
+
+/**
+ * Get the name of the instruction set used by the optimizer kernels.
+ * @return The instruction set name.
+ */
+const char* getOptimizerKernelName() {
+#if NN_X86
+	AdamKernel kernel = selectAdamKernel();
+
+	if( kernel == adamAVX512 ) {
+		return "AVX-512";
+	}
+
+	if( kernel == adamAVX2 ) {
+		return "AVX2";
+	}
+
+	if( kernel == adamSSE2 ) {
+		return "SSE2";
+	}
+#endif
+	return "scalar";
+}
+
+// Parameters are handed to threads in whole cache lines, so no two threads write the same line
+const std::size_t optimizer_line_width = 16;
+
+/**
+ * Run an optimizer kernel over a range of parameters, split into one contiguous chunk per thread when there is enough work. Every parameter is touched once per step, so the steps are bound by memory bandwidth and are split at the same threshold as the matrix kernels.
+ * @param count The number of parameters.
+ * @param chunk The kernel, called as chunk( first, count ) for each chunk.
+ */
+template< typename ChunkFunction >
+void parallelForParameters( std::size_t count, ChunkFunction chunk ) {
+	const std::size_t lines = ( count + optimizer_line_width - 1 ) / optimizer_line_width;
+
+	parallelForRows( static_cast< unsigned int >( lines ), count, [ & ]( unsigned int first, unsigned int line_count ) {
+		const std::size_t begin = static_cast< std::size_t >( first ) * optimizer_line_width;
+		const std::size_t end = std::min( count, static_cast< std::size_t >( first + line_count ) * optimizer_line_width );
+		chunk( begin, end - begin );
+	} );
+}
+
+#endif // OPTIMIZERKERNELS_HPP
@@ -0,0 +1,294 @@
+#ifndef QUANTIZEDKERNELS_HPP
+#define QUANTIZEDKERNELS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "AlignedBuffer.hpp"
+#include "CPUFeatures.hpp"
+#include "MatrixKernels.hpp"
+#include "QuantizedMatrix.hpp"
+#include "VectorView.hpp"
+
+#if NN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Reference integer matrix-vector product, output = weights * input in 32 bit integers.
+ * @param weights The row-major quantized weights.
+ * @param stride The distance in weights between the starts of consecutive rows.
+ * @param height The number of rows in the matrix.
+ * @param width The number of columns to multiply, a multiple of 64. Weights and input past the real width must be zero.
+ * @param row_sums The sum of each row's weights. Only used by the kernels that offset the input to unsigned.
+ * @param input The quantized vector to multiply by, of length width.
+ * @param output The vector to write the integer products into, of length height.
+ */
+void gemvInt8Scalar( const std::int8_t* weights, unsigned int stride, unsigned int height, unsigned int width, const std::int32_t*, const std::int8_t* input, std::int32_t* output ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		const std::int8_t* row = weights + static_cast< std::size_t >( y ) * stride;
+		std::int32_t accum = 0;
+
+		for( unsigned int x = 0; x < width; ++x ) {
+			accum += static_cast< std::int32_t >( row[ x ] ) * input[ x ];
+		}
+
+		output[ y ] = accum;
+	}
+}
+
+#if NN_X86
+__attribute__(( target( "avx2,fma" ) ))
+std::int32_t horizontalSumEpi32AVX2( __m256i value ) {
+	__m128i sums = _mm_add_epi32( _mm256_castsi256_si128( value ), _mm256_extracti128_si256( value, 1 ) );
+	sums = _mm_add_epi32( sums, _mm_shuffle_epi32( sums, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	sums = _mm_add_epi32( sums, _mm_shuffle_epi32( sums, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( sums );
+}
+
+// Widens to 16 bits and multiplies with madd, which cannot saturate unlike maddubs
+__attribute__(( target( "avx2,fma" ) ))
+void gemvInt8AVX2( const std::int8_t* weights, unsigned int stride, unsigned int height, unsigned int width, const std::int32_t*, const std::int8_t* input, std::int32_t* output ) {
+	unsigned int y = 0;
+
+	for( ; y + 4 <= height; y += 4 ) {
+		const std::int8_t* row0 = weights + static_cast< std::size_t >( y ) * stride;
+		const std::int8_t* row1 = row0 + stride;
+		const std::int8_t* row2 = row1 + stride;
+		const std::int8_t* row3 = row2 + stride;
+		__m256i accum0 = _mm256_setzero_si256();
+		__m256i accum1 = _mm256_setzero_si256();
+		__m256i accum2 = _mm256_setzero_si256();
+		__m256i accum3 = _mm256_setzero_si256();
+
+		for( unsigned int x = 0; x < width; x += 16 ) {
+			__m256i in = _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast< const __m128i* >( input + x ) ) );
+			accum0 = _mm256_add_epi32( accum0, _mm256_madd_epi16( _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast< const __m128i* >( row0 + x ) ) ), in ) );
+			accum1 = _mm256_add_epi32( accum1, _mm256_madd_epi16( _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast< const __m128i* >( row1 + x ) ) ), in ) );
+			accum2 = _mm256_add_epi32( accum2, _mm256_madd_epi16( _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast< const __m128i* >( row2 + x ) ) ), in ) );
+			accum3 = _mm256_add_epi32( accum3, _mm256_madd_epi16( _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast< const __m128i* >( row3 + x ) ) ), in ) );
+		}
+
+		output[ y ] = horizontalSumEpi32AVX2( accum0 );
+		output[ y + 1 ] = horizontalSumEpi32AVX2( accum1 );
+		output[ y + 2 ] = horizontalSumEpi32AVX2( accum2 );
+		output[ y + 3 ] = horizontalSumEpi32AVX2( accum3 );
+	}
+
+	for( ; y < height; ++y ) {
+		const std::int8_t* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m256i accum = _mm256_setzero_si256();
+
+		for( unsigned int x = 0; x < width; x += 16 ) {
+			__m256i in = _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast< const __m128i* >( input + x ) ) );
+			accum = _mm256_add_epi32( accum, _mm256_madd_epi16( _mm256_cvtepi8_epi16( _mm_loadu_si128( reinterpret_cast< const __m128i* >( row + x ) ) ), in ) );
+		}
+
+		output[ y ] = horizontalSumEpi32AVX2( accum );
+	}
+}
+
+// dpbusd multiplies unsigned by signed bytes, so the input is offset by 128 and the offset's contribution, 128 times the row sum, is taken back out
+__attribute__(( target( "avxvnni,avx2,fma" ) ))
+void gemvInt8AVXVNNI( const std::int8_t* weights, unsigned int stride, unsigned int height, unsigned int width, const std::int32_t* row_sums, const std::int8_t* input, std::int32_t* output ) {
+	const __m256i offset = _mm256_set1_epi8( static_cast< char >( 0x80 ) );
+	unsigned int y = 0;
+
+	for( ; y + 4 <= height; y += 4 ) {
+		const std::int8_t* row0 = weights + static_cast< std::size_t >( y ) * stride;
+		const std::int8_t* row1 = row0 + stride;
+		const std::int8_t* row2 = row1 + stride;
+		const std::int8_t* row3 = row2 + stride;
+		__m256i accum0 = _mm256_setzero_si256();
+		__m256i accum1 = _mm256_setzero_si256();
+		__m256i accum2 = _mm256_setzero_si256();
+		__m256i accum3 = _mm256_setzero_si256();
+
+		for( unsigned int x = 0; x < width; x += 32 ) {
+			__m256i in = _mm256_xor_si256( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( input + x ) ), offset );
+			accum0 = _mm256_dpbusd_avx_epi32( accum0, in, _mm256_loadu_si256( reinterpret_cast< const __m256i* >( row0 + x ) ) );
+			accum1 = _mm256_dpbusd_avx_epi32( accum1, in, _mm256_loadu_si256( reinterpret_cast< const __m256i* >( row1 + x ) ) );
+			accum2 = _mm256_dpbusd_avx_epi32( accum2, in, _mm256_loadu_si256( reinterpret_cast< const __m256i* >( row2 + x ) ) );
+			accum3 = _mm256_dpbusd_avx_epi32( accum3, in, _mm256_loadu_si256( reinterpret_cast< const __m256i* >( row3 + x ) ) );
+		}
+
+		output[ y ] = horizontalSumEpi32AVX2( accum0 ) - 128 * row_sums[ y ];
+		output[ y + 1 ] = horizontalSumEpi32AVX2( accum1 ) - 128 * row_sums[ y + 1 ];
+		output[ y + 2 ] = horizontalSumEpi32AVX2( accum2 ) - 128 * row_sums[ y + 2 ];
+		output[ y + 3 ] = horizontalSumEpi32AVX2( accum3 ) - 128 * row_sums[ y + 3 ];
+	}
+
+	for( ; y < height; ++y ) {
+		const std::int8_t* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m256i accum = _mm256_setzero_si256();
+
+		for( unsigned int x = 0; x < width; x += 32 ) {
+			__m256i in = _mm256_xor_si256( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( input + x ) ), offset );
+			accum = _mm256_dpbusd_avx_epi32( accum, in, _mm256_loadu_si256( reinterpret_cast< const __m256i* >( row + x ) ) );
+		}
+
+		output[ y ] = horizontalSumEpi32AVX2( accum ) - 128 * row_sums[ y ];
+	}
+}
+
+__attribute__(( target( "avx512vnni,avx512f,avx2,fma" ) ))
+std::int32_t horizontalSumEpi32AVX512( __m512i value ) {
+	alignas( 64 ) std::int32_t lanes[ 16 ];
+	_mm512_store_si512( lanes, value );
+	return horizontalSumEpi32AVX2( _mm256_add_epi32( _mm256_load_si256( reinterpret_cast< const __m256i* >( lanes ) ), _mm256_load_si256( reinterpret_cast< const __m256i* >( lanes + 8 ) ) ) );
+}
+
+__attribute__(( target( "avx512vnni,avx512f,avx2,fma" ) ))
+void gemvInt8AVX512VNNI( const std::int8_t* weights, unsigned int stride, unsigned int height, unsigned int width, const std::int32_t* row_sums, const std::int8_t* input, std::int32_t* output ) {
+	const __m512i offset = _mm512_set1_epi32( static_cast< int >( 0x80808080u ) );
+	unsigned int y = 0;
+
+	for( ; y + 4 <= height; y += 4 ) {
+		const std::int8_t* row0 = weights + static_cast< std::size_t >( y ) * stride;
+		const std::int8_t* row1 = row0 + stride;
+		const std::int8_t* row2 = row1 + stride;
+		const std::int8_t* row3 = row2 + stride;
+		__m512i accum0 = _mm512_setzero_si512();
+		__m512i accum1 = _mm512_setzero_si512();
+		__m512i accum2 = _mm512_setzero_si512();
+		__m512i accum3 = _mm512_setzero_si512();
+
+		for( unsigned int x = 0; x < width; x += 64 ) {
+			__m512i in = _mm512_xor_si512( _mm512_loadu_si512( input + x ), offset );
+			accum0 = _mm512_dpbusd_epi32( accum0, in, _mm512_loadu_si512( row0 + x ) );
+			accum1 = _mm512_dpbusd_epi32( accum1, in, _mm512_loadu_si512( row1 + x ) );
+			accum2 = _mm512_dpbusd_epi32( accum2, in, _mm512_loadu_si512( row2 + x ) );
+			accum3 = _mm512_dpbusd_epi32( accum3, in, _mm512_loadu_si512( row3 + x ) );
+		}
+
+		output[ y ] = horizontalSumEpi32AVX512( accum0 ) - 128 * row_sums[ y ];
+		output[ y + 1 ] = horizontalSumEpi32AVX512( accum1 ) - 128 * row_sums[ y + 1 ];
+		output[ y + 2 ] = horizontalSumEpi32AVX512( accum2 ) - 128 * row_sums[ y + 2 ];
+		output[ y + 3 ] = horizontalSumEpi32AVX512( accum3 ) - 128 * row_sums[ y + 3 ];
+	}
+
+	for( ; y < height; ++y ) {
+		const std::int8_t* row = weights + static_cast< std::size_t >( y ) * stride;
+		__m512i accum = _mm512_setzero_si512();
+
+		for( unsigned int x = 0; x < width; x += 64 ) {
+			__m512i in = _mm512_xor_si512( _mm512_loadu_si512( input + x ), offset );
+			accum = _mm512_dpbusd_epi32( accum, in, _mm512_loadu_si512( row + x ) );
+		}
+
+		output[ y ] = horizontalSumEpi32AVX512( accum ) - 128 * row_sums[ y ];
+	}
+}
+#endif
+
+typedef void ( *Int8GEMVKernel )( const std::int8_t*, unsigned int, unsigned int, unsigned int, const std::int32_t*, const std::int8_t*, std::int32_t* );
+
+/**
+ * Pick the fastest integer matrix-vector kernel the CPU supports. Selected once on first use.
+ * @return The selected kernel.
+ */
+Int8GEMVKernel selectInt8GEMVKernel() {
+	static const Int8GEMVKernel kernel = []() -> Int8GEMVKernel {
+#if NN_X86
+		const CPUFeatures& features = CPUFeatures::get();
+
+		if( features.hasAVX512VNNI() ) {
+			return gemvInt8AVX512VNNI;
+		}
+
+		if( features.hasAVXVNNI() ) {
+			return gemvInt8AVXVNNI;
+		}
+
+		if( features.hasAVX2() ) {
+			return gemvInt8AVX2;
+		}
+#endif
+		return gemvInt8Scalar;
+	}();
+
+	return kernel;
+}
+
+/**
+ * Get the name of the instruction set used by the integer kernels.
+ * @return The instruction set name.
+ */
+const char* getInt8KernelName() {
+#if NN_X86
+	Int8GEMVKernel kernel = selectInt8GEMVKernel();
+
+	if( kernel == gemvInt8AVX512VNNI ) {
+		return "AVX-512 VNNI";
+	}
+
+	if( kernel == gemvInt8AVXVNNI ) {
+		return "AVX-VNNI";
+	}
+
+	if( kernel == gemvInt8AVX2 ) {
+		return "AVX2";
+	}
+#endif
+	return "scalar";
+}
+
+/**
+ * Calculate output = activation( weights * input + bias ) with quantized weights. The input is quantized on the fly with a single scale, the products are accumulated in integers and the row and input scales, bias and activation applied once per output.
+ * @param weights The quantized weight matrix.
+ * @param input The vector to multiply by. Must match the width of the weight matrix.
+ * @param bias The vector to add to the product. Must match the height of the weight matrix, or be empty for no bias. May be the output vector.
+ * @param output The vector to write the result into. Must match the height of the weight matrix.
+ * @param function The activation to apply after the bias.
+ * @param accuracy The accuracy tier to apply it at.
+ */
+void gemv( const QuantizedMatrix& weights, ConstVectorView input, ConstVectorView bias, VectorView output, ActivationFunction function = ActivationFunction::Identity, ActivationAccuracy accuracy = ActivationAccuracy::Exact ) {
+#ifdef NN_BOUNDS_CHECK
+	if( input.getDimension() != weights.getWidth() || output.getDimension() != weights.getHeight() || ( bias.data() && bias.getDimension() != weights.getHeight() ) ) {
+		throw std::string( "Mismatched dimensions in matrix-vector product" );
+	}
+#endif
+
+	const unsigned int width = weights.getWidth();
+	const unsigned int height = weights.getHeight();
+	const unsigned int padded_width = weights.getStride();
+
+	static thread_local AlignedBuffer< std::int8_t > quantized_input;
+	static thread_local AlignedBuffer< std::int32_t > products;
+	quantized_input.resize( padded_width );
+	products.resize( height );
+
+	float max_magnitude = 0.f;
+	for( unsigned int x = 0; x < width; ++x ) {
+		max_magnitude = std::max( max_magnitude, std::abs( input( x ) ) );
+	}
+
+	const float input_scale = max_magnitude > 0.f ? max_magnitude / 127.f : 1.f;
+	const float inverse_scale = 1.f / input_scale;
+
+	// The padding must be zero so it adds nothing to the products
+	quantized_input.clear();
+	for( unsigned int x = 0; x < width; ++x ) {
+		long quantized = std::lround( input( x ) * inverse_scale );
+		quantized = quantized > 127 ? 127 : ( quantized < -127 ? -127 : quantized );
+		quantized_input[ x ] = static_cast< std::int8_t >( quantized );
+	}
+
+	// The buffers belong to the calling thread, so the workers are handed their addresses
+	Int8GEMVKernel kernel = selectInt8GEMVKernel();
+	const std::int8_t* quantized_values = quantized_input.data();
+	std::int32_t* product_values = products.data();
+
+	parallelForRows( height, static_cast< std::size_t >( height ) * padded_width, [ & ]( unsigned int first, unsigned int count ) {
+		kernel( weights.data() + static_cast< std::size_t >( first ) * weights.getStride(), weights.getStride(), count, padded_width, weights.getRowSums() + first, quantized_values, product_values + first );
+	} );
+
+	const float* scales = weights.getScales();
+	for( unsigned int y = 0; y < height; ++y ) {
+		output( y ) = activate( function, accuracy, static_cast< float >( products[ y ] ) * scales[ y ] * input_scale + ( bias.data() ? bias( y ) : 0.f ) );
+	}
+}
+
+#endif // QUANTIZEDKERNELS_HPP
@@ -0,0 +1,113 @@
+#ifndef QUANTIZEDMATRIX_HPP
+#define QUANTIZEDMATRIX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "AlignedBuffer.hpp"
+#include "MatrixKernels.hpp"
+
+/**
+ * A row-major matrix of signed 8 bit weights with one scale per row, so row y of the original matrix is approximately scale( y ) * row( y ). Rows are padded with zeros to a multiple of 64 weights so the integer kernels never need a tail loop.
+ */
+class QuantizedMatrix {
+	private:
+		static const unsigned int row_alignment = 64;
+
+		unsigned int m_width;
+		unsigned int m_height;
+		unsigned int m_stride;
+		AlignedBuffer< std::int8_t > m_values;
+		std::vector< float > m_scales;
+
+		// The sum of each row's weights, which the unsigned-by-signed dot product kernels correct by
+		std::vector< std::int32_t > m_row_sums;
+
+	public:
+		QuantizedMatrix() : m_width( 0 ), m_height( 0 ), m_stride( 0 ) {
+		}
+
+		/**
+		 * Quantize a single precision matrix, scaling each row so its largest magnitude maps to 127.
+		 * @param values The row-major values to quantize.
+		 * @param stride The distance in floats between the starts of consecutive rows.
+		 * @param height The number of rows in the matrix.
+		 * @param width The number of columns in the matrix.
+		 */
+		void quantize( const float* values, unsigned int stride, unsigned int height, unsigned int width ) {
+			m_width = width;
+			m_height = height;
+			m_stride = ( width + row_alignment - 1 ) / row_alignment * row_alignment;
+			m_values.setHugePages( isHugePageMode() );
+			m_values.resize( static_cast< std::size_t >( m_stride ) * height );
+			firstTouchRows( m_values.data(), m_stride, height, m_stride );
+			m_scales.resize( height );
+			m_row_sums.resize( height );
+
+			for( unsigned int y = 0; y < height; ++y ) {
+				const float* row = values + static_cast< std::size_t >( y ) * stride;
+				std::int8_t* quantized_row = m_values.data() + static_cast< std::size_t >( y ) * m_stride;
+
+				float max_magnitude = 0.f;
+				for( unsigned int x = 0; x < width; ++x ) {
+					max_magnitude = std::max( max_magnitude, std::abs( row[ x ] ) );
+				}
+
+				const float scale = max_magnitude > 0.f ? max_magnitude / 127.f : 1.f;
+				const float inverse_scale = 1.f / scale;
+				std::int32_t sum = 0;
+
+				for( unsigned int x = 0; x < width; ++x ) {
+					long quantized = std::lround( row[ x ] * inverse_scale );
+					quantized = quantized > 127 ? 127 : ( quantized < -127 ? -127 : quantized );
+					quantized_row[ x ] = static_cast< std::int8_t >( quantized );
+					sum += static_cast< std::int32_t >( quantized );
+				}
+
+				m_scales[ y ] = scale;
+				m_row_sums[ y ] = sum;
+			}
+		}
+
+		unsigned int getWidth() const {
+			return m_width;
+		}
+
+		unsigned int getHeight() const {
+			return m_height;
+		}
+
+		/**
+		 * Get the distance between the starts of consecutive rows.
+		 * @return The row stride, a multiple of 64 weights.
+		 */
+		unsigned int getStride() const {
+			return m_stride;
+		}
+
+		/**
+		 * Get a weight as the quantized matrix represents it.
+		 * @param y The row of the weight.
+		 * @param x The column of the weight.
+		 * @return The quantized weight multiplied back out by its row's scale.
+		 */
+		float getValue( unsigned int y, unsigned int x ) const {
+			return m_values[ static_cast< std::size_t >( y ) * m_stride + x ] * m_scales[ y ];
+		}
+
+		const std::int8_t* data() const {
+			return m_values.data();
+		}
+
+		const float* getScales() const {
+			return m_scales.data();
+		}
+
+		const std::int32_t* getRowSums() const {
+			return m_row_sums.data();
+		}
+};
+
+#endif // QUANTIZEDMATRIX_HPP
@@ -0,0 +1,321 @@
+#ifndef SPARSEKERNELS_HPP
+#define SPARSEKERNELS_HPP
+
+#include <cstddef>
+#include <string>
+#include "AlignedBuffer.hpp"
+#include "CPUFeatures.hpp"
+#include "MatrixKernels.hpp"
+#include "SparseMatrix.hpp"
+#include "VectorView.hpp"
+
+#if NN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Reference sparse matrix-vector product over 8 wide blocks.
+ * @param row_offsets The index of each row's first block, followed by the total block count.
+ * @param block_columns The first column of each block.
+ * @param values The values of the blocks, 8 per block.
+ * @param height The number of rows in the matrix.
+ * @param input The vector to multiply by, padded with zeros to a multiple of 8.
+ * @param bias The vector to add to the product, of length height. May be null.
+ * @param output The vector to write the result into, of length height.
+ */
+void sparseGEMVScalar( const unsigned int* row_offsets, const unsigned int* block_columns, const float* values, unsigned int height, const float* input, const float* bias, float* output ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		float accum = bias ? bias[ y ] : 0.f;
+
+		for( unsigned int b = row_offsets[ y ]; b < row_offsets[ y + 1 ]; ++b ) {
+			const float* block = values + static_cast< std::size_t >( b ) * SparseMatrix::block_width;
+			const float* in = input + block_columns[ b ];
+
+			for( unsigned int i = 0; i < SparseMatrix::block_width; ++i ) {
+				accum += block[ i ] * in[ i ];
+			}
+		}
+
+		output[ y ] = accum;
+	}
+}
+
+/**
+ * Reference sparse transposed matrix-vector product, accumulating output += transpose( weights ) * input.
+ * @param row_offsets The index of each row's first block, followed by the total block count.
+ * @param block_columns The first column of each block.
+ * @param values The values of the blocks, 8 per block.
+ * @param height The number of rows in the matrix.
+ * @param input The vector to multiply by, of length height.
+ * @param output The vector to add the result to, padded to a multiple of 8.
+ */
+void sparseGEMVTransposedScalar( const unsigned int* row_offsets, const unsigned int* block_columns, const float* values, unsigned int height, const float* input, float* output ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		const float scale = input[ y ];
+
+		for( unsigned int b = row_offsets[ y ]; b < row_offsets[ y + 1 ]; ++b ) {
+			const float* block = values + static_cast< std::size_t >( b ) * SparseMatrix::block_width;
+			float* out = output + block_columns[ b ];
+
+			for( unsigned int i = 0; i < SparseMatrix::block_width; ++i ) {
+				out[ i ] += scale * block[ i ];
+			}
+		}
+	}
+}
+
+#if NN_X86
+// One block is exactly one ymm register, so each block is a single load and FMA
+__attribute__(( target( "avx2,fma" ) ))
+void sparseGEMVAVX2( const unsigned int* row_offsets, const unsigned int* block_columns, const float* values, unsigned int height, const float* input, const float* bias, float* output ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		__m256 accum = _mm256_setzero_ps();
+
+		for( unsigned int b = row_offsets[ y ]; b < row_offsets[ y + 1 ]; ++b ) {
+			accum = _mm256_fmadd_ps( _mm256_load_ps( values + static_cast< std::size_t >( b ) * SparseMatrix::block_width ), _mm256_loadu_ps( input + block_columns[ b ] ), accum );
+		}
+
+		output[ y ] = horizontalSumAVX2( accum ) + ( bias ? bias[ y ] : 0.f );
+	}
+}
+
+__attribute__(( target( "avx2,fma" ) ))
+void sparseGEMVTransposedAVX2( const unsigned int* row_offsets, const unsigned int* block_columns, const float* values, unsigned int height, const float* input, float* output ) {
+	for( unsigned int y = 0; y < height; ++y ) {
+		const __m256 scale = _mm256_set1_ps( input[ y ] );
+
+		for( unsigned int b = row_offsets[ y ]; b < row_offsets[ y + 1 ]; ++b ) {
+			float* out = output + block_columns[ b ];
+			_mm256_storeu_ps( out, _mm256_fmadd_ps( _mm256_load_ps( values + static_cast< std::size_t >( b ) * SparseMatrix::block_width ), scale, _mm256_loadu_ps( out ) ) );
+		}
+	}
+}
+#endif
+
+typedef void ( *SparseGEMVKernel )( const unsigned int*, const unsigned int*, const float*, unsigned int, const float*, const float*, float* );
+typedef void ( *SparseTransposedGEMVKernel )( const unsigned int*, const unsigned int*, const float*, unsigned int, const float*, float* );
+
+SparseGEMVKernel selectSparseGEMVKernel() {
+	static const SparseGEMVKernel kernel = []() -> SparseGEMVKernel {
+#if NN_X86
+		if( CPUFeatures::get().hasAVX2() ) {
+			return sparseGEMVAVX2;
+		}
+#endif
+		return sparseGEMVScalar;
+	}();
+
+	return kernel;
+}
+
+SparseTransposedGEMVKernel selectSparseTransposedGEMVKernel() {
+	static const SparseTransposedGEMVKernel kernel = []() -> SparseTransposedGEMVKernel {
+#if NN_X86
+		if( CPUFeatures::get().hasAVX2() ) {
+			return sparseGEMVTransposedAVX2;
+		}
+#endif
+		return sparseGEMVTransposedScalar;
+	}();
+
+	return kernel;
+}
+
+/**
+ * Get a zeroed scratch vector whose length is rounded up to whole blocks, so the last block of a row can be loaded without reading past the end.
+ * @param storage The buffer to use.
+ * @param width The width of the sparse matrix.
+ * @return The start of the zeroed scratch vector.
+ */
+float* getPaddedSparseVector( AlignedBuffer< float >& storage, unsigned int width ) {
+	storage.resize( ( width + SparseMatrix::block_width - 1 ) / SparseMatrix::block_width * SparseMatrix::block_width );
+	storage.clear();
+	return storage.data();
+}
+
+/**
+ * Calculate output = activation( weights * input + bias ) with sparse weights. Each thread applies the activation to its rows as soon as they are done, while they are still in its cache.
+ * @param weights The sparse weight matrix.
+ * @param input The vector to multiply by. Must match the width of the weight matrix.
+ * @param bias The vector to add to the product. Must match the height of the weight matrix, or be empty for no bias. May be the output vector.
+ * @param output The vector to write the result into. Must match the height of the weight matrix.
+ * @param function The activation to apply after the bias.
+ * @param accuracy The accuracy tier to apply it at.
+ */
+void gemv( const SparseMatrix& weights, ConstVectorView input, ConstVectorView bias, VectorView output, ActivationFunction function = ActivationFunction::Identity, ActivationAccuracy accuracy = ActivationAccuracy::Exact ) {
+#ifdef NN_BOUNDS_CHECK
+	if( input.getDimension() != weights.getWidth() || output.getDimension() != weights.getHeight() || ( bias.data() && bias.getDimension() != weights.getHeight() ) ) {
+		throw std::string( "Mismatched dimensions in sparse matrix-vector product" );
+	}
+#endif
+
+	static thread_local AlignedBuffer< float > padded_input_storage;
+	float* padded_input = getPaddedSparseVector( padded_input_storage, weights.getWidth() );
+	for( unsigned int x = 0; x < weights.getWidth(); ++x ) {
+		padded_input[ x ] = input( x );
+	}
+
+	if( bias.isContiguous() && output.isContiguous() ) {
+		SparseGEMVKernel kernel = selectSparseGEMVKernel();
+
+		parallelForRows( weights.getHeight(), static_cast< std::size_t >( weights.getBlockCount() ) * SparseMatrix::block_width, [ & ]( unsigned int first, unsigned int count ) {
+			kernel( weights.getRowOffsets().data() + first, weights.getBlockColumns().data(), weights.data(), count, padded_input, bias.data() ? bias.data() + first : nullptr, output.data() + first );
+			applyActivation( function, accuracy, output.slice( first, count ), output.slice( first, count ) );
+		} );
+		return;
+	}
+
+	for( unsigned int y = 0; y < weights.getHeight(); ++y ) {
+		float accum = 0.f;
+		sparseGEMVScalar( weights.getRowOffsets().data() + y, weights.getBlockColumns().data(), weights.data(), 1, padded_input, nullptr, &accum );
+		output( y ) = activate( function, accuracy, accum + ( bias.data() ? bias( y ) : 0.f ) );
+	}
+}
+
+/**
+ * Calculate output = transpose( weights ) * input, or add it to output, with sparse weights.
+ * @param weights The sparse weight matrix.
+ * @param input The vector to multiply by. Must match the height of the weight matrix.
+ * @param output The vector to write the result into. Must match the width of the weight matrix.
+ * @param accumulate Whether to add the result to output instead of overwriting it.
+ */
+void gemvTransposed( const SparseMatrix& weights, ConstVectorView input, VectorView output, bool accumulate = false ) {
+#ifdef NN_BOUNDS_CHECK
+	if( input.getDimension() != weights.getHeight() || output.getDimension() != weights.getWidth() ) {
+		throw std::string( "Mismatched dimensions in sparse transposed matrix-vector product" );
+	}
+#endif
+
+	static thread_local AlignedBuffer< float > padded_output_storage;
+	static thread_local AlignedBuffer< float > contiguous_input_storage;
+
+	const float* input_values = input.data();
+	if( !input.isContiguous() ) {
+		contiguous_input_storage.resize( input.getDimension() );
+		for( unsigned int y = 0; y < input.getDimension(); ++y ) {
+			contiguous_input_storage[ y ] = input( y );
+		}
+		input_values = contiguous_input_storage.data();
+	}
+
+	SparseTransposedGEMVKernel kernel = selectSparseTransposedGEMVKernel();
+	const int thread_count = getKernelThreadCount( static_cast< std::size_t >( weights.getBlockCount() ) * SparseMatrix::block_width );
+	const std::size_t padded_width = ( weights.getWidth() + SparseMatrix::block_width - 1 ) / SparseMatrix::block_width * SparseMatrix::block_width;
+
+	// Blocks scatter into arbitrary columns, so each thread sums its rows into its own padded partial
+	const std::size_t partial_stride = ( padded_width + 15u ) & ~static_cast< std::size_t >( 15u );
+	padded_output_storage.resize( partial_stride * thread_count );
+	padded_output_storage.clear();
+	float* partials = padded_output_storage.data();
+
+	const unsigned int height = weights.getHeight();
+
+	#pragma omp parallel num_threads( thread_count ) if( thread_count > 1 )
+	{
+#ifdef _OPENMP
+		const int thread = omp_get_thread_num();
+		const int threads = omp_get_num_threads();
+#else
+		const int thread = 0;
+		const int threads = 1;
+#endif
+		const unsigned int first = static_cast< unsigned int >( static_cast< std::size_t >( height ) * thread / threads );
+		const unsigned int last = static_cast< unsigned int >( static_cast< std::size_t >( height ) * ( thread + 1 ) / threads );
+
+		bindKernelThread( thread, threads );
+		kernel( weights.getRowOffsets().data() + first, weights.getBlockColumns().data(), weights.data(), last - first, input_values + first, partials + partial_stride * thread );
+	}
+
+	for( unsigned int x = 0; x < weights.getWidth(); ++x ) {
+		float sum = accumulate ? output( x ) : 0.f;
+		for( int t = 0; t < thread_count; ++t ) {
+			sum += partials[ partial_stride * t + x ];
+		}
+		output( x ) = sum;
+	}
+}
+
+/**
+ * Apply the gradient step weights -= rate * delta * transpose( input ) to the stored blocks only, so pruned weights stay pruned.
+ * @param weights The sparse weight matrix to update.
+ * @param delta The delta of each row. Must match the height of the weight matrix.
+ * @param input The input the layer was trained on. Must match the width of the weight matrix.
+ * @param rate The learning rate.
+ */
+void rankOneUpdate( SparseMatrix& weights, ConstVectorView delta, ConstVectorView input, float rate ) {
+#ifdef NN_BOUNDS_CHECK
+	if( delta.getDimension() != weights.getHeight() || input.getDimension() != weights.getWidth() ) {
+		throw std::string( "Mismatched dimensions in sparse update" );
+	}
+#endif
+
+	static thread_local AlignedBuffer< float > padded_input_storage;
+	float* padded_input = getPaddedSparseVector( padded_input_storage, weights.getWidth() );
+	for( unsigned int x = 0; x < weights.getWidth(); ++x ) {
+		padded_input[ x ] = input( x );
+	}
+
+	const unsigned int* row_offsets = weights.getRowOffsets().data();
+	const unsigned int* block_columns = weights.getBlockColumns().data();
+	float* values = weights.data();
+
+	parallelForRows( weights.getHeight(), static_cast< std::size_t >( weights.getBlockCount() ) * SparseMatrix::block_width, [ & ]( unsigned int first, unsigned int count ) {
+		for( unsigned int y = first; y < first + count; ++y ) {
+			const float step = rate * delta( y );
+
+			for( unsigned int b = row_offsets[ y ]; b < row_offsets[ y + 1 ]; ++b ) {
+				float* block = values + static_cast< std::size_t >( b ) * SparseMatrix::block_width;
+				const float* in = padded_input + block_columns[ b ];
+
+				// Zeros inside a stored block are pruned weights too
+				for( unsigned int i = 0; i < SparseMatrix::block_width; ++i ) {
+					block[ i ] = block[ i ] != 0.f ? block[ i ] - step * in[ i ] : 0.f;
+				}
+			}
+		}
+	} );
+}
+
+/**
+ * Add delta * transpose( input ) to the gradients of the stored blocks. The gradients share the blocks' layout, and stay zero for the pruned weights inside a block so steps never revive them.
+ * @param weights The sparse weight matrix the gradients belong to.
+ * @param delta The delta of each row. Must match the height of the weight matrix.
+ * @param input The input the layer was trained on. Must match the width of the weight matrix.
+ * @param gradients The gradients to add to, one per stored block value.
+ */
+void accumulateGradient( const SparseMatrix& weights, ConstVectorView delta, ConstVectorView input, float* gradients ) {
+#ifdef NN_BOUNDS_CHECK
+	if( delta.getDimension() != weights.getHeight() || input.getDimension() != weights.getWidth() ) {
+		throw std::string( "Mismatched dimensions in sparse gradient" );
+	}
+#endif
+
+	static thread_local AlignedBuffer< float > padded_input_storage;
+	float* padded_input = getPaddedSparseVector( padded_input_storage, weights.getWidth() );
+	for( unsigned int x = 0; x < weights.getWidth(); ++x ) {
+		padded_input[ x ] = input( x );
+	}
+
+	const unsigned int* row_offsets = weights.getRowOffsets().data();
+	const unsigned int* block_columns = weights.getBlockColumns().data();
+	const float* values = weights.data();
+
+	parallelForRows( weights.getHeight(), static_cast< std::size_t >( weights.getBlockCount() ) * SparseMatrix::block_width, [ & ]( unsigned int first, unsigned int count ) {
+		for( unsigned int y = first; y < first + count; ++y ) {
+			const float delta_value = delta( y );
+
+			for( unsigned int b = row_offsets[ y ]; b < row_offsets[ y + 1 ]; ++b ) {
+				const std::size_t start = static_cast< std::size_t >( b ) * SparseMatrix::block_width;
+				const float* in = padded_input + block_columns[ b ];
+
+				for( unsigned int i = 0; i < SparseMatrix::block_width; ++i ) {
+					if( values[ start + i ] != 0.f ) {
+						gradients[ start + i ] += delta_value * in[ i ];
+					}
+				}
+			}
+		}
+	} );
+}
+
+#endif // SPARSEKERNELS_HPP
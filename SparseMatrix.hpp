@@ -0,0 +1,175 @@
+#ifndef SPARSEMATRIX_HPP
+#define SPARSEMATRIX_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "AlignedBuffer.hpp"
+
+/**
+ * A sparse matrix in block compressed sparse row form. Nonzeros are kept in runs of block_width consecutive columns, so each stored block is one vector load. Row y owns blocks getRowOffsets()[ y ] up to getRowOffsets()[ y + 1 ], block b starts at column getBlockColumns()[ b ] and its values are the block_width floats at data() + b * block_width.
+ */
+class SparseMatrix {
+	public:
+		static const unsigned int block_width = 8;
+
+	private:
+		unsigned int m_width;
+		unsigned int m_height;
+		std::vector< unsigned int > m_row_offsets;
+		std::vector< unsigned int > m_block_columns;
+		AlignedBuffer< float > m_values;
+
+	public:
+		SparseMatrix() : m_width( 0 ), m_height( 0 ), m_row_offsets( 1, 0 ) {
+		}
+
+		/**
+		 * Build the sparse matrix from a dense one, dropping weights whose magnitude is below a threshold and any block left entirely zero.
+		 * @param values The row-major dense values.
+		 * @param stride The distance in floats between the starts of consecutive rows.
+		 * @param height The number of rows in the matrix.
+		 * @param width The number of columns in the matrix.
+		 * @param threshold The magnitude below which weights are dropped.
+		 */
+		void fromDense( const float* values, unsigned int stride, unsigned int height, unsigned int width, float threshold ) {
+			m_width = width;
+			m_height = height;
+			m_row_offsets.assign( 1, 0 );
+			m_block_columns.clear();
+
+			std::vector< float > kept;
+
+			for( unsigned int y = 0; y < height; ++y ) {
+				const float* row = values + static_cast< std::size_t >( y ) * stride;
+
+				for( unsigned int column = 0; column < width; column += block_width ) {
+					float block[ block_width ] = {};
+					bool nonzero = false;
+
+					for( unsigned int i = 0; i < block_width && column + i < width; ++i ) {
+						if( std::abs( row[ column + i ] ) >= threshold && row[ column + i ] != 0.f ) {
+							block[ i ] = row[ column + i ];
+							nonzero = true;
+						}
+					}
+
+					if( nonzero ) {
+						m_block_columns.push_back( column );
+						kept.insert( kept.end(), block, block + block_width );
+					}
+				}
+
+				m_row_offsets.push_back( static_cast< unsigned int >( m_block_columns.size() ) );
+			}
+
+			m_values.resize( kept.size() );
+			if( !kept.empty() ) {
+				std::memcpy( m_values.data(), kept.data(), kept.size() * sizeof( float ) );
+			}
+		}
+
+		/**
+		 * Expand the sparse matrix into a dense one.
+		 * @param values The row-major buffer to write into, of at least height rows. Dropped weights are written as zero.
+		 * @param stride The distance in floats between the starts of consecutive rows.
+		 */
+		void toDense( float* values, unsigned int stride ) const {
+			for( unsigned int y = 0; y < m_height; ++y ) {
+				float* row = values + static_cast< std::size_t >( y ) * stride;
+
+				for( unsigned int x = 0; x < m_width; ++x ) {
+					row[ x ] = 0.f;
+				}
+
+				for( unsigned int b = m_row_offsets[ y ]; b < m_row_offsets[ y + 1 ]; ++b ) {
+					for( unsigned int i = 0; i < block_width && m_block_columns[ b ] + i < m_width; ++i ) {
+						row[ m_block_columns[ b ] + i ] = m_values[ static_cast< std::size_t >( b ) * block_width + i ];
+					}
+				}
+			}
+		}
+
+		/**
+		 * Set the layout of the matrix, for loading. Block values are zeroed and must be filled through data().
+		 * @param height The number of rows in the matrix.
+		 * @param width The number of columns in the matrix.
+		 * @param row_offsets The index of each row's first block, followed by the total block count.
+		 * @param block_columns The first column of each block.
+		 */
+		void setStructure( unsigned int height, unsigned int width, const std::vector< unsigned int >& row_offsets, const std::vector< unsigned int >& block_columns ) {
+			if( row_offsets.size() != height + 1 || row_offsets.back() != block_columns.size() ) {
+				throw std::string( "Invalid sparse matrix structure" );
+			}
+
+			for( unsigned int b = 0; b < block_columns.size(); ++b ) {
+				if( block_columns[ b ] >= width ) {
+					throw std::string( "Sparse matrix block out of bounds" );
+				}
+			}
+
+			m_width = width;
+			m_height = height;
+			m_row_offsets = row_offsets;
+			m_block_columns = block_columns;
+			m_values.resize( block_columns.size() * block_width );
+			m_values.clear();
+		}
+
+		/**
+		 * Move the block values into external memory and use that from now on. Restructuring to a different block count gives the matrix memory of its own again.
+		 * @param values The memory to use, holding getBlockCount() * block_width floats and aligned to 64 bytes. Must outlive its use by the matrix. Null moves the values back into memory of its own.
+		 */
+		void bindValues( float* values ) {
+			m_values.bind( values );
+		}
+
+		unsigned int getWidth() const {
+			return m_width;
+		}
+
+		unsigned int getHeight() const {
+			return m_height;
+		}
+
+		unsigned int getBlockCount() const {
+			return static_cast< unsigned int >( m_block_columns.size() );
+		}
+
+		/**
+		 * Get the fraction of the dense matrix the stored blocks cover.
+		 * @return The stored weights over the dense weight count, not counting the padding of blocks that run past the last column.
+		 */
+		float getDensity() const {
+			if( m_width == 0 || m_height == 0 ) {
+				return 0.f;
+			}
+
+			std::size_t covered = 0;
+			for( unsigned int b = 0; b < m_block_columns.size(); ++b ) {
+				covered += m_width - m_block_columns[ b ] < block_width ? m_width - m_block_columns[ b ] : block_width;
+			}
+
+			return static_cast< float >( covered ) / ( static_cast< float >( m_width ) * m_height );
+		}
+
+		const std::vector< unsigned int >& getRowOffsets() const {
+			return m_row_offsets;
+		}
+
+		const std::vector< unsigned int >& getBlockColumns() const {
+			return m_block_columns;
+		}
+
+		float* data() {
+			return m_values.data();
+		}
+
+		const float* data() const {
+			return m_values.data();
+		}
+};
+
+#endif // SPARSEMATRIX_HPP
@@ -0,0 +1,246 @@
+#ifndef SPECTROGRAM_HPP
+#define SPECTROGRAM_HPP
+
+#include <complex>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include "AlignedBuffer.hpp"
+#include "ComplexBuffer.hpp"
+#include "MatrixView.hpp"
+#include "VectorView.hpp"
+
+/**
+ * The order a spectrogram keeps its values in. Each value is a real part followed by an imaginary part.
+ */
+enum class SpectrogramLayout {
+	// Channel, then chunk, then bin. Each channel's time series of spectra is one contiguous run
+	ChannelMajor,
+	// Chunk, then bin, then channel. Matches the network's output order, so the start of each chunk can be used as a sample directly
+	ChunkMajor
+};
+
+/**
+ * The short-time spectra of every channel of a signal, held in a single contiguous buffer instead of one allocation per chunk.
+ */
+class Spectrogram {
+	private:
+		AlignedBuffer< float > m_values;
+		unsigned int m_channel_count;
+		unsigned int m_chunk_count;
+		unsigned int m_bin_count;
+		SpectrogramLayout m_layout;
+
+	public:
+		Spectrogram() : m_channel_count( 0 ), m_chunk_count( 0 ), m_bin_count( 0 ), m_layout( SpectrogramLayout::ChunkMajor ) {
+		}
+
+		/**
+		 * Create a spectrogram of zeros.
+		 * @param channel_count The number of channels.
+		 * @param chunk_count The number of time slices per channel.
+		 * @param bin_count The number of frequency bins per time slice.
+		 * @param layout The order to keep the values in.
+		 */
+		Spectrogram( unsigned int channel_count, unsigned int chunk_count, unsigned int bin_count, SpectrogramLayout layout ) : Spectrogram() {
+			setSize( channel_count, chunk_count, bin_count, layout );
+		}
+
+		/**
+		 * Resize the spectrogram, setting every value to zero.
+		 * @param channel_count The number of channels.
+		 * @param chunk_count The number of time slices per channel.
+		 * @param bin_count The number of frequency bins per time slice.
+		 * @param layout The order to keep the values in.
+		 */
+		void setSize( unsigned int channel_count, unsigned int chunk_count, unsigned int bin_count, SpectrogramLayout layout ) {
+			m_channel_count = channel_count;
+			m_chunk_count = chunk_count;
+			m_bin_count = bin_count;
+			m_layout = layout;
+
+			m_values.resize( getValueCount() );
+			m_values.clear();
+		}
+
+		unsigned int getChannelCount() const {
+			return m_channel_count;
+		}
+
+		unsigned int getChunkCount() const {
+			return m_chunk_count;
+		}
+
+		unsigned int getBinCount() const {
+			return m_bin_count;
+		}
+
+		SpectrogramLayout getLayout() const {
+			return m_layout;
+		}
+
+		/**
+		 * Get the number of floats held, two per complex value.
+		 * @return The number of floats.
+		 */
+		std::size_t getValueCount() const {
+			return std::size_t( 2 ) * m_channel_count * m_chunk_count * m_bin_count;
+		}
+
+		/**
+		 * Get the distance between consecutive bins of one channel's time slice.
+		 * @return The distance in floats.
+		 */
+		std::size_t getBinStride() const {
+			return m_layout == SpectrogramLayout::ChunkMajor ? std::size_t( 2 ) * m_channel_count : 2;
+		}
+
+		/**
+		 * Find where a value's real part is kept. Its imaginary part follows directly after.
+		 * @param channel The channel of the value.
+		 * @param chunk The time slice of the value.
+		 * @param bin The frequency bin of the value.
+		 * @return The index of the real part in data().
+		 */
+		std::size_t getOffset( unsigned int channel, unsigned int chunk, unsigned int bin ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( channel >= m_channel_count || chunk >= m_chunk_count || bin >= m_bin_count ) {
+				throw std::string( "Spectrogram access out of bounds" );
+			}
+#endif
+			if( m_layout == SpectrogramLayout::ChunkMajor ) {
+				return 2 * ( ( std::size_t( chunk ) * m_bin_count + bin ) * m_channel_count + channel );
+			}
+
+			return 2 * ( ( std::size_t( channel ) * m_chunk_count + chunk ) * m_bin_count + bin );
+		}
+
+		float* data() {
+			return m_values.data();
+		}
+
+		const float* data() const {
+			return m_values.data();
+		}
+
+		std::complex< float > get( unsigned int channel, unsigned int chunk, unsigned int bin ) const {
+			const std::size_t offset = getOffset( channel, chunk, bin );
+			return std::complex< float >( m_values[ offset ], m_values[ offset + 1 ] );
+		}
+
+		void set( unsigned int channel, unsigned int chunk, unsigned int bin, std::complex< float > value ) {
+			const std::size_t offset = getOffset( channel, chunk, bin );
+			m_values[ offset ] = value.real();
+			m_values[ offset + 1 ] = value.imag();
+		}
+
+		/**
+		 * Multiply every value by a real factor.
+		 * @param factor The factor to scale by.
+		 */
+		void scale( float factor ) {
+			float* values = m_values.data();
+			const std::size_t count = getValueCount();
+
+			for( std::size_t i = 0; i < count; ++i ) {
+				values[ i ] *= factor;
+			}
+		}
+
+		/**
+		 * Read the leading bins of one channel's time slice.
+		 * @param channel The channel to read.
+		 * @param chunk The time slice to read.
+		 * @param output Receives the bins. Its size is the number of bins read.
+		 */
+		void getBins( unsigned int channel, unsigned int chunk, ComplexBuffer& output ) const {
+			if( output.size() > m_bin_count ) {
+				throw std::string( "Spectrogram has fewer bins than requested" );
+			}
+
+			output.copyFromInterleaved( 0, output.size(), m_values.data() + getOffset( channel, chunk, 0 ), getBinStride() );
+		}
+
+		/**
+		 * Write the leading bins of one channel's time slice.
+		 * @param channel The channel to write.
+		 * @param chunk The time slice to write.
+		 * @param input The bins to write. Its size is the number of bins written.
+		 */
+		void setBins( unsigned int channel, unsigned int chunk, const ComplexBuffer& input ) {
+			if( input.size() > m_bin_count ) {
+				throw std::string( "Spectrogram has fewer bins than given" );
+			}
+
+			input.copyToInterleaved( 0, input.size(), m_values.data() + getOffset( channel, chunk, 0 ), getBinStride() );
+		}
+
+		/**
+		 * View the leading bins of a time slice in the network's output order, where each bin holds every channel in turn. Only chunk-major spectrograms, or those with a single channel, keep this order contiguously.
+		 * @param chunk The time slice to view.
+		 * @param bin_count The number of leading bins to view.
+		 * @return A contiguous view of 2 * channels * bin_count floats.
+		 */
+		ConstVectorView getInterleavedChunk( unsigned int chunk, unsigned int bin_count ) const {
+			if( m_layout != SpectrogramLayout::ChunkMajor && m_channel_count != 1 ) {
+				throw std::string( "Only chunk-major spectrograms hold chunks in interleaved order" );
+			}
+
+			if( bin_count > m_bin_count ) {
+				throw std::string( "Spectrogram has fewer bins than requested" );
+			}
+
+			return ConstVectorView( m_values.data() + getOffset( 0, chunk, 0 ), 2 * m_channel_count * bin_count );
+		}
+
+		/**
+		 * View the leading bins of consecutive time slices in the network's output order, one slice per row, so a batch of training samples needs no copy. Only chunk-major spectrograms, or those with a single channel, keep this order.
+		 * @param first_chunk The first time slice to view.
+		 * @param chunk_count The number of time slices to view.
+		 * @param bin_count The number of leading bins to view in each.
+		 * @return A view of chunk_count rows of 2 * channels * bin_count floats, strided by the full size of a time slice.
+		 */
+		ConstMatrixView getInterleavedChunks( unsigned int first_chunk, unsigned int chunk_count, unsigned int bin_count ) const {
+			if( m_layout != SpectrogramLayout::ChunkMajor && m_channel_count != 1 ) {
+				throw std::string( "Only chunk-major spectrograms hold chunks in interleaved order" );
+			}
+
+			if( bin_count > m_bin_count ) {
+				throw std::string( "Spectrogram has fewer bins than requested" );
+			}
+
+			if( first_chunk + chunk_count > m_chunk_count ) {
+				throw std::string( "Spectrogram has fewer chunks than requested" );
+			}
+
+			return ConstMatrixView( m_values.data() + getOffset( 0, first_chunk, 0 ), chunk_count, 2 * m_channel_count * bin_count, 2 * m_channel_count * m_bin_count );
+		}
+
+		/**
+		 * Write the leading bins of a time slice from the network's output order.
+		 * @param chunk The time slice to write.
+		 * @param bin_count The number of leading bins to write.
+		 * @param input The 2 * channels * bin_count floats to write.
+		 */
+		void setInterleavedChunk( unsigned int chunk, unsigned int bin_count, const float* input ) {
+			if( bin_count > m_bin_count ) {
+				throw std::string( "Spectrogram has fewer bins than given" );
+			}
+
+			if( m_layout == SpectrogramLayout::ChunkMajor || m_channel_count == 1 ) {
+				std::memcpy( m_values.data() + getOffset( 0, chunk, 0 ), input, std::size_t( 2 ) * m_channel_count * bin_count * sizeof( float ) );
+				return;
+			}
+
+			for( unsigned int c = 0; c < m_channel_count; ++c ) {
+				float* output = m_values.data() + getOffset( c, chunk, 0 );
+
+				for( unsigned int j = 0; j < bin_count; ++j ) {
+					output[ 2 * j ] = input[ 2 * ( j * m_channel_count + c ) ];
+					output[ 2 * j + 1 ] = input[ 2 * ( j * m_channel_count + c ) + 1 ];
+				}
+			}
+		}
+};
+
+#endif // SPECTROGRAM_HPP
@@ -1,27 +1,110 @@
 #ifndef VECTOR_HPP
 #define VECTOR_HPP
 
-#include <vector>
+#include <algorithm>
+#include <string>
+#include "AlignedBuffer.hpp"
+#include "VectorExpression.hpp"
+#include "VectorView.hpp"
 
-class Vector {
+class Vector;
+
+template<>
+struct VectorExpressionStorage< Vector > {
+	typedef const Vector& type;
+};
+
+class Vector : public VectorExpression< Vector > {
 	private:
-		std::vector< float > m_values;
+		AlignedBuffer< float > m_values;
 
 	public:
+		Vector() {
+		}
+
+		Vector( const Vector& ) = default;
+		Vector( Vector&& ) = default;
+
+		/**
+		 * Copy another vector's components, reusing the current storage when the dimensions match. A vector bound to external memory stays bound.
+		 * @param other The vector to copy.
+		 * @return This vector.
+		 */
+		Vector& operator=( const Vector& other ) {
+			if( this != &other ) {
+				setDimension( other.getDimension() );
+				std::copy( other.data(), other.data() + other.getDimension(), data() );
+			}
+
+			return *this;
+		}
+
+		/**
+		 * Create a vector holding the result of an expression, evaluated in a single pass.
+		 * @param expression The expression to evaluate.
+		 */
+		template< typename Expression >
+		Vector( const VectorExpression< Expression >& expression ) {
+			*this = expression;
+		}
+
+		/**
+		 * Evaluate an expression into the vector in a single pass, without temporaries. The vector may appear in the expression.
+		 * @param expression The expression to evaluate.
+		 * @return This vector.
+		 */
+		template< typename Expression >
+		Vector& operator=( const VectorExpression< Expression >& expression ) {
+			setDimension( expression.getDimension() );
+
+			float* values = m_values.data();
+			for( unsigned int i = 0; i < getDimension(); ++i ) {
+				values[ i ] = expression.evaluate( i );
+			}
+
+			return *this;
+		}
+
+		template< typename Expression >
+		Vector& operator+=( const VectorExpression< Expression >& expression ) {
+			return *this = *this + expression;
+		}
+
+		template< typename Expression >
+		Vector& operator-=( const VectorExpression< Expression >& expression ) {
+			return *this = *this - expression;
+		}
+
+		template< typename Expression >
+		Vector& operator*=( const VectorExpression< Expression >& expression ) {
+			return *this = *this * expression;
+		}
+
 		/**
 		 * Get the dimension of the vector.
 		 * @return The vector dimension.
 		 */
 		unsigned int getDimension() const {
-			return m_values.size();
+			return static_cast< unsigned int >( m_values.size() );
 		}
 
 		/**
-		 * Set the dimension of the vector. Its contents are undefined afterwards.
+		 * Set the dimension of the vector. Components are zero after the dimension changes, and left alone otherwise.
 		 * @param size The new dimension of the vector.
 		 */
 		void setDimension( unsigned int size ) {
-			m_values.resize( size );
+			if( size != m_values.size() ) {
+				m_values.resize( size );
+				m_values.clear();
+			}
+		}
+
+		/**
+		 * Move the components into external memory, such as a network's flat parameter buffer, and use that from now on. Setting a different dimension gives the vector memory of its own again.
+		 * @param values The memory to use, holding getDimension() floats and aligned to 64 bytes. Must outlive its use by the vector. Null moves the values back into memory of its own.
+		 */
+		void bindValues( float* values ) {
+			m_values.bind( values );
 		}
 
 		/**
@@ -30,12 +113,57 @@ class Vector {
 		 * @return The vector component being accessed.
 		 */
 		float& operator()( unsigned int index ) {
-			return m_values[ index % getDimension() ];
+#ifdef NN_BOUNDS_CHECK
+			if( index >= getDimension() ) {
+				throw std::string( "Vector access out of bounds" );
+			}
+#endif
+			return m_values[ index ];
+		}
+
+		float operator()( unsigned int index ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( index >= getDimension() ) {
+				throw std::string( "Vector access out of bounds" );
+			}
+#endif
+			return m_values[ index ];
+		}
+
+		float evaluate( unsigned int index ) const {
+			return m_values[ index ];
 		}
 
 		float* data() {
 			return m_values.data();
 		}
+
+		const float* data() const {
+			return m_values.data();
+		}
+
+		operator VectorView() {
+			return VectorView( data(), getDimension() );
+		}
+
+		operator ConstVectorView() const {
+			return ConstVectorView( data(), getDimension() );
+		}
 };
 
+/**
+ * Get a view with packed components, for code that needs to walk the data through a plain pointer.
+ * @param view The view to make contiguous.
+ * @param storage Space to copy the view into if it is strided. Left untouched otherwise.
+ * @return The view itself if it is already contiguous, otherwise a view of the copy in storage.
+ */
+ConstVectorView makeContiguous( ConstVectorView view, Vector& storage ) {
+	if( view.isContiguous() ) {
+		return view;
+	}
+
+	storage = view;
+	return storage;
+}
+
 #endif // VECTOR_HPP
@@ -0,0 +1,159 @@
+#ifndef VECTOREXPRESSION_HPP
+#define VECTOREXPRESSION_HPP
+
+#include <string>
+
+/**
+ * Base of all lazily evaluated elementwise vector expressions. Nothing is computed until an expression is assigned to a Vector, at which point the whole expression tree is evaluated in a single loop.
+ */
+template< typename Derived >
+class VectorExpression {
+	public:
+		const Derived& derived() const {
+			return static_cast< const Derived& >( *this );
+		}
+
+		/**
+		 * Get the dimension of the expression result.
+		 * @return The dimension of the result.
+		 */
+		unsigned int getDimension() const {
+			return derived().getDimension();
+		}
+
+		/**
+		 * Evaluate a single component of the expression.
+		 * @param index The index of the component to evaluate.
+		 * @return The value of the component.
+		 */
+		float evaluate( unsigned int index ) const {
+			return derived().evaluate( index );
+		}
+};
+
+/**
+ * Holds leaf vectors by reference and intermediate expressions by value, so temporaries built inside one full-expression stay valid.
+ */
+template< typename Expression >
+struct VectorExpressionStorage {
+	typedef const Expression type;
+};
+
+template< typename Left, typename Right, typename Operation >
+class VectorBinaryExpression : public VectorExpression< VectorBinaryExpression< Left, Right, Operation > > {
+	private:
+		typename VectorExpressionStorage< Left >::type m_left;
+		typename VectorExpressionStorage< Right >::type m_right;
+
+	public:
+		VectorBinaryExpression( const Left& left, const Right& right ) : m_left( left ), m_right( right ) {
+#ifdef NN_BOUNDS_CHECK
+			if( left.getDimension() != right.getDimension() ) {
+				throw std::string( "Mismatched vector dimensions in expression" );
+			}
+#endif
+		}
+
+		unsigned int getDimension() const {
+			return m_left.getDimension();
+		}
+
+		float evaluate( unsigned int index ) const {
+			return Operation::apply( m_left.evaluate( index ), m_right.evaluate( index ) );
+		}
+};
+
+template< typename Operand, typename Function >
+class VectorMapExpression : public VectorExpression< VectorMapExpression< Operand, Function > > {
+	private:
+		typename VectorExpressionStorage< Operand >::type m_operand;
+		Function m_function;
+
+	public:
+		VectorMapExpression( const Operand& operand, Function function ) : m_operand( operand ), m_function( function ) {
+		}
+
+		unsigned int getDimension() const {
+			return m_operand.getDimension();
+		}
+
+		float evaluate( unsigned int index ) const {
+			return m_function( m_operand.evaluate( index ) );
+		}
+};
+
+struct VectorAddOperation {
+	static float apply( float left, float right ) {
+		return left + right;
+	}
+};
+
+struct VectorSubtractOperation {
+	static float apply( float left, float right ) {
+		return left - right;
+	}
+};
+
+struct VectorMultiplyOperation {
+	static float apply( float left, float right ) {
+		return left * right;
+	}
+};
+
+struct ScaleFunction {
+	float factor;
+
+	float operator()( float value ) const {
+		return factor * value;
+	}
+};
+
+/**
+ * Componentwise sum of two vector expressions.
+ */
+template< typename Left, typename Right >
+VectorBinaryExpression< Left, Right, VectorAddOperation > operator+( const VectorExpression< Left >& left, const VectorExpression< Right >& right ) {
+	return VectorBinaryExpression< Left, Right, VectorAddOperation >( left.derived(), right.derived() );
+}
+
+/**
+ * Componentwise difference of two vector expressions.
+ */
+template< typename Left, typename Right >
+VectorBinaryExpression< Left, Right, VectorSubtractOperation > operator-( const VectorExpression< Left >& left, const VectorExpression< Right >& right ) {
+	return VectorBinaryExpression< Left, Right, VectorSubtractOperation >( left.derived(), right.derived() );
+}
+
+/**
+ * Componentwise (Hadamard) product of two vector expressions.
+ */
+template< typename Left, typename Right >
+VectorBinaryExpression< Left, Right, VectorMultiplyOperation > operator*( const VectorExpression< Left >& left, const VectorExpression< Right >& right ) {
+	return VectorBinaryExpression< Left, Right, VectorMultiplyOperation >( left.derived(), right.derived() );
+}
+
+/**
+ * Scale every component of a vector expression.
+ */
+template< typename Operand >
+VectorMapExpression< Operand, ScaleFunction > operator*( float factor, const VectorExpression< Operand >& operand ) {
+	return VectorMapExpression< Operand, ScaleFunction >( operand.derived(), ScaleFunction{ factor } );
+}
+
+template< typename Operand >
+VectorMapExpression< Operand, ScaleFunction > operator*( const VectorExpression< Operand >& operand, float factor ) {
+	return VectorMapExpression< Operand, ScaleFunction >( operand.derived(), ScaleFunction{ factor } );
+}
+
+/**
+ * Apply a function to every component of a vector expression.
+ * @param operand The expression to apply the function to.
+ * @param function A callable taking and returning a float, such as an activation function.
+ * @return The lazily evaluated result.
+ */
+template< typename Operand, typename Function >
+VectorMapExpression< Operand, Function > apply( const VectorExpression< Operand >& operand, Function function ) {
+	return VectorMapExpression< Operand, Function >( operand.derived(), function );
+}
+
+#endif // VECTOREXPRESSION_HPP
@@ -0,0 +1,110 @@
+#ifndef VECTORVIEW_HPP
+#define VECTORVIEW_HPP
+
+#include <string>
+#include "VectorExpression.hpp"
+
+/**
+ * A non-owning view of a vector stored in an external float buffer. Components may be spaced out with a stride, so a view can pick one channel out of interleaved data without copying it.
+ */
+template< typename T >
+class BasicVectorView : public VectorExpression< BasicVectorView< T > > {
+	private:
+		T* m_values;
+		unsigned int m_dimension;
+		unsigned int m_stride;
+
+	public:
+		BasicVectorView() : m_values( nullptr ), m_dimension( 0 ), m_stride( 1 ) {
+		}
+
+		/**
+		 * Create a view over an external buffer.
+		 * @param values The buffer to view. Must outlive the view.
+		 * @param dimension The number of components in the view.
+		 * @param stride The distance between consecutive components, in elements.
+		 */
+		BasicVectorView( T* values, unsigned int dimension, unsigned int stride = 1 ) : m_values( values ), m_dimension( dimension ), m_stride( stride ) {
+		}
+
+		/**
+		 * Create a view over an external buffer, starting part of the way in.
+		 * @param values The buffer to view. Must outlive the view.
+		 * @param offset The index of the element the view starts at.
+		 * @param dimension The number of components in the view.
+		 * @param stride The distance between consecutive components, in elements.
+		 */
+		BasicVectorView( T* values, unsigned int offset, unsigned int dimension, unsigned int stride ) : m_values( values + offset ), m_dimension( dimension ), m_stride( stride ) {
+		}
+
+		/**
+		 * Views of mutable data can be used wherever a read-only view is expected.
+		 */
+		template< typename U >
+		BasicVectorView( const BasicVectorView< U >& other ) : m_values( other.data() ), m_dimension( other.getDimension() ), m_stride( other.getStride() ) {
+		}
+
+		unsigned int getDimension() const {
+			return m_dimension;
+		}
+
+		unsigned int getStride() const {
+			return m_stride;
+		}
+
+		/**
+		 * Check whether the components are packed back to back, which kernels need for vector loads.
+		 * @return Whether the stride is one.
+		 */
+		bool isContiguous() const {
+			return m_stride == 1;
+		}
+
+		/**
+		 * Get a view of part of this view.
+		 * @param offset The index of the first component of the slice.
+		 * @param dimension The number of components in the slice.
+		 * @return The slice, sharing this view's stride.
+		 */
+		BasicVectorView slice( unsigned int offset, unsigned int dimension ) const {
+			return BasicVectorView( m_values + offset * m_stride, dimension, m_stride );
+		}
+
+		T& operator()( unsigned int index ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( index >= m_dimension ) {
+				throw std::string( "Vector view access out of bounds" );
+			}
+#endif
+			return m_values[ index * m_stride ];
+		}
+
+		float evaluate( unsigned int index ) const {
+			return m_values[ index * m_stride ];
+		}
+
+		/**
+		 * Evaluate an expression into the viewed buffer in a single pass. Assigning one view to another rebinds it instead, like any other handle.
+		 * @param expression The expression to evaluate. Its dimension must match the view.
+		 */
+		template< typename Expression >
+		void assign( const VectorExpression< Expression >& expression ) const {
+#ifdef NN_BOUNDS_CHECK
+			if( expression.getDimension() != m_dimension ) {
+				throw std::string( "Mismatched vector dimensions in view assignment" );
+			}
+#endif
+			for( unsigned int i = 0; i < m_dimension; ++i ) {
+				m_values[ i * m_stride ] = expression.evaluate( i );
+			}
+		}
+
+		T* data() const {
+			return m_values;
+		}
+};
+
+typedef BasicVectorView< float > VectorView;
+typedef BasicVectorView< const float > ConstVectorView;
+
+#endif // VECTORVIEW_HPP